@@ -12,9 +12,16 @@
 ui8 read_ncs_file(si1 *inFileName, si1 *uid, si1 *session_password, si1 *subject_password, si4 anonymize_flag, ui8 uutc_passed_in);
 void uutc_time_from_date(sf8 yr, sf8 mo, sf8 dy, sf8 hr, sf8 mn, sf8 sc, ui8 *uutc_time);
 si4 read_nev_file(si1 *inFileName, si1 *mef_path, ui8 time_correction_factor);
+#ifdef OUTPUT_TO_MEF2
+si4 benchmark_ncs_block_lengths(si1 *inFileName);
+#endif
 
 
 #define DISCARD_BITS			4
 #define NCS_HEADER_SIZE         16384
 
+#define SECS_PER_BLOCK          1       // default MEF block duration (s), overridden with -b
+#define MIN_SECS_PER_BLOCK      0.01
+#define MAX_SECS_PER_BLOCK      30      // RED_compress_block keeps 4 bytes per sample of the block on the stack
+
 #endif
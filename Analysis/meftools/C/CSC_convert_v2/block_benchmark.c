@@ -0,0 +1,242 @@
+/**********************************************************************************************************************
+
+ Block duration benchmark for Ncs2Mef2 (-B).
+
+ Loads the samples of a .ncs file, then for each candidate block duration RED-compresses them into blocks of that
+ length and reports the compression ratio (16-bit input bytes over compressed blocks plus their index entries), the
+ encode throughput, and the time to decode one block and to decode the blocks covering a random short window.
+ Longer blocks compress better but make every windowed read decode more samples than it needs, so the recommended
+ duration is the one with the lowest window latency among those compressing within BENCHMARK_RATIO_TOLERANCE of
+ the best ratio.
+
+ The samples are taken as one contiguous record, so timestamps and discontinuities are ignored.
+ *************************************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "mef.h"
+#include "Ncs2Mef.h"
+
+#define BENCHMARK_MAX_SECS          120     // samples loaded from the start of the file
+#define BENCHMARK_WINDOW_SECS       0.1     // duration of the random windows decoded for the latency figure
+#define BENCHMARK_WINDOWS           200
+#define BENCHMARK_RATIO_TOLERANCE   0.05
+#define NCS_RECORD_SAMPLES          512
+
+static const sf8 benchmark_block_secs[] = { 0.1, 0.25, 0.5, 1.0, 2.0, 5.0, 10.0 };
+#define BENCHMARK_CANDIDATES        ((si4) (sizeof(benchmark_block_secs) / sizeof(benchmark_block_secs[0])))
+
+typedef struct {
+    sf8     secs;
+    ui8     block_len;
+    sf8     ratio;
+    sf8     encode_mb_per_sec;
+    sf8     decode_us_per_block;
+    sf8     window_us;
+    si4     tested;
+} BLOCK_BENCHMARK;
+
+
+static sf8 elapsed_secs(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (sf8) (now.tv_sec - start->tv_sec) + (sf8) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// read up to max_samples samples from the records of a .ncs file, returns the number read
+static ui8 load_ncs_samples(si1 *inFileName, si4 *samps, ui8 max_samples, ui4 *sampling_frequency)
+{
+    FILE *infile;
+    ui8 n, timestamp;
+    ui4 channel, num_valid_samples, i;
+    si2 sample_buffer[NCS_RECORD_SAMPLES];
+
+    infile = fopen(inFileName, "r");
+    if (infile == NULL)
+    {
+        fprintf(stderr, "Error opening .Ncs file \"%s\"\n", inFileName);
+        return 0;
+    }
+    if (fseek(infile, NCS_HEADER_SIZE, SEEK_SET) != 0)
+    {
+        fclose(infile);
+        return 0;
+    }
+
+    n = 0;
+    *sampling_frequency = 0;
+    while (n < max_samples)
+    {
+        if (fread(&timestamp, sizeof(ui8), 1, infile) != 1 ||
+            fread(&channel, sizeof(ui4), 1, infile) != 1 ||
+            fread(sampling_frequency, sizeof(ui4), 1, infile) != 1 ||
+            fread(&num_valid_samples, sizeof(ui4), 1, infile) != 1 ||
+            fread(sample_buffer, sizeof(si2), NCS_RECORD_SAMPLES, infile) != NCS_RECORD_SAMPLES)
+            break;
+        if (num_valid_samples > NCS_RECORD_SAMPLES)
+            num_valid_samples = NCS_RECORD_SAMPLES;
+        for (i = 0; i < num_valid_samples && n < max_samples; i++)
+            samps[n++] = sample_buffer[i];
+    }
+
+    fclose(infile);
+    return n;
+}
+
+static si4 benchmark_block_length(BLOCK_BENCHMARK *result, si4 *samps, ui8 n_samps, sf8 sampling_frequency)
+{
+    ui8 block_len, n_blocks, b, i, compressed_bytes, window_len, first, last, rng;
+    ui8 *offsets;
+    ui1 *out_buffer;
+    si4 *decoded;
+    si1 *diff_buffer;
+    sf8 secs;
+    RED_BLOCK_HDR_INFO block_hdr;
+    struct timespec start;
+    si4 w, return_value;
+
+    block_len = (ui8) ceil(result->secs * sampling_frequency);
+    result->block_len = block_len;
+    result->tested = 0;
+    if (block_len < 2 || block_len > n_samps)
+        return 0;
+    n_blocks = (n_samps + block_len - 1) / block_len;
+
+    out_buffer = (ui1 *) malloc((size_t) (n_samps * 8 + n_blocks * BLOCK_HEADER_BYTES));
+    offsets = (ui8 *) malloc((size_t) (n_blocks + 1) * sizeof(ui8));
+    decoded = (si4 *) malloc((size_t) block_len * sizeof(si4));
+    diff_buffer = (si1 *) malloc((size_t) block_len * 4);
+    if (out_buffer == NULL || offsets == NULL || decoded == NULL || diff_buffer == NULL)
+    {
+        fprintf(stderr, "Insufficient memory to benchmark %g second blocks\n", result->secs);
+        free(out_buffer); free(offsets); free(decoded); free(diff_buffer);
+        return 1;
+    }
+    return_value = 0;
+
+    // encode every block
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    offsets[0] = 0;
+    for (b = 0; b < n_blocks; b++)
+    {
+        first = b * block_len;
+        last = first + block_len < n_samps ? first + block_len : n_samps;
+        offsets[b + 1] = offsets[b] + RED_compress_block(samps + first, out_buffer + offsets[b], (ui4) (last - first),
+                                                         first, b == 0, NULL, MEF_FALSE, &block_hdr);
+    }
+    secs = elapsed_secs(&start);
+    compressed_bytes = offsets[n_blocks] + n_blocks * sizeof(INDEX_DATA);
+    result->ratio = (sf8) (n_samps * sizeof(si2)) / (sf8) compressed_bytes;
+    result->encode_mb_per_sec = secs > 0.0 ? (sf8) (n_samps * sizeof(si2)) / secs / 1e6 : 0.0;
+
+    // decode every block once, checking the round trip
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (b = 0; b < n_blocks && return_value == 0; b++)
+    {
+        first = b * block_len;
+        last = first + block_len < n_samps ? first + block_len : n_samps;
+        RED_decompress_block(out_buffer + offsets[b], decoded, diff_buffer, NULL, MEF_FALSE, MEF_FALSE, NULL);
+        if (memcmp(decoded, samps + first, (size_t) (last - first) * sizeof(si4)) != 0)
+        {
+            fprintf(stderr, "Block %lu did not decode to its input with %g second blocks\n", (unsigned long) b, result->secs);
+            return_value = 1;
+        }
+    }
+    result->decode_us_per_block = elapsed_secs(&start) * 1e6 / (sf8) n_blocks;
+
+    // decode the blocks covering random windows, as a windowed reader would
+    window_len = (ui8) ceil(BENCHMARK_WINDOW_SECS * sampling_frequency);
+    if (window_len > n_samps)
+        window_len = n_samps;
+    rng = 12345;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (w = 0; w < BENCHMARK_WINDOWS && return_value == 0; w++)
+    {
+        rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+        first = (rng >> 16) % (n_samps - window_len + 1);
+        last = first + window_len - 1;
+        for (i = first / block_len; i <= last / block_len; i++)
+            RED_decompress_block(out_buffer + offsets[i], decoded, diff_buffer, NULL, MEF_FALSE, MEF_FALSE, NULL);
+    }
+    result->window_us = elapsed_secs(&start) * 1e6 / BENCHMARK_WINDOWS;
+    result->tested = (return_value == 0);
+
+    free(out_buffer);
+    free(offsets);
+    free(decoded);
+    free(diff_buffer);
+
+    return return_value;
+}
+
+si4 benchmark_ncs_block_lengths(si1 *inFileName)
+{
+    si4 *samps;
+    ui8 n_samps;
+    ui4 sampling_frequency;
+    BLOCK_BENCHMARK results[BENCHMARK_CANDIDATES];
+    sf8 best_ratio;
+    si4 c, recommended, return_value;
+
+    samps = (si4 *) malloc((size_t) (BENCHMARK_MAX_SECS * 40000) * sizeof(si4));
+    if (samps == NULL)
+    {
+        fprintf(stderr, "Insufficient memory to load benchmark samples\n");
+        return 1;
+    }
+    n_samps = load_ncs_samples(inFileName, samps, (ui8) BENCHMARK_MAX_SECS * 40000, &sampling_frequency);
+    if (n_samps == 0 || sampling_frequency == 0)
+    {
+        fprintf(stderr, "No samples read from \"%s\"\n", inFileName);
+        free(samps);
+        return 1;
+    }
+    // the buffer was sized for the fastest Neuralynx rate, keep the duration the same at any rate
+    if (n_samps > (ui8) BENCHMARK_MAX_SECS * sampling_frequency)
+        n_samps = (ui8) BENCHMARK_MAX_SECS * sampling_frequency;
+
+    fprintf(stdout, "\n%s: %lu samples at %u Hz (%.1f s)\n", inFileName, (unsigned long) n_samps, sampling_frequency,
+            (sf8) n_samps / sampling_frequency);
+    fprintf(stdout, "block (s)  samples/block   ratio  encode MB/s  decode us/block  %g s window us\n", BENCHMARK_WINDOW_SECS);
+
+    return_value = 0;
+    best_ratio = 0.0;
+    for (c = 0; c < BENCHMARK_CANDIDATES; c++)
+    {
+        results[c].secs = benchmark_block_secs[c];
+        if (benchmark_block_length(&results[c], samps, n_samps, (sf8) sampling_frequency) != 0)
+            return_value = 1;
+        if (!results[c].tested)
+        {
+            fprintf(stdout, "%9g  %13lu  (not tested)\n", results[c].secs, (unsigned long) results[c].block_len);
+            continue;
+        }
+        fprintf(stdout, "%9g  %13lu  %6.3f  %11.1f  %15.1f  %16.1f\n", results[c].secs, (unsigned long) results[c].block_len,
+                results[c].ratio, results[c].encode_mb_per_sec, results[c].decode_us_per_block, results[c].window_us);
+        if (results[c].ratio > best_ratio)
+            best_ratio = results[c].ratio;
+    }
+
+    recommended = -1;
+    for (c = 0; c < BENCHMARK_CANDIDATES; c++)
+    {
+        if (!results[c].tested || results[c].ratio < best_ratio * (1.0 - BENCHMARK_RATIO_TOLERANCE))
+            continue;
+        if (recommended < 0 || results[c].window_us < results[recommended].window_us)
+            recommended = c;
+    }
+    if (recommended >= 0)
+        fprintf(stdout, "Recommended block duration: %g s (ratio within %g%% of the best, lowest window latency); convert with -b %g\n",
+                results[recommended].secs, BENCHMARK_RATIO_TOLERANCE * 100.0, results[recommended].secs);
+    else
+        fprintf(stdout, "No block duration could be tested; the file is too short.\n");
+
+    free(samps);
+    return return_value;
+}
@@ -15,6 +15,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/resource.h>
+#include <limits.h>
 
 //#include "size_types.h"
 #include "Ncs2Mef.h"
@@ -22,6 +23,7 @@
 #include "write_mef_channel.h"
 #else
 #include "write_mef_channel_mef2.h"
+#include "trace.h"
 #endif
 //#include "MefChannelWriter.h"
 
@@ -32,10 +34,14 @@
 #endif
 
 #define DBUG 1
-#define SECS_PER_BLOCK 1
 
 si4	ctrl_c_hit;
 
+extern sf8 secs_per_block;
+#ifdef OUTPUT_TO_MEF2
+extern sf8 qc_line_frequency;
+#endif
+
 #ifdef OUTPUT_TO_MEF2
 void pack_mef_header(MEF_HEADER_INFO *out_header_struct, sf8 secs_per_block, si1 *subject_password, si1 *session_password, 
                      si1 *uid, si4 anonymize_flag, si4 dst_flag, si4 bit_shift_flag, sf8 sampling_frequency)
@@ -186,6 +192,7 @@ ui8 read_ncs_file(si1 *inFileName, si1 *uid, si1 *subject_password, si1 *session
     ui8 temp_timestamp, last_temp_timestamp;
     ui8 saved_start_time;
 #ifdef OUTPUT_TO_MEF2
+    ui8 span_start;
     PACKET_TIME	packet_times[1024];
 #endif
     //ui8 *timestamps;
@@ -240,7 +247,7 @@ ui8 read_ncs_file(si1 *inFileName, si1 *uid, si1 *subject_password, si1 *session
 	channel_state_struct = (CHANNEL_STATE*) calloc((size_t) 1, sizeof(CHANNEL_STATE));
     
     initialize_mef_channel_data(channel_state_struct,
-                                SECS_PER_BLOCK,           // seconds per block
+                                secs_per_block,           // seconds per block
                                 chan_name  , // channel name
                                 0,// bit shift flag, set to 1 for neuralynx, to chop off 2 least-significant sample bits
                                 0.0,           // low filt freq
@@ -250,7 +257,7 @@ ui8 read_ncs_file(si1 *inFileName, si1 *uid, si1 *subject_password, si1 *session
                                 1,           // units conversion factor
                                 "not_entered ",// chan description
                                 32000, // starter freq for channel, make it as high or higher than actual freq to allocate buffers
-                                SECS_PER_BLOCK * 1000000, // block interval, needs to be correct, this value is used for all channels
+                                secs_per_block * 1000000, // block interval, needs to be correct, this value is used for all channels
                                 0,             // chan number
                                 dir_name,      // absolute path of session
                                 -6.0,                  // GMT offset
@@ -274,15 +281,19 @@ ui8 read_ncs_file(si1 *inFileName, si1 *uid, si1 *subject_password, si1 *session
     
     
     
-    pack_mef_header(&out_header_struct, 1.0, subject_password, session_password, uid, anonymize_flag, 0, 0, 0.0);
+    pack_mef_header(&out_header_struct, secs_per_block, subject_password, session_password, uid, anonymize_flag, 0, 0, 0.0);
     out_header_struct.sampling_frequency = 32556.0;  // give it something big so it allocates enough space
     
     
     channel_state_struct = (CHANNEL_STATE*) calloc((size_t) 1, sizeof(CHANNEL_STATE));
     
-    initialize_mef_channel_data( channel_state_struct, &out_header_struct, SECS_PER_BLOCK,
+    initialize_mef_channel_data( channel_state_struct, &out_header_struct, secs_per_block,
                                 chan_name, NULL,
                                 0, dir_name, 0);
+    
+    // NCS samples are 16-bit, so the ADC rails are the si2 limits
+    if (qc_line_frequency > 0.0)
+        enable_mef_channel_qc(channel_state_struct, chan_name, dir_name, qc_line_frequency, SHRT_MIN, SHRT_MAX);
 
     
 #endif
@@ -526,6 +537,9 @@ ui8 read_ncs_file(si1 *inFileName, si1 *uid, si1 *subject_password, si1 *session
 
     while (num_bytes_read < flen)
     {
+#ifdef OUTPUT_TO_MEF2
+        span_start = trace_clock();
+#endif
         // read event timestamp
         nr = fread(&timestamp, sizeof(ui8), (size_t) 1, infile);
         num_bytes_read += sizeof(ui8);
@@ -570,6 +584,9 @@ ui8 read_ncs_file(si1 *inFileName, si1 *uid, si1 *subject_password, si1 *session
             exit(1);
         } 
         num_bytes_read += 1024;
+#ifdef OUTPUT_TO_MEF2
+        trace_span("read_record", "io", span_start, num_valid_samples);
+#endif
         
         temp_timestamp = timestamp + *uutc_time_ptr;/* - 3600000000;*/ // adjust 1 hour for daylight savings, this is not necessary
         if (temp_timestamp < last_temp_timestamp + 512.0 * ((1.0/record_frequency) * 1000000.0))
@@ -613,9 +630,9 @@ ui8 read_ncs_file(si1 *inFileName, si1 *uid, si1 *subject_password, si1 *session
 							   (sf8) record_frequency);   // this sampling frequency value needs to be correct*/
         
 #ifndef OUTPUT_TO_MEF2
-         write_mef_channel_data(channel_state_struct, timestamps, samps, num_valid_samples, SECS_PER_BLOCK, record_frequency);
+         write_mef_channel_data(channel_state_struct, timestamps, samps, num_valid_samples, secs_per_block, record_frequency);
 #else
-         write_mef_channel_data(channel_state_struct, &out_header_struct, packet_times, samps, num_valid_samples, SECS_PER_BLOCK);
+         write_mef_channel_data(channel_state_struct, &out_header_struct, packet_times, samps, num_valid_samples, secs_per_block);
 #endif
 
         
@@ -638,7 +655,7 @@ ui8 read_ncs_file(si1 *inFileName, si1 *uid, si1 *subject_password, si1 *session
     strcpy(out_header_struct.channel_name, "chan name");
     strcpy((char*)&(out_header_struct.channel_comments), "not entered");
     out_header_struct.recording_start_time = saved_start_time;
-    close_mef_channel_file(channel_state_struct, &out_header_struct, NULL, NULL, SECS_PER_BLOCK);
+    close_mef_channel_file(channel_state_struct, &out_header_struct, NULL, NULL, secs_per_block);
 #endif
  
     fclose(infile);
@@ -7,7 +7,13 @@
  -main.c acts as a wrapper for underlying functions.
  
  
- USAGE: Ncs2Mef data_file
+ USAGE: Ncs2Mef [-q line_freq] [-b block_secs] [-B] [-T trace_file] data_file
+ 
+ -q line_freq   write a per-block quality table (<channel>.qc) scored at the given AC line frequency (Hz)
+ -b block_secs  duration of each compressed MEF block in seconds (default 1)
+ -B             don't convert; for each data file, report compression ratio, encode throughput and
+                decode latency across candidate block durations, and recommend one
+ -T trace_file  record reads, block compression and writes as a Chrome trace-event JSON timeline
  
  copyright 2011 Mayo Foundation 
  */
@@ -26,9 +32,13 @@
 #include "meflib.h"
 #else
 #include "mef.h"
+#include "trace.h"
 #endif
 #include "Ncs2Mef.h"
 
+sf8 qc_line_frequency = 0.0;  // 0 disables the per-block quality table
+sf8 secs_per_block = SECS_PER_BLOCK;
+
 
 int main (int argc, const char * argv[]) {
 	int	update_mef_header(), convert_mvf(), mayo_encode(), convert_mef();
@@ -40,12 +50,14 @@ int main (int argc, const char * argv[]) {
     ui8 uutc_time;
     int i;
     int nev_count, ncs_count;
+    int benchmark_flag;
+    const char *trace_path;
 	
 	time(&start);
 	
 	if (argc < 2) 
 	{
-		(void) printf("USAGE: %s data_files (.ncs) [event_file (.nev)]\n", argv[0]);
+		(void) printf("USAGE: %s [-q line_freq] [-b block_secs] [-B] [-T trace_file] data_files (.ncs) [event_file (.nev)]\n", argv[0]);
 		return(1);
 	}
 	
@@ -83,11 +95,56 @@ strcpy(session_password, "blah");
     
     uutc_time = 0;
     
+    benchmark_flag = 0;
+    trace_path = NULL;
+    for (i=1;i<numFiles;i++)
+    {
+        if (strcmp(argv[i], "-q") == 0 && i < numFiles-1)
+            qc_line_frequency = atof(argv[i+1]);
+        if (strcmp(argv[i], "-b") == 0 && i < numFiles-1)
+            secs_per_block = atof(argv[i+1]);
+        if (strcmp(argv[i], "-B") == 0)
+            benchmark_flag = 1;
+        if (strcmp(argv[i], "-T") == 0 && i < numFiles-1)
+            trace_path = argv[i+1];
+    }
+    
+    if (secs_per_block < MIN_SECS_PER_BLOCK || secs_per_block > MAX_SECS_PER_BLOCK)
+    {
+        fprintf(stderr, "Block duration must be between %g and %g seconds.  Exiting.\n", (double) MIN_SECS_PER_BLOCK, (double) MAX_SECS_PER_BLOCK);
+        return(1);
+    }
+    
+#ifdef OUTPUT_TO_MEF2
+    if (benchmark_flag)
+    {
+        ncs_count = 0;
+        for (i=1;i<numFiles;i++)
+        {
+            if (strstr(argv[i], ".ncs") != NULL)
+            {
+                ncs_count++;
+                if (benchmark_ncs_block_lengths((si1*) argv[i]) != 0)
+                    dataFailed = 1;
+            }
+        }
+        if (ncs_count == 0)
+        {
+            fprintf(stderr, "There aren't any data (.ncs) files specified, so nothing to benchmark!  Exiting.\n");
+            return(1);
+        }
+        return dataFailed;
+    }
+    
+    if (trace_path != NULL && trace_open((si1*) trace_path) != 0)
+        return(1);
+#endif
+    
     nev_count = 0;
     for (i=1;i<numFiles;i++)
     {
     
-        if (!strstr(argv[i], ".nev") == NULL)
+        if (strstr(argv[i], ".nev") != NULL)
             nev_count++;
     }
     
@@ -102,7 +159,7 @@ strcpy(session_password, "blah");
      {
 
          // main processing, this is where NCS is read and .MEF files are written
-         if (!strstr(argv[i], ".ncs") == NULL)
+         if (strstr(argv[i], ".ncs") != NULL)
          {
              ncs_count++;
              uutc_time = read_ncs_file((si1*) argv[i], (si1*) uid_array, session_password, subject_password, anon_flag, uutc_time);
@@ -120,11 +177,15 @@ strcpy(session_password, "blah");
     
     for (i=1;i<numFiles;i++)
     {
-        if (!strstr(argv[i], ".nev") == NULL)
+        if (strstr(argv[i], ".nev") != NULL)
             read_nev_file((si1*) argv[i], "mef3", uutc_time);
         
     }
     
+#ifdef OUTPUT_TO_MEF2
+    trace_close();
+#endif
+    
     if (dataFailed)
         return 1;
 
@@ -825,7 +825,7 @@ void strncpy2(si1 *s1, si1 *s2, si4 n)
 			continue;
 		return;
 	}
-	s1[n-1] = 0;
+	*s1 = 0;	// s1 already points at the last byte of the destination
 
 	return;
 }
@@ -913,7 +913,8 @@ si4	write_mef(si4 *samps, MEF_HEADER_INFO *mef_header, ui8 len, si1 *out_file, s
 	
 	
 	index_block = (INDEX_DATA *)calloc(num_blocks, sizeof(INDEX_DATA));
-	compressed_buffer = calloc(num_blocks*samps_per_block, sizeof(si4)); //we'll assume at least 50% compression
+	// a difference that needs an escape takes 4 bytes, so allow for every one of them plus the block headers
+	compressed_buffer = calloc((size_t) len * 5 + (size_t) num_blocks * (BLOCK_HEADER_BYTES + 8), sizeof(ui1));
 	
 	if (index_block == NULL || compressed_buffer == NULL) {
 		fprintf(stderr, "[%s] malloc error\n", __FUNCTION__);
@@ -1084,7 +1085,8 @@ si4	write_mef_ind(si4 *samps, MEF_HEADER_INFO *mef_header, ui8 len, si1 *out_fil
             ip->sample_number = i * samps_per_block;
         }
     }
-	compressed_buffer = calloc(num_blocks*samps_per_block, sizeof(si4)); 
+	// a difference that needs an escape takes 4 bytes, so allow for every one of them plus the block headers
+	compressed_buffer = calloc((size_t) len * 5 + (size_t) num_blocks * (BLOCK_HEADER_BYTES + 8), sizeof(ui1)); 
 	
 	if (index_block == NULL || compressed_buffer == NULL) {
 		fprintf(stderr, "[%s] malloc error %d\n", __FUNCTION__, __LINE__);
@@ -0,0 +1,83 @@
+/**********************************************************************************************************************
+
+ Timeline tracing for Ncs2Mef2 (-T).
+
+ trace_span() writes one complete event ("ph":"X") per call: the span from a trace_clock() reading to now, with the
+ calling thread and an optional count (samples compressed, bytes written).  Events are streamed to the file under a
+ mutex as they happen, so a trace of an interrupted conversion is still readable (the viewers tolerate the missing
+ closing bracket).
+ *************************************************************************************************************************/
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+static FILE *trace_file = NULL;
+static ui8 trace_origin;
+static si4 trace_events;
+static ui4 trace_next_thread = 1;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread ui4 trace_thread = 0;
+
+ui8 trace_clock(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((ui8) ts.tv_sec * 1000000000 + (ui8) ts.tv_nsec);
+}
+
+si4 trace_open(si1 *path)
+{
+    trace_file = fopen(path, "w");
+    if (trace_file == NULL)
+    {
+        fprintf(stderr, "Error opening trace file %s\n", path);
+        return(1);
+    }
+    trace_origin = trace_clock();
+    trace_events = 0;
+    fprintf(trace_file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    
+    return(0);
+}
+
+void trace_close(void)
+{
+    if (trace_file == NULL)
+        return;
+    
+    pthread_mutex_lock(&trace_mutex);
+    fprintf(trace_file, "\n]}\n");
+    if (fclose(trace_file) != 0)
+        fprintf(stderr, "Error writing trace file\n");
+    trace_file = NULL;
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+void trace_span(const si1 *name, const si1 *category, ui8 start, si8 arg)
+{
+    ui8 end;
+    
+    if (trace_file == NULL)
+        return;
+    
+    end = trace_clock();
+    pthread_mutex_lock(&trace_mutex);
+    if (trace_thread == 0)
+        trace_thread = trace_next_thread++;
+    if (trace_file != NULL)
+    {
+        fprintf(trace_file, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u",
+                trace_events ? ",\n" : "", name, category, (start - trace_origin) / 1e3, (end - start) / 1e3,
+                (int) getpid(), trace_thread);
+        if (arg >= 0)
+            fprintf(trace_file, ",\"args\":{\"n\":%lld}", (long long) arg);
+        fputc('}', trace_file);
+        trace_events++;
+    }
+    pthread_mutex_unlock(&trace_mutex);
+}
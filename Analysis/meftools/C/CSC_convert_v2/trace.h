@@ -0,0 +1,14 @@
+#ifndef __NCS_2_MEF_TRACE
+#define __NCS_2_MEF_TRACE
+
+#include "mef.h"
+
+// Opt-in timeline for Ncs2Mef2 (-T file).  Spans are written as Chrome trace-event JSON, which chrome://tracing and
+// ui.perfetto.dev open.  Without trace_open() every call is a no-op.
+
+si4  trace_open(si1 *path);
+void trace_close(void);
+ui8  trace_clock(void);
+void trace_span(const si1 *name, const si1 *category, ui8 start, si8 arg);
+
+#endif
@@ -26,10 +26,15 @@
 #include <math.h>
 #include <pthread.h>
 #include <limits.h>
+#include <errno.h>
 
 //#include "recordmef.h"
 #include "mef.h"
 #include "write_mef_channel_mef2.h"
+#include "trace.h"
+#ifdef USE_LIBMEFTOOLS
+#include "meftools_c.h"
+#endif
 
 
 
@@ -51,17 +56,6 @@ extern si1		**chan_map;
 
 
 
-// this creates a single static data block for use by all channels
-// this assumes all channels will need the same size data block
-ui1* GetDataBlockBuffer(ui8 block_len)
-{
-    static ui1 *buff = 0;
-    
-    if (buff == 0) 
-        buff = (ui1 *) malloc(block_len * 8);
-
-    return buff;
-}
 
 si4 add_block_index_to_channel_list(CHANNEL_STATE *channel_state, ui8 block_hdr_time, ui8 outfile_data_offset, ui8 num_elements_processed)
 {
@@ -179,7 +173,6 @@ si4 initialize_mef_channel_data ( CHANNEL_STATE *channel_state, MEF_HEADER_INFO
 {
     ui8 nr;
     si1 temp_str[1024];
-    extern int errno;
     ui1 *out_header;
     
     channel_state->chan_num = chan_num;
@@ -210,6 +203,7 @@ si4 initialize_mef_channel_data ( CHANNEL_STATE *channel_state, MEF_HEADER_INFO
     channel_state->block_index_current         = NULL;
     channel_state->discontinuity_index_head    = NULL;
     channel_state->discontinuity_index_current = NULL;
+    channel_state->qc_file                     = NULL;
     
     // Open channel output file, and write header to it
     if (path != NULL)
@@ -309,7 +303,13 @@ si4 initialize_mef_channel_data ( CHANNEL_STATE *channel_state, MEF_HEADER_INFO
     free(out_header);
     
     // make these part of the channel state to keep everything thread-safe
-    channel_state->out_data = (ui1 *) malloc(32000 * 8);  // This assumes 1 second blocks, sampled at 32000 Hz
+    // compressed block can't exceed the header plus 8 bytes per sample the raw buffer holds
+    channel_state->out_data = (ui1 *) malloc((size_t) (secs_per_block * header_ptr->sampling_frequency * 1.10) * 8 + BLOCK_HEADER_BYTES);
+    if (channel_state->out_data == NULL)
+    {
+        fprintf(stderr, "Insufficient memory to allocate compressed block buffer\n");
+        exit(1);
+    }
     channel_state->temp_mtf_index = (ui1*) malloc(sizeof(ui8) * 3);
     
     // handle line noise scoring
@@ -319,6 +319,107 @@ si4 initialize_mef_channel_data ( CHANNEL_STATE *channel_state, MEF_HEADER_INFO
     return(0);
 }
 
+si4 enable_mef_channel_qc(CHANNEL_STATE *channel_state, si1 *chan_map_name, si1 *path, sf8 line_frequency,
+                          si4 clip_low, si4 clip_high)
+{
+    si1 temp_str[1024];
+    
+    // Open channel quality table next to the .mef, and write its column names
+    if (path != NULL)
+        sprintf(temp_str, "%s/%s.qc", path, chan_map_name);
+    else
+        sprintf(temp_str, "%s.qc", chan_map_name);
+    channel_state->qc_file = fopen(temp_str, "w");
+    if (channel_state->qc_file == NULL)
+    {
+        fprintf(stderr, "Error creating quality output file \"%s\" %s\n", temp_str, strerror(errno));
+        return(1);
+    }
+    fprintf(channel_state->qc_file, "block_time\tsamples\tdiscontinuity\trms\tline_noise_rms\tline_noise_fraction\tclip_fraction\tlongest_flat_run\tflatline\n");
+    
+    // rails are compared against stored samples, so follow the 18-bit shift
+    if (channel_state->bit_shift_flag)
+    {
+        clip_low  /= 4;
+        clip_high /= 4;
+    }
+    channel_state->qc_line_frequency = line_frequency;
+    channel_state->qc_clip_low       = clip_low;
+    channel_state->qc_clip_high      = clip_high;
+    
+    return(0);
+}
+
+// Score one block of stored samples and append a row to the channel's quality table.
+// Line noise is the power of the line frequency and its harmonics (Goertzel, on the mean-removed block),
+// reported as an RMS and as a fraction of the block variance.
+si4 write_block_quality(CHANNEL_STATE *channel_state, si4 *samps, ui4 num_entries, ui8 block_hdr_time,
+                        si4 discontinuity_flag, sf8 sampling_frequency)
+{
+    ui4 i, clipped, run, longest_run;
+    si4 h, clip_low, clip_high;
+    sf8 mean, variance, d, w, coeff, s0, s1, s2, line_power, line_fraction;
+    
+    if (num_entries == 0)
+        return(0);
+    
+    clip_low  = channel_state->qc_clip_low;
+    clip_high = channel_state->qc_clip_high;
+    
+    // mean, clipping and the longest run of identical samples in one pass
+    mean = 0.0;
+    clipped = 0;
+    run = longest_run = 1;
+    for (i = 0; i < num_entries; i++)
+    {
+        mean += (sf8) samps[i];
+        if (samps[i] <= clip_low || samps[i] >= clip_high)
+            clipped++;
+        if (i > 0)
+        {
+            run = (samps[i] == samps[i-1]) ? run + 1 : 1;
+            if (run > longest_run) longest_run = run;
+        }
+    }
+    mean /= (sf8) num_entries;
+    
+    variance = 0.0;
+    for (i = 0; i < num_entries; i++)
+    {
+        d = (sf8) samps[i] - mean;
+        variance += d * d;
+    }
+    variance /= (sf8) num_entries;
+    
+    line_power = 0.0;
+    for (h = 1; h <= QC_LINE_HARMONICS; h++)
+    {
+        if (channel_state->qc_line_frequency <= 0.0 || h * channel_state->qc_line_frequency >= sampling_frequency / 2.0)
+            break;
+        w = 2.0 * M_PI * h * channel_state->qc_line_frequency / sampling_frequency;
+        coeff = 2.0 * cos(w);
+        s1 = s2 = 0.0;
+        for (i = 0; i < num_entries; i++)
+        {
+            s0 = ((sf8) samps[i] - mean) + coeff * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        // a sinusoid of amplitude A gives |X| = A N / 2, and carries A^2 / 2 of power
+        line_power += 2.0 * (s1 * s1 + s2 * s2 - coeff * s1 * s2) / ((sf8) num_entries * (sf8) num_entries);
+    }
+    line_fraction = (variance > 0.0) ? line_power / variance : 0.0;
+    if (line_fraction > 1.0) line_fraction = 1.0;
+    
+    if (fprintf(channel_state->qc_file, "%llu\t%u\t%d\t%.3f\t%.3f\t%.4f\t%.6f\t%u\t%d\n",
+                (unsigned long long) block_hdr_time, num_entries, discontinuity_flag ? 1 : 0, sqrt(variance),
+                sqrt(line_power), line_fraction, (sf8) clipped / (sf8) num_entries, longest_run,
+                (longest_run >= QC_FLATLINE_SECS * sampling_frequency) ? 1 : 0) < 0)
+        return(1);
+    
+    return(0);
+}
+
 si4 process_filled_block( CHANNEL_STATE *channel_state, si4* raw_data_ptr_start, ui4 num_entries, 
                          ui8 block_len, si4 discontinuity_flag, ui8 block_hdr_time, sf8 sampling_frequency)
 {
@@ -332,6 +433,7 @@ si4 process_filled_block( CHANNEL_STATE *channel_state, si4* raw_data_ptr_start,
     si4 return_value;
     ui1 noise_score;
     char cmd[200];
+    ui8 span_start;
     
     // bring in data from channel_state struct
     max_block_size                  = channel_state->max_block_size;
@@ -353,15 +455,8 @@ si4 process_filled_block( CHANNEL_STATE *channel_state, si4* raw_data_ptr_start,
     
     memset(data_key, 0, 240);  // for now, assume no data encryption
     
-    // use a static out_data buffer, this buffer is shared across channels, so this will only
-    // work if the block_len of all channels is the same.  If different channels need different
-    // block_lens (ie, different sampling rates), then this block buffer will need to be part
-    // of the channel struct.
-    //out_data = GetDataBlockBuffer(block_len);
-    
-    // previous method (GetDataBlockBuffer) is not thread-safe, so use this method.
-    // TBD clean this up, so it will works with any block_len, rather than hard-coding
-    // 1 second blocks.
+    // each channel owns its output buffer, so channels can be written from different threads.
+    // out_data is sized from secs_per_block in initialize_mef_channel_data().
     out_data = channel_state->out_data;
     
     
@@ -377,18 +472,32 @@ si4 process_filled_block( CHANNEL_STATE *channel_state, si4* raw_data_ptr_start,
                 *ddp++ = (si4) (((sf8) *ddp / (sf8) 4.0) - 0.5);
         }
     }
-		//if (num_entries == channel_state->normal_block_size)
-	//{
-    	//noise_score = line_noise_score(channel_state, raw_data_ptr_start, num_entries, sampling_frequency, 60.0, channel_state->normal_block_size);
-    	//if (noise_score < line_noise_threshold)
-    	//{
-        //	send_quality_email(noise_score, channel_state->chan_num);
-		//}
-	//}
+    
+    // score the block while the raw samples are still at hand, rather than in a later decode pass
+    if (channel_state->qc_file != NULL)
+    {
+        span_start = trace_clock();
+        if (write_block_quality(channel_state, raw_data_ptr_start, num_entries, block_hdr_time,
+                                discontinuity_flag, sampling_frequency) != 0)
+            return_value = 1;
+        trace_span("quality", "compute", span_start, num_entries);
+    }
     
     // RED compress data block
+    span_start = trace_clock();
+#ifdef USE_LIBMEFTOOLS
+    // same bytes as RED_compress_block; the block statistics are read back from the header it wrote
+    RED_block_size = meftools_compress_block(raw_data_ptr_start, num_entries, block_hdr_time,
+                                             (ui1)discontinuity_flag, NULL, out_data, NULL);
+    if (RED_block_size == 0)
+        return (1);
+    read_RED_block_header(out_data, &block_hdr);
+#else
     RED_block_size = RED_compress_block(raw_data_ptr_start, out_data, num_entries, 
                                         block_hdr_time, (ui1)discontinuity_flag, (si1*)data_key, MEF_FALSE, &block_hdr);
+#endif
+    trace_span("compress_block", "compute", span_start, num_entries);
+    span_start = trace_clock();
     // write block to output file
     //pthread_mutex_lock(&protect_fwrite);
 
@@ -408,6 +517,7 @@ si4 process_filled_block( CHANNEL_STATE *channel_state, si4* raw_data_ptr_start,
         }
     
     //pthread_mutex_unlock(&protect_fwrite);
+    trace_span("write_block", "io", span_start, RED_block_size);
     
 #ifdef _LOCAL_COPY
     if (recording_to_local)
@@ -560,6 +670,7 @@ si4 close_mef_channel_file(CHANNEL_STATE *channel_state, MEF_HEADER_INFO *header
     ui1 *ui1_p1, *ui1_p2;
     ui8 discontinuity_data_offset;     
     ui1 *file_uid_array;
+    ui8 span_start;
     
     // set local constants
     block_len = (ui8) ceil(secs_per_block * header_ptr->sampling_frequency); //user-defined block size (s), convert to # of samples
@@ -579,6 +690,7 @@ si4 close_mef_channel_file(CHANNEL_STATE *channel_state, MEF_HEADER_INFO *header
     // finish and write the last block with leftover buffers
     process_filled_block(channel_state, raw_data_ptr_start, (raw_data_ptr_current - raw_data_ptr_start), 
                          block_len, discontinuity_flag, block_hdr_time, header_ptr->sampling_frequency);
+    span_start = trace_clock();
     
     // update remaining unfilled mef header fields
     discontinuity_data_offset = channel_state->outfile_data_offset + (channel_state->number_of_index_entries * 3 * sizeof(ui8));
@@ -711,6 +823,7 @@ si4 close_mef_channel_file(CHANNEL_STATE *channel_state, MEF_HEADER_INFO *header
         }
     
         fclose(ofp);
+        trace_span("write_index_header", "io", span_start, channel_state->number_of_index_entries);
     
         // close and delete temp index file
         fclose(ofp_mtf);
@@ -758,6 +871,12 @@ si4 close_mef_channel_file(CHANNEL_STATE *channel_state, MEF_HEADER_INFO *header
     free(channel_state->out_data);
     free(channel_state->temp_mtf_index);
     
+    if (channel_state->qc_file != NULL)
+    {
+        fclose(channel_state->qc_file);
+        channel_state->qc_file = NULL;
+    }
+    
     return(0);
 }
 
@@ -1,9 +1,6 @@
 #include <time.h>
 
 
-#define SECS_PER_BLOCK 1
-
-
 
 typedef struct {
     ui8	timestamp;
@@ -61,6 +58,10 @@ typedef struct {
     DISCONTINUITY_INDEX_ELEMENT *discontinuity_index_head;
     DISCONTINUITY_INDEX_ELEMENT *discontinuity_index_current;
     si4 normal_block_size;
+    FILE    *qc_file;              // per-block quality table, NULL when QC is off
+    sf8     qc_line_frequency;     // AC line frequency (Hz) scored by the QC pass
+    si4     qc_clip_low;           // ADC rails, in stored (post bit-shift) units
+    si4     qc_clip_high;
 } CHANNEL_STATE;
 
 
@@ -77,7 +78,13 @@ si4 write_mef_channel_data(CHANNEL_STATE *channel_state, MEF_HEADER_INFO *header
                            ui8 n_packets_to_process, sf8 secs_per_block);
 si4 close_mef_channel_file(CHANNEL_STATE *channel_state, MEF_HEADER_INFO *header_ptr, si1* session_password,
                            si1 *subject_password, sf8 secs_per_block);
+si4 enable_mef_channel_qc(CHANNEL_STATE *channel_state, si1 *chan_map_name, si1 *path, sf8 line_frequency,
+                          si4 clip_low, si4 clip_high);
 
 
 #define DISCONTINUITY_TIME_THRESHOLD 100000
 
+// Quality-control sidecar (<channel>.qc): one tab-separated row per block, written as blocks are compressed.
+#define QC_LINE_HARMONICS       3       // line frequency plus harmonics scored, those below Nyquist
+#define QC_FLATLINE_SECS        0.1     // a run of identical samples at least this long marks the block flat
+
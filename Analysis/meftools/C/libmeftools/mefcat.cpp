@@ -0,0 +1,310 @@
+/*
+		mefcat
+
+ Stream the decoded samples of a MEF (v.2.1) channel to stdout or a file, for shell and Python pipelines.
+
+ Output is raw little-endian binary with no header, one record per sample:
+
+ int16     raw sample, 2 bytes (fails if a sample does not fit, unless -S)
+ int32     raw sample, 4 bytes (the default)
+ float32   sample in microvolts (raw * voltage_conversion_factor), 4 bytes
+
+ With -T each record is preceded by the sample's uUTC time as a uint64, so a gap in the recording shows
+ up as a jump in the time column (e.g. numpy: np.dtype([('t', '<u8'), ('x', '<i4')])).
+
+ Blocks are decoded a tile at a time: the blocks of a tile are decoded and formatted in parallel straight
+ into one output buffer, which is handed to a writer thread while the next tile is decoded into a second
+ buffer, so the decoder and the pipe run concurrently and every write() is a multi-megabyte one.
+
+ -p password   session password (needed for encrypted headers or data)
+ -f format     int16, int32 or float32
+ -S            clamp samples that do not fit int16 instead of failing
+ -s s0 s1      samples s0..s1 (inclusive); default: the whole file
+ -t t0 t1      every sample timed within t0..t1 (uUTC, inclusive)
+ -T            prefix each sample with its uUTC time (uint64)
+ -j threads    decode threads (default: one per core)
+ -o out_file   write to out_file instead of stdout
+ -v            report samples, segments and throughput on stderr
+
+ USAGE: mefcat [-p password] [-f int16|int32|float32] [-S] [-s s0 s1 | -t t0 t1] [-T] [-j threads] [-o out_file] [-v] file (.mef)
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "libmeftools.h"
+#include "meftools_export.h"
+#include "meftools_parallel.h"
+
+#define MEFCAT_TILE_SAMPLES     (1 << 21)   // decoded samples per tile (rounded up to whole blocks)
+#define MEFCAT_ALIGNMENT        4096
+
+#define USAGE "USAGE: %s [-p password] [-f int16|int32|float32] [-S] [-s s0 s1 | -t t0 t1] [-T] [-j threads] [-o out_file] [-v] file (.mef)\n"
+
+enum { FORMAT_INT16, FORMAT_INT32, FORMAT_FLOAT32 };
+
+typedef struct {
+    int     format;
+    bool    saturate;
+    bool    time_column;
+    size_t  sample_bytes;   // bytes of the sample field
+    size_t  record_bytes;   // bytes per output record, including the time column
+    sf8     scale;          // microvolts per unit, for float32
+} MEFCAT_OUTPUT;
+
+namespace {
+
+    using namespace meftools;
+
+    // Format samples [s0, s1] of block b, whose decoded samples start at in, into out. Returns the
+    // number of int16 samples that had to be clamped.
+    ui8 format_block(const MefChannel &channel, const MEFCAT_OUTPUT &fmt, ui8 b, ui8 s0, ui8 s1,
+                     const si4 *in, ui1 *out)
+    {
+        const INDEX_DATA &entry = channel.index()[b];
+        sf8 usecs_per_sample = 1000000.0 / channel.header().sampling_frequency;
+        ui8 s, t, clipped = 0;
+        si4 v;
+        si2 v16;
+        sf4 f;
+
+        for (s = s0; s <= s1; s++, out += fmt.record_bytes) {
+            ui1 *p = out;
+            if (fmt.time_column) {
+                t = entry.time + (ui8) (0.5 + usecs_per_sample * (sf8) (s - entry.sample_number));
+                memcpy(p, &t, sizeof(ui8));
+                p += sizeof(ui8);
+            }
+            v = in[s - entry.sample_number];
+            switch (fmt.format) {
+            case FORMAT_INT16:
+                if (v > SHRT_MAX) { v = SHRT_MAX; clipped++; }
+                else if (v < SHRT_MIN) { v = SHRT_MIN; clipped++; }
+                v16 = (si2) v;
+                memcpy(p, &v16, sizeof(si2));
+                break;
+            case FORMAT_INT32:
+                memcpy(p, &v, sizeof(si4));
+                break;
+            case FORMAT_FLOAT32:
+                f = (sf4) ((sf8) v * fmt.scale);
+                memcpy(p, &f, sizeof(sf4));
+                break;
+            }
+        }
+        return clipped;
+    }
+
+    //
+    //  Stream samples [s0, s1] of one segment piece. out[] are two buffers of tile_bytes; the writer thread
+    //  carries over between pieces so that the last write of one overlaps the first decode of the next.
+    //
+    si4 stream_piece(const MefChannel &channel, const MEFCAT_OUTPUT &fmt, ui8 s0, ui8 s1, int threads,
+                     std::vector<si4> &decoded, ui1 *out[2], int *current, BackgroundWriter &writer, ui8 *clipped)
+    {
+        ui8 b0 = channel.block_of_sample(s0), b1 = channel.block_of_sample(s1);
+        ui8 first, last, tile_first, tile_samples;
+
+        while (b0 <= b1) {
+            // a tile is a run of whole blocks holding up to MEFCAT_TILE_SAMPLES decoded samples
+            tile_first = channel.index()[b0].sample_number;
+            last = b0;
+            while (last < b1 && channel.index()[last + 1].sample_number + channel.block_samples(last + 1) - tile_first
+                   <= (ui8) MEFCAT_TILE_SAMPLES)
+                last++;
+            tile_samples = channel.index()[last].sample_number + channel.block_samples(last) - tile_first;
+            if (decoded.size() < tile_samples)
+                decoded.resize(tile_samples);
+
+            first = std::max(s0, tile_first);
+            ui1 *dst = out[*current];
+            std::vector<si4> results(last - b0 + 1, MEF_OK);
+            std::vector<ui8> clips(last - b0 + 1, 0);
+            TraceSpan span("decode_tile", "mefcat", (si8) tile_samples);
+            parallel_for((size_t) (last - b0 + 1), threads, [&](size_t i) {
+                ui8 b = b0 + i;
+                ui8 block_first = channel.index()[b].sample_number;
+                ui8 a = std::max(first, block_first), z = std::min(s1, block_first + channel.block_samples(b) - 1);
+                si4 *in = &decoded[block_first - tile_first];
+                results[i] = channel.decode_blocks(b, b, in);
+                if (results[i] == MEF_OK && a <= z)
+                    clips[i] = format_block(channel, fmt, b, a, z, in, dst + (a - first) * fmt.record_bytes);
+            });
+            span.stop();
+            for (size_t i = 0; i < results.size(); i++) {
+                if (results[i])
+                    return(results[i]);
+                *clipped += clips[i];
+            }
+
+            size_t bytes = (std::min(s1, tile_first + tile_samples - 1) - first + 1) * fmt.record_bytes;
+            si4 err = writer.write(dst, bytes);
+            if (err)
+                return(err);
+            *current ^= 1;
+            b0 = last + 1;
+        }
+        return(MEF_OK);
+    }
+
+}
+
+
+int main(int argc, char * const argv[])
+{
+    MefChannel channel;
+    MEFCAT_OUTPUT fmt;
+    std::vector<std::pair<ui8, ui8> > pieces;
+    std::vector<MEF_SEGMENT> segs;
+    const char *password = "", *out_path = NULL;
+    ui8 a = 0, b = 0, s0, s1, total, clipped;
+    si4 err, minimum, maximum;
+    int opt, by_sample = 0, by_time = 0, verbose = 0, threads = 0, fd, current;
+    struct timespec start, end;
+    size_t i;
+
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.format = FORMAT_INT32;
+    while ((opt = getopt(argc, argv, "p:f:Ss:t:Tj:o:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p': password = optarg; break;
+            case 'f':
+                if (strcmp(optarg, "int16") == 0) fmt.format = FORMAT_INT16;
+                else if (strcmp(optarg, "int32") == 0) fmt.format = FORMAT_INT32;
+                else if (strcmp(optarg, "float32") == 0) fmt.format = FORMAT_FLOAT32;
+                else {
+                    fprintf(stderr, "%s: unknown format '%s'\n", argv[0], optarg);
+                    return(1);
+                }
+                break;
+            case 'S': fmt.saturate = true; break;
+            case 's': by_sample = 1; a = strtoul(optarg, NULL, 10); break;
+            case 't': by_time = 1; a = strtoul(optarg, NULL, 10); break;
+            case 'T': fmt.time_column = true; break;
+            case 'j': threads = atoi(optarg); break;
+            case 'o': out_path = optarg; break;
+            case 'v': verbose = 1; break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                return(1);
+        }
+        // the range's second value follows its option as a separate argument
+        if ((opt == 's' || opt == 't') && optind < argc)
+            b = strtoul(argv[optind++], NULL, 10);
+    }
+    if (optind != argc - 1 || (by_sample && by_time))
+    {
+        fprintf(stderr, USAGE, argv[0]);
+        return(1);
+    }
+
+    err = channel.open(argv[optind], password);
+    if (err)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], error_string(err));
+        return(1);
+    }
+    fmt.sample_bytes = fmt.format == FORMAT_INT16 ? sizeof(si2) : 4;
+    fmt.record_bytes = fmt.sample_bytes + (fmt.time_column ? sizeof(ui8) : 0);
+    fmt.scale = channel.microvolts_per_unit();
+
+    // the sample ranges to emit, one per contiguous segment piece
+    if (by_time)
+    {
+        segs = channel.segments(a, b);
+        for (i = 0; i < segs.size(); i++)
+            if (channel.clip_segment(segs[i], a, b, &s0, &s1))
+                pieces.push_back(std::make_pair(s0, s1));
+    }
+    else if (channel.header().number_of_samples > 0 && channel.number_of_blocks() > 0)
+    {
+        s0 = by_sample ? a : 0;
+        s1 = by_sample ? b : channel.header().number_of_samples - 1;
+        if (s1 < s0 || s1 >= channel.header().number_of_samples)
+        {
+            fprintf(stderr, "%s: %s\n", argv[optind], error_string(MEF_ERR_RANGE));
+            return(1);
+        }
+        pieces.push_back(std::make_pair(s0, s1));
+    }
+
+    if (fmt.format == FORMAT_INT16 && !fmt.saturate)
+    {
+        for (i = 0; i < pieces.size(); i++)
+        {
+            err = channel.block_range(channel.block_of_sample(pieces[i].first), channel.block_of_sample(pieces[i].second),
+                                      &minimum, &maximum);
+            if (err == MEF_OK && (minimum < SHRT_MIN || maximum > SHRT_MAX))
+                err = MEF_ERR_OVERFLOW;
+            if (err)
+            {
+                fprintf(stderr, "%s: %s%s\n", argv[optind], error_string(err),
+                        err == MEF_ERR_OVERFLOW ? "; use -S to clamp them" : "");
+                return(1);
+            }
+        }
+    }
+
+    fd = out_path == NULL ? STDOUT_FILENO : open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "%s: %s\n", out_path, error_string(MEF_ERR_WRITE));
+        return(1);
+    }
+
+    // two output tiles: the writer drains one while the decoders fill the other. A tile can span at
+    // most MEFCAT_TILE_SAMPLES samples or a single block, whichever is larger.
+    size_t tile_bytes = std::max((ui8) MEFCAT_TILE_SAMPLES, channel.header().maximum_block_length) * fmt.record_bytes;
+    ui1 *out[2] = { NULL, NULL };
+    if (posix_memalign((void **) &out[0], MEFCAT_ALIGNMENT, tile_bytes) != 0
+        || posix_memalign((void **) &out[1], MEFCAT_ALIGNMENT, tile_bytes) != 0)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], error_string(MEF_ERR_MEMORY));
+        return(1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    std::vector<si4> decoded;
+    BackgroundWriter writer(fd);
+    current = 0;
+    total = clipped = 0;
+    err = MEF_OK;
+    for (i = 0; i < pieces.size() && err == MEF_OK; i++)
+    {
+        err = stream_piece(channel, fmt, pieces[i].first, pieces[i].second, threads, decoded, out, &current,
+                           writer, &clipped);
+        total += pieces[i].second - pieces[i].first + 1;
+    }
+    if (writer.wait() != MEF_OK && err == MEF_OK)
+        err = writer.wait();
+    if (out_path != NULL && close(fd) != 0 && err == MEF_OK)
+        err = MEF_ERR_WRITE;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(out[0]);
+    free(out[1]);
+
+    if (err)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], error_string(err));
+        return(1);
+    }
+    if (verbose)
+    {
+        sf8 secs = (sf8) (end.tv_sec - start.tv_sec) + 1e-9 * (sf8) (end.tv_nsec - start.tv_nsec);
+        fprintf(stderr, "%s: %lu samples in %lu segment(s), %lu clamped, %.3f s, %.1f MB/s out\n", argv[optind],
+                total, (ui8) pieces.size(), clipped, secs, secs > 0 ? (sf8) (total * fmt.record_bytes) / secs / 1e6 : 0.0);
+    }
+
+    return(0);
+}
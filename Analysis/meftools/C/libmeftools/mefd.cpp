@@ -0,0 +1,61 @@
+/*
+		mefd
+
+ Per-node MEF decode server. Keeps every channel it is asked for open, decodes each block once into a cache
+ shared by all clients, and answers sample, time-window and epoch requests on a Unix domain socket with the
+ samples in shared memory (see meftools_daemon.h for the protocol). R clients use mefd_times() and
+ mefd_epochs(); C++ clients meftools::daemon_read_*().
+
+ -s socket      socket path (default /tmp/mefd.sock)
+ -c cache_mb    decoded-sample cache size in MB (default 4096)
+
+ The socket is created with the caller's umask, so the umask decides who may use the daemon (and so read
+ any channel whose password they know through it).
+
+ USAGE: mefd [-s socket] [-c cache_mb]
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "libmeftools.h"
+
+#define MEFD_SOCKET     "/tmp/mefd.sock"
+#define MEFD_CACHE_MB   4096
+
+static const char *socket_path = MEFD_SOCKET;
+
+static void stop(int)
+{
+    unlink(socket_path);
+    _exit(0);
+}
+
+int main(int argc, char * const argv[])
+{
+    size_t cache_mb = MEFD_CACHE_MB;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:c:")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': socket_path = optarg; break;
+            case 'c': cache_mb = strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "USAGE: %s [-s socket] [-c cache_mb]\n", argv[0]);
+                return(1);
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    meftools::daemon_serve(socket_path, cache_mb << 20);
+    fprintf(stderr, "%s: cannot serve on %s (already in use, or not writable)\n", argv[0], socket_path);
+    return(1);
+}
@@ -1,19 +1,124 @@
+/*
+		readMef
 
+ Example client of libmeftools: prints the header fields and contiguous segments of a MEF (v.2.1)
+ file, then reads the requested samples, by number or by time, and prints a summary of them.
 
+ -p password   session password (needed for encrypted headers or data)
+ -s s0 s1      read samples s0..s1 (inclusive)
+ -t t0 t1      read every sample timed within t0..t1 (uUTC, inclusive)
+ -v            print the samples themselves, one per line
 
+ USAGE: readMef [-p password] [-s s0 s1 | -t t0 t1] [-v] file (.mef)
 
+ */
 
-void readMef( char* filename, char* password ) {
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-	MEF_INFO mefInfo = read_mef_header( filename, password );
+#include <vector>
 
-	iterCont <- meftools::MEFcont( filename, 'erlichda', compArgs_caseSpecific$get('bufferSize'), window=timeConstraints, info=compArgs_caseSpecific$get('info') )
+#include "libmeftools.h"
 
-	while ( iterCont$hasNext() ) {
-	        counterIdx = counterIdx + 1;
-        	data = iterData$nextElem();
-	        peaks <- NPI:::computePeaks( peakComputationVariables, data, compArgs_caseSpecific )
-	}
+#define USAGE "USAGE: %s [-p password] [-s s0 s1 | -t t0 t1] [-v] file (.mef)\n"
 
-}
 
+int main(int argc, char * const argv[])
+{
+    meftools::MefChannel channel;
+    std::vector<meftools::MEF_SEGMENT> segs;
+    std::vector<si4> samples;
+    std::vector<ui8> starts;
+    const char *password = "";
+    ui8 a = 0, b = 0;
+    si8 sum;
+    si4 err, lo, hi;
+    int opt, by_sample = 0, by_time = 0, verbose = 0;
+    size_t i;
+
+    while ((opt = getopt(argc, argv, "p:s:t:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p': password = optarg; break;
+            case 's': by_sample = 1; a = strtoul(optarg, NULL, 10); break;
+            case 't': by_time = 1; a = strtoul(optarg, NULL, 10); break;
+            case 'v': verbose = 1; break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                return(1);
+        }
+        // the range's second value follows its option as a separate argument
+        if ((opt == 's' || opt == 't') && optind < argc)
+            b = strtoul(argv[optind++], NULL, 10);
+    }
+    if (optind != argc - 1 || (by_sample && by_time))
+    {
+        fprintf(stderr, USAGE, argv[0]);
+        return(1);
+    }
+
+    err = channel.open(argv[optind], password);
+    if (err)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], meftools::error_string(err));
+        return(1);
+    }
+
+    const MEF_HEADER_INFO &h = channel.header();
+    printf("channel_name\t%s\n", h.channel_name);
+    printf("number_of_samples\t%lu\n", h.number_of_samples);
+    printf("sampling_frequency\t%g\n", h.sampling_frequency);
+    printf("recording_start_time\t%lu\n", h.recording_start_time);
+    printf("recording_end_time\t%lu\n", h.recording_end_time);
+    printf("voltage_conversion_factor\t%g\n", h.voltage_conversion_factor);
+    printf("number_of_blocks\t%lu\n", channel.number_of_blocks());
+
+    segs = channel.segments();
+    printf("segments\t%lu\n", (ui8) segs.size());
+    for (i = 0; i < segs.size(); i++)
+        printf("segment\t%lu\t%lu\t%lu\t%lu\n", segs[i].first_sample, segs[i].last_sample, segs[i].start_time, segs[i].end_time);
+
+    if (!by_sample && !by_time)
+        return(0);
+
+    if (by_sample)
+    {
+        if (b < a || b >= h.number_of_samples)
+        {
+            fprintf(stderr, "%s: %s\n", argv[optind], meftools::error_string(meftools::MEF_ERR_RANGE));
+            return(1);
+        }
+        samples.resize(b - a + 1);
+        err = channel.read_samples(a, b, &samples[0]);
+        starts.push_back(a);
+    }
+    else
+        err = channel.read_times(a, b, samples, &starts);
+    if (err)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], meftools::error_string(err));
+        return(1);
+    }
+
+    sum = 0;
+    lo = hi = samples.empty() ? 0 : samples[0];
+    for (i = 0; i < samples.size(); i++)
+    {
+        sum += samples[i];
+        if (samples[i] < lo) lo = samples[i];
+        if (samples[i] > hi) hi = samples[i];
+    }
+    printf("samples_read\t%lu\n", (ui8) samples.size());
+    printf("pieces\t%lu\n", (ui8) starts.size());
+    printf("minimum\t%d\n", lo);
+    printf("maximum\t%d\n", hi);
+    printf("sum\t%ld\n", sum);
+    if (verbose)
+        for (i = 0; i < samples.size(); i++)
+            printf("%d\n", samples[i]);
+
+    return(0);
+}
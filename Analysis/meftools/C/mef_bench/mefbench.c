@@ -0,0 +1,384 @@
+/*
+		mefbench
+
+ Micro-benchmarks for the MEF (v.2.1) reader and encoder.  The reader is libmeftools' MefChannel, the one
+ decomp_mef and the other R functions decode with; the encoder is mef_lib's, the one Ncs2Mef2 writes with.
+ For each file:
+
+ index    meftools_open: open the file, read and decrypt the header, read and check the block index
+ decode   meftools_decode_buffer over every block, from compressed data already in memory
+ encode   RED_compress_block over every block of the decoded samples; the output is compared with the file's
+          blocks, so a change in the encoder's output shows up here as well as a change in its speed
+ window   random windows read with meftools_read_samples and compared with the full decode
+
+ Each figure is the best of -r repetitions.  MB/s counts the compressed (on-disk) bytes each operation reads or
+ writes, samples/s the samples it produces or consumes; "ops" is files opened for index, windows for window.
+ Output is tab-separated so runs can be diffed or loaded into R.
+
+
+ USAGE: mefbench [-p password] [-r repetitions] [-w window_secs] [-n windows] files (.mef)
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mef.h"
+#include "meftools_c.h"
+
+#define MEFBENCH_REPETITIONS    5
+#define MEFBENCH_WINDOW_SECS    1.0
+#define MEFBENCH_WINDOWS        500
+
+void AES_KeyExpansion();
+
+typedef struct {
+    si1             *file_name;
+    si1             *password;
+    MEF_HEADER_INFO header;
+    INDEX_DATA      *index;
+    ui8             n_blocks;
+    ui8             data_bytes;     // header end to index start
+    ui1             *data;          // compressed blocks, as on disk
+    si4             *samps;         // decoded samples
+    ui1             key[240];
+    meftools_channel *channel;
+} BENCH_FILE;
+
+typedef struct {
+    sf8     best_secs;
+    ui8     ops;
+    ui8     samples;
+    ui8     bytes;
+} BENCH_RESULT;
+
+
+static sf8 now_secs(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (sf8) t.tv_sec + (sf8) t.tv_nsec / 1e9;
+}
+
+static void keep_best(BENCH_RESULT *r, sf8 secs)
+{
+    if (r->best_secs == 0.0 || secs < r->best_secs)
+        r->best_secs = secs;
+}
+
+static void report(BENCH_FILE *f, const char *op, BENCH_RESULT *r)
+{
+    sf8 secs = r->best_secs > 0.0 ? r->best_secs : 1e-9;
+
+    fprintf(stdout, "%s\t%s\t%lu\t%lu\t%lu\t%.6f\t%.1f\t%.0f\t%.1f\n", f->file_name, op, (unsigned long) r->ops,
+            (unsigned long) r->samples, (unsigned long) r->bytes, r->best_secs, r->bytes / secs / 1e6, r->samples / secs,
+            r->ops / secs);
+}
+
+static ui8 block_samples(BENCH_FILE *f, ui8 b)
+{
+    return (b + 1 < f->n_blocks ? f->index[b + 1].sample_number : f->header.number_of_samples) - f->index[b].sample_number;
+}
+
+static ui8 block_offset(BENCH_FILE *f, ui8 b)
+{
+    return (b < f->n_blocks ? f->index[b].file_offset : f->header.index_data_offset) - MEF_HEADER_LENGTH;
+}
+
+// open, read the header and the index; everything a reader does before it can locate a sample
+static si4 load_index(BENCH_FILE *f, MEF_HEADER_INFO *header, INDEX_DATA **index)
+{
+    FILE *fp;
+    ui1 *header_block;
+    si4 result;
+
+    fp = fopen(f->file_name, "r");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening %s\n", f->file_name);
+        return(1);
+    }
+    header_block = (ui1 *) malloc(MEF_HEADER_LENGTH);  // malloc to ensure boundary alignment
+    result = 1;
+    if (fread(header_block, 1, MEF_HEADER_LENGTH, fp) == MEF_HEADER_LENGTH &&
+        read_mef_header_block(header_block, header, f->password) == 0)
+    {
+        *index = (INDEX_DATA *) malloc((size_t) header->number_of_index_entries * sizeof(INDEX_DATA));
+        if (*index != NULL && fseek(fp, (long) header->index_data_offset, SEEK_SET) == 0 &&
+            fread(*index, sizeof(INDEX_DATA), (size_t) header->number_of_index_entries, fp) == header->number_of_index_entries)
+            result = 0;
+    }
+    if (result)
+        fprintf(stderr, "Error reading header and index of %s\n", f->file_name);
+    free(header_block);
+    fclose(fp);
+    return(result);
+}
+
+static si4 open_bench_file(BENCH_FILE *f)
+{
+    FILE *fp;
+    ui8 b;
+    int err;
+
+    if (load_index(f, &f->header, &f->index))
+        return(1);
+    f->n_blocks = f->header.number_of_index_entries;
+    if (f->n_blocks == 0)
+    {
+        fprintf(stderr, "%s has no blocks\n", f->file_name);
+        return(1);
+    }
+    if (f->header.data_encryption_used)
+        AES_KeyExpansion(4, 10, f->key, f->header.session_password);
+    if ((f->channel = meftools_open(f->file_name, f->password, &err)) == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", f->file_name, meftools_error_string(err));
+        return(1);
+    }
+
+    f->data_bytes = f->header.index_data_offset - MEF_HEADER_LENGTH;
+    f->data = (ui1 *) malloc((size_t) f->data_bytes);
+    f->samps = (si4 *) malloc((size_t) f->header.number_of_samples * sizeof(si4));
+    if (f->data == NULL || f->samps == NULL)
+    {
+        fprintf(stderr, "Insufficient memory for %s\n", f->file_name);
+        return(1);
+    }
+    fp = fopen(f->file_name, "r");
+    if (fp == NULL || fseek(fp, MEF_HEADER_LENGTH, SEEK_SET) != 0 || fread(f->data, 1, (size_t) f->data_bytes, fp) != f->data_bytes)
+    {
+        fprintf(stderr, "Error reading blocks of %s\n", f->file_name);
+        if (fp) fclose(fp);
+        return(1);
+    }
+    fclose(fp);
+
+    for (b = 0; b < f->n_blocks; b++)
+    {
+        if (block_offset(f, b + 1) <= block_offset(f, b) || block_offset(f, b + 1) > f->data_bytes ||
+            f->index[b].sample_number + block_samples(f, b) > f->header.number_of_samples)
+        {
+            fprintf(stderr, "%s: index entry %lu is inconsistent\n", f->file_name, (unsigned long) b);
+            return(1);
+        }
+    }
+    return(0);
+}
+
+static void bench_index(BENCH_FILE *f, si4 repetitions, BENCH_RESULT *r)
+{
+    meftools_channel *channel;
+    sf8 t0;
+    si4 i;
+
+    r->ops = 1;
+    r->samples = 0;
+    r->bytes = MEF_HEADER_LENGTH + f->n_blocks * sizeof(INDEX_DATA);
+    for (i = 0; i < repetitions; i++)
+    {
+        t0 = now_secs();
+        channel = meftools_open(f->file_name, f->password, NULL);
+        if (channel != NULL)
+            keep_best(r, now_secs() - t0);
+        meftools_close(channel);
+    }
+}
+
+static si4 bench_decode(BENCH_FILE *f, si4 repetitions, BENCH_RESULT *r)
+{
+    sf8 t0;
+    si4 i, err;
+
+    r->ops = 1;
+    r->samples = f->header.number_of_samples;
+    r->bytes = f->data_bytes;
+    for (i = 0; i < repetitions; i++)
+    {
+        t0 = now_secs();
+        err = meftools_decode_buffer(f->channel, 0, f->n_blocks - 1, f->data + block_offset(f, 0), f->samps);
+        if (err)
+        {
+            fprintf(stderr, "%s: %s\n", f->file_name, meftools_error_string(err));
+            return(1);
+        }
+        keep_best(r, now_secs() - t0);
+    }
+    return(0);
+}
+
+static si4 bench_encode(BENCH_FILE *f, si4 repetitions, BENCH_RESULT *r)
+{
+    ui1 *out_buffer, *block, *ob;
+    RED_BLOCK_HDR_INFO block_hdr;
+    ui8 b, size, mismatches;
+    sf8 t0;
+    si4 i;
+
+    out_buffer = (ui1 *) malloc((size_t) f->header.number_of_samples * 5 + (size_t) f->n_blocks * (BLOCK_HEADER_BYTES + 8));
+    if (out_buffer == NULL)
+        return(1);
+    r->ops = 1;
+    r->samples = f->header.number_of_samples;
+    mismatches = 0;
+    for (i = 0; i < repetitions; i++)
+    {
+        ob = out_buffer;
+        t0 = now_secs();
+        for (b = 0; b < f->n_blocks; b++)
+        {
+            block = f->data + block_offset(f, b);
+            ob += RED_compress_block(f->samps + f->index[b].sample_number, ob, (ui4) block_samples(f, b),
+                                     f->index[b].time, block[RED_DISCONTINUITY_OFFSET], f->key,
+                                     f->header.data_encryption_used, &block_hdr);
+        }
+        keep_best(r, now_secs() - t0);
+        r->bytes = ob - out_buffer;
+    }
+
+    // the file's blocks may carry padding after the compressed bytes, so compare block by block
+    ob = out_buffer;
+    for (b = 0; b < f->n_blocks; b++)
+    {
+        block = f->data + block_offset(f, b);
+        read_RED_block_header(ob, &block_hdr);
+        size = block_hdr.compressed_bytes + BLOCK_HEADER_BYTES;
+        if (size > block_offset(f, b + 1) - block_offset(f, b) || memcmp(ob, block, (size_t) size) != 0)
+            mismatches++;
+        ob += size;
+    }
+    if (mismatches)
+        fprintf(stderr, "%s: %lu of %lu re-encoded blocks differ from the file\n", f->file_name, (unsigned long) mismatches,
+                (unsigned long) f->n_blocks);
+    free(out_buffer);
+    return(0);
+}
+
+static si4 bench_window(BENCH_FILE *f, si4 repetitions, sf8 window_secs, si4 n_windows, BENCH_RESULT *r)
+{
+    si4 i, w, err;
+    si4 *window;
+    ui8 *starts, window_len, s1, lo, hi, mid, b0, b1, bytes, rng;
+    sf8 t0;
+    si4 result;
+
+    window_len = (ui8) (window_secs * f->header.sampling_frequency);
+    if (window_len < 1)
+        window_len = 1;
+    if (window_len > f->header.number_of_samples)
+        window_len = f->header.number_of_samples;
+
+    window = (si4 *) malloc((size_t) window_len * sizeof(si4));
+    starts = (ui8 *) malloc((size_t) n_windows * sizeof(ui8));
+    result = (window == NULL || starts == NULL);
+
+    // the windows, and the compressed bytes of the blocks covering them, are worked out before timing
+    rng = 12345;
+    bytes = 0;
+    for (w = 0; w < n_windows && result == 0; w++)
+    {
+        rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+        starts[w] = (rng >> 16) % (f->header.number_of_samples - window_len + 1);
+        s1 = starts[w] + window_len - 1;
+        lo = 0; hi = f->n_blocks;
+        while (hi - lo > 1)
+        {
+            mid = (lo + hi) / 2;
+            if (f->index[mid].sample_number <= starts[w]) lo = mid; else hi = mid;
+        }
+        b0 = lo;
+        for (b1 = b0; b1 + 1 < f->n_blocks && f->index[b1 + 1].sample_number <= s1; b1++)
+            ;
+        bytes += block_offset(f, b1 + 1) - block_offset(f, b0);
+    }
+
+    r->ops = n_windows;
+    r->samples = (ui8) n_windows * window_len;
+    r->bytes = bytes;
+    for (i = 0; i < repetitions && result == 0; i++)
+    {
+        t0 = now_secs();
+        for (w = 0; w < n_windows && result == 0; w++)
+        {
+            err = meftools_read_samples(f->channel, starts[w], starts[w] + window_len - 1, window);
+            if (err)
+            {
+                fprintf(stderr, "%s: %s\n", f->file_name, meftools_error_string(err));
+                result = 1;
+            }
+            else if (memcmp(window, f->samps + starts[w], (size_t) window_len * sizeof(si4)) != 0)
+            {
+                fprintf(stderr, "%s: window at sample %lu does not match the full decode\n", f->file_name, (unsigned long) starts[w]);
+                result = 1;
+            }
+        }
+        keep_best(r, now_secs() - t0);
+    }
+
+    free(window);
+    free(starts);
+    return(result);
+}
+
+int main(int argc, char * const argv[])
+{
+    BENCH_FILE f;
+    BENCH_RESULT r;
+    si1 *password;
+    sf8 window_secs;
+    si4 repetitions, n_windows, opt, failed;
+
+    password = "";
+    repetitions = MEFBENCH_REPETITIONS;
+    window_secs = MEFBENCH_WINDOW_SECS;
+    n_windows = MEFBENCH_WINDOWS;
+    while ((opt = getopt(argc, argv, "p:r:w:n:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p': password = optarg; break;
+            case 'r': repetitions = atoi(optarg); break;
+            case 'w': window_secs = atof(optarg); break;
+            case 'n': n_windows = atoi(optarg); break;
+            default:
+                fprintf(stderr, "USAGE: %s [-p password] [-r repetitions] [-w window_secs] [-n windows] files (.mef)\n", argv[0]);
+                return(1);
+        }
+    }
+    if (optind >= argc || repetitions < 1 || n_windows < 1 || window_secs <= 0.0)
+    {
+        fprintf(stderr, "USAGE: %s [-p password] [-r repetitions] [-w window_secs] [-n windows] files (.mef)\n", argv[0]);
+        return(1);
+    }
+
+    fprintf(stdout, "file\top\tops\tsamples\tbytes\tbest_secs\tMB/s\tsamples/s\tops/s\n");
+    failed = 0;
+    for (; optind < argc; optind++)
+    {
+        memset(&f, 0, sizeof(f));
+        f.file_name = argv[optind];
+        f.password = password;
+        if (open_bench_file(&f) == 0)
+        {
+            memset(&r, 0, sizeof(r)); bench_index(&f, repetitions, &r); report(&f, "index", &r);
+            memset(&r, 0, sizeof(r));
+            if (bench_decode(&f, repetitions, &r) == 0) report(&f, "decode", &r); else failed = 1;
+            memset(&r, 0, sizeof(r));
+            if (bench_encode(&f, repetitions, &r) == 0) report(&f, "encode", &r); else failed = 1;
+            memset(&r, 0, sizeof(r));
+            if (bench_window(&f, repetitions, window_secs, n_windows, &r) == 0) report(&f, "window", &r); else failed = 1;
+        }
+        else
+            failed = 1;
+        meftools_close(f.channel);
+        free(f.index);
+        free(f.data);
+        free(f.samps);
+    }
+
+    return(failed);
+}
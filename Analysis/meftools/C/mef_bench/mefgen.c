@@ -0,0 +1,261 @@
+/*
+		mefgen
+
+ Writes a synthetic MEF (v.2.1) channel for tests and benchmarks.  The same options and seed always produce the
+ same file, so a corpus can be regenerated anywhere instead of being shipped.
+
+
+ USAGE: mefgen [options] out_file.mef
+
+ -f sampling_freq   sampling frequency (Hz), default 32000
+ -s secs            recording length (s), default 60
+ -b block_secs      block duration (s), default 1
+ -t signal          noise   Gaussian noise, sd 30 units
+                    lfp     10 Hz rhythm, 60 Hz line noise, a slow random walk and a little noise
+                    spikes  low-amplitude lfp with biphasic spikes at a mean 20 Hz
+                    jumps   noise with glitches and steps of 200-100000 units on a fraction of samples (-j),
+                            each one a 4-byte escape in the RED difference stream
+                    mixed   spikes plus jumps, the default
+ -j fraction        fraction of samples that jump, for -t jumps and mixed (default 0.05 and 0.001)
+ -g gap_blocks      start a new segment every gap_blocks blocks (default 0, no discontinuities)
+ -G gap_secs        length of each gap (s), default 5
+ -p password        encrypt the session header and block data with this password
+ -r seed            random seed, default 1
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "mef.h"
+
+#define MEFGEN_START_TIME       1500000000000000ULL     // uUTC of the first sample
+#define MEFGEN_MAX_VALUE        8388607                 // samples must fit the 3-byte RED keys
+#define MEFGEN_SPIKE_RATE       20.0                    // mean spikes per second
+#define MEFGEN_SPIKE_MSECS      1.0
+
+enum { SIGNAL_NOISE, SIGNAL_LFP, SIGNAL_SPIKES, SIGNAL_JUMPS, SIGNAL_MIXED };
+
+static ui8 rng_state;
+
+// xorshift64*, so files do not depend on the platform's rand()
+static ui8 rng_next(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+static sf8 rng_uniform(void)
+{
+    return (sf8) (rng_next() >> 11) / 9007199254740992.0;
+}
+
+static sf8 rng_gaussian(void)
+{
+    sf8 u1, u2;
+
+    do { u1 = rng_uniform(); } while (u1 <= 0.0);
+    u2 = rng_uniform();
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static void generate_samples(si4 *samps, ui8 n, sf8 fs, si4 signal, sf8 jump_fraction)
+{
+    ui8 i, k, spike_len;
+    sf8 x, walk, lfp_gain, next_spike, amplitude, offset;
+
+    walk = 0.0;
+    lfp_gain = (signal == SIGNAL_LFP) ? 1.0 : 0.2;
+    spike_len = (ui8) (MEFGEN_SPIKE_MSECS * fs / 1000.0);
+    if (spike_len < 2)
+        spike_len = 2;
+    next_spike = -log(1.0 - rng_uniform()) * fs / MEFGEN_SPIKE_RATE;
+
+    for (i = 0; i < n; i++)
+    {
+        if (signal == SIGNAL_NOISE || signal == SIGNAL_JUMPS)
+            x = 30.0 * rng_gaussian();
+        else
+        {
+            walk = 0.999 * walk + 20.0 * rng_gaussian();
+            x = lfp_gain * (1000.0 * sin(2.0 * M_PI * 10.0 * i / fs) + 300.0 * sin(2.0 * M_PI * 60.0 * i / fs) + walk) +
+                10.0 * rng_gaussian();
+        }
+        samps[i] = (si4) floor(x + 0.5);
+    }
+
+    // biphasic spikes, a negative peak then a smaller positive one
+    if (signal == SIGNAL_SPIKES || signal == SIGNAL_MIXED)
+    {
+        while (next_spike + spike_len < n)
+        {
+            i = (ui8) next_spike;
+            amplitude = 300.0 + 500.0 * rng_uniform();
+            for (k = 0; k < spike_len; k++)
+                samps[i + k] += (si4) (-amplitude * sin(2.0 * M_PI * k / spike_len) * (k < spike_len / 2 ? 1.0 : 0.4));
+            next_spike += spike_len - log(1.0 - rng_uniform()) * fs / MEFGEN_SPIKE_RATE;
+        }
+    }
+
+    // jumps large enough that the difference needs a 4-byte escape: half are single-sample glitches,
+    // half are steps that shift everything after them
+    if (signal == SIGNAL_JUMPS || signal == SIGNAL_MIXED)
+    {
+        offset = 0.0;
+        for (i = 0; i < n; i++)
+        {
+            if (rng_uniform() < jump_fraction)
+            {
+                amplitude = 200.0 * pow(500.0, rng_uniform()) * (rng_uniform() < 0.5 ? -1.0 : 1.0);
+                if (rng_uniform() < 0.5)
+                    samps[i] += (si4) amplitude;
+                else if (fabs(offset + amplitude) < MEFGEN_MAX_VALUE / 2)
+                    offset += amplitude;
+            }
+            samps[i] += (si4) offset;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        if (samps[i] > MEFGEN_MAX_VALUE) samps[i] = MEFGEN_MAX_VALUE;
+        if (samps[i] < -MEFGEN_MAX_VALUE) samps[i] = -MEFGEN_MAX_VALUE;
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "USAGE: %s [-f sampling_freq] [-s secs] [-b block_secs] [-t noise|lfp|spikes|jumps|mixed] [-j jump_fraction]\n"
+                    "       [-g gap_blocks] [-G gap_secs] [-p password] [-r seed] out_file.mef\n", name);
+}
+
+int main(int argc, char * const argv[])
+{
+    MEF_HEADER_INFO header;
+    INDEX_DATA *index_block;
+    ui1 *discontinuity_array;
+    si4 *samps;
+    si1 *out_file, *base, *ext, password[SESSION_PASSWORD_LENGTH];
+    sf8 fs, secs, block_secs, gap_secs, jump_fraction;
+    ui8 n, samps_per_block, gap_time, seed;
+    si4 num_blocks, gap_blocks, signal, opt, i, result;
+
+    fs = 32000.0;
+    secs = 60.0;
+    block_secs = 1.0;
+    gap_blocks = 0;
+    gap_secs = 5.0;
+    signal = SIGNAL_MIXED;
+    jump_fraction = -1.0;
+    seed = 1;
+    password[0] = 0;
+
+    while ((opt = getopt(argc, argv, "f:s:b:t:j:g:G:p:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f': fs = atof(optarg); break;
+            case 's': secs = atof(optarg); break;
+            case 'b': block_secs = atof(optarg); break;
+            case 'j': jump_fraction = atof(optarg); break;
+            case 'g': gap_blocks = atoi(optarg); break;
+            case 'G': gap_secs = atof(optarg); break;
+            case 'p': strncpy2(password, optarg, SESSION_PASSWORD_LENGTH); break;
+            case 'r': seed = strtoull(optarg, NULL, 10); break;
+            case 't':
+                if (strcmp(optarg, "noise") == 0) signal = SIGNAL_NOISE;
+                else if (strcmp(optarg, "lfp") == 0) signal = SIGNAL_LFP;
+                else if (strcmp(optarg, "spikes") == 0) signal = SIGNAL_SPIKES;
+                else if (strcmp(optarg, "jumps") == 0) signal = SIGNAL_JUMPS;
+                else if (strcmp(optarg, "mixed") == 0) signal = SIGNAL_MIXED;
+                else { usage(argv[0]); return(1); }
+                break;
+            default:
+                usage(argv[0]);
+                return(1);
+        }
+    }
+    if (optind != argc - 1)
+    {
+        usage(argv[0]);
+        return(1);
+    }
+    out_file = (si1 *) argv[optind];
+    if (jump_fraction < 0.0)
+        jump_fraction = (signal == SIGNAL_JUMPS) ? 0.05 : 0.001;
+
+    n = (ui8) (fs * secs);
+    samps_per_block = (ui8) (block_secs * fs);
+    if (fs <= 0.0 || n == 0 || samps_per_block < 2 || samps_per_block > n || gap_blocks < 0 || gap_secs < 0.0)
+    {
+        fprintf(stderr, "Need a positive sampling frequency and length, and blocks of at least 2 samples that fit the recording.\n");
+        return(1);
+    }
+
+    samps = (si4 *) malloc((size_t) n * sizeof(si4));
+    num_blocks = (si4) ((n + samps_per_block - 1) / samps_per_block);
+    index_block = (INDEX_DATA *) calloc((size_t) num_blocks, sizeof(INDEX_DATA));
+    discontinuity_array = (ui1 *) calloc((size_t) num_blocks, sizeof(ui1));
+    if (samps == NULL || index_block == NULL || discontinuity_array == NULL)
+    {
+        fprintf(stderr, "Insufficient memory for %lu samples\n", (unsigned long) n);
+        return(1);
+    }
+
+    rng_state = seed * 0x9E3779B97F4A7C15ULL + 1;
+    generate_samples(samps, n, fs, signal, jump_fraction);
+
+    init_hdr_struct(&header);
+    base = strrchr(out_file, '/');
+    strncpy2(header.channel_name, base ? base + 1 : out_file, CHANNEL_NAME_LENGTH);
+    ext = strrchr(header.channel_name, '.');
+    if (ext != NULL)
+        *ext = 0;
+    strcpy(header.institution, "Mayo Clinic, Rochester, MN, USA");
+    strcpy(header.acquisition_system, "mefgen");
+    sprintf(header.channel_comments, "synthetic, seed %lu", (unsigned long) seed);
+    header.sampling_frequency = fs;
+    header.block_interval = (ui8) (block_secs * 1000000.0 + 0.5);
+    header.number_of_samples = n;
+    header.voltage_conversion_factor = 0.5;
+    header.high_frequency_filter_setting = fs / 2.0;
+    header.recording_start_time = MEFGEN_START_TIME;
+    if (password[0])
+    {
+        strncpy2(header.session_password, password, SESSION_PASSWORD_LENGTH);
+        header.session_encryption_used = 1;
+        header.data_encryption_used = 1;
+    }
+
+    // fixed-length blocks; every gap_blocks-th block starts gap_secs late and is flagged discontinuous
+    gap_time = 0;
+    for (i = 0; i < num_blocks; i++)
+    {
+        if (i == 0 || (gap_blocks > 0 && i % gap_blocks == 0))
+        {
+            discontinuity_array[i] = 1;
+            if (i > 0)
+                gap_time += (ui8) (gap_secs * 1000000.0 + 0.5);
+        }
+        index_block[i].sample_number = (ui8) i * samps_per_block;
+        index_block[i].time = MEFGEN_START_TIME + gap_time + (ui8) floor(index_block[i].sample_number * 1000000.0 / fs + 0.5);
+    }
+    header.recording_end_time = index_block[num_blocks - 1].time +
+                                (ui8) floor((n - index_block[num_blocks - 1].sample_number) * 1000000.0 / fs + 0.5);
+
+    result = write_mef_ind(samps, &header, n, out_file, password, index_block, num_blocks, discontinuity_array);
+    if (result == 0)
+        fprintf(stdout, "%s: %lu samples, %d blocks, %lu bytes of data\n", out_file, (unsigned long) n, num_blocks,
+                (unsigned long) (header.index_data_offset - MEF_HEADER_LENGTH));
+
+    free(samps);
+    free(index_block);
+    free(discontinuity_array);
+
+    return(result);
+}
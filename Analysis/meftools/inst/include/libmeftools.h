@@ -0,0 +1,32 @@
+//
+//  libmeftools.h
+//
+//  Entry header for programs that link libmeftools.so (C/libmeftools) instead of running inside R.
+//
+//  meftools::MefChannel opens a .mef file and exposes its header, block index and segments; samples are
+//  read by number (read_samples) or by time (read_times), or streamed with meftools::SampleReader. Every
+//  routine returns a MEF_* code that meftools::error_string() turns into text; nothing calls into R.
+//  meftools::daemon_read_*() fetch the same samples from a running mefd instead of decoding them here.
+//  meftools::read_windows() decodes a batch of windows across many channels with all their reads in
+//  flight, and meftools::scan_channel() streams a whole channel front to back for full passes.
+//  meftools::EventTable reads a Neuralynx .nev file into a time-sorted table, on the MEF files' uUTC base
+//  when given the offset meftools::ncs_time_created() reads from the companion .ncs file.
+//
+
+#ifndef __LIBMEFTOOLS
+#define __LIBMEFTOOLS
+
+#ifndef MEFTOOLS_STANDALONE
+#define MEFTOOLS_STANDALONE
+#endif
+
+#include "meftools_core.h"
+#include "meftools_stats.h"
+#include "meftools_trace.h"
+#include "meftools_daemon.h"
+#include "meftools_shared_cache.h"
+#include "meftools_async_io.h"
+#include "meftools_scan.h"
+#include "meftools_events.h"
+
+#endif
@@ -0,0 +1,79 @@
+//
+//  meftools_async_io.h
+//
+//  Batched, asynchronous block reads across many channels. A batch of sample windows (any channels, any
+//  order: a multi-channel window, a list of epochs) is turned into block-range reads that are all put in
+//  flight at once, and each read is handed to a decode worker the moment its bytes arrive. A batch then
+//  waits for its reads together rather than one after another, which is what matters on NVMe queues and
+//  network file systems.
+//
+//  On Linux the reads go through one io_uring, set up with the raw system calls (no liburing needed).
+//  Where io_uring is missing or refused (old kernels, other systems, seccomp), a pool of threads issues
+//  them with pread() instead.
+//
+
+#ifndef __MEFTOOLS_ASYNC_IO
+#define __MEFTOOLS_ASYNC_IO
+
+#include <vector>
+
+#include "meftools_core.h"
+
+#define ASYNC_QUEUE_DEPTH           64          // reads in flight at once
+#define ASYNC_CHUNK_BYTES           (4 << 20)   // most compressed bytes per read
+#define ASYNC_INFLIGHT_BYTES        (256 << 20) // most bytes read but not yet decoded
+
+namespace meftools {
+
+  //
+  //  A queue of positional reads. submit() never blocks; wait() returns completions in whatever order
+  //  the device finishes them. Short reads are continued internally, so a completion is all or nothing.
+  //  One thread drives a reader at a time.
+  //
+  class AsyncReader {
+  public:
+    // Up to depth reads in flight; use_io_uring false always takes the thread pool.
+    explicit AsyncReader(unsigned depth, bool use_io_uring = true);
+    ~AsyncReader();
+
+    // "io_uring" or "threads".
+    const char *backend() const;
+
+    // Queue a read of bytes at offset of fd into buffer; tag is handed back with its completion.
+    void submit(int fd, ui8 offset, ui8 bytes, ui1 *buffer, size_t tag);
+
+    // Wait for the next completed read and set *tag and *status (MEF_OK or MEF_ERR_READ). False when
+    // nothing is queued or in flight.
+    bool wait(size_t *tag, si4 *status);
+
+    size_t outstanding() const;
+
+    struct Backend;
+
+  private:
+    AsyncReader(const AsyncReader &);
+    AsyncReader &operator=(const AsyncReader &);
+
+    Backend *backend_;
+  };
+
+  typedef struct {
+    const MefChannel *channel;
+    ui8 first_sample;
+    ui8 last_sample;    // inclusive
+    si4 *out;           // last_sample - first_sample + 1 samples
+    si4 status;         // set on return
+  } READ_WINDOW;
+
+  //
+  //  Decode every window of the batch, decoding on up to 'threads' workers (<= 0: one per core) while
+  //  the reads are in flight. Returns MEF_OK when every window decoded, otherwise the first failed
+  //  window's error; each window's status tells which. When the shared block cache is attached
+  //  (meftools_shared_cache.h) the windows go through MefChannel::decode_blocks() instead, so that
+  //  cached blocks are not read at all.
+  //
+  si4 read_windows(std::vector<READ_WINDOW> &windows, int threads);
+
+}
+
+#endif
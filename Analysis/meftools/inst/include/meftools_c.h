@@ -0,0 +1,52 @@
+//
+//  meftools_c.h
+//
+//  C entry points into libmeftools for programs that cannot include the C++ headers, such as Ncs2Mef2
+//  and mefbench, whose mef.h defines its own MEF types. Only plain C types cross this boundary.
+//
+
+#ifndef __MEFTOOLS_C
+#define __MEFTOOLS_C
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Text for a MEF_* return code.
+  const char *meftools_error_string(int code);
+
+  // Expand a (<=16 character) password into a 240-byte AES-128 round key.
+  void meftools_expand_key(const char *password, unsigned char *round_key);
+
+  // Largest number of bytes meftools_compress_block() can write for sample_count samples.
+  unsigned long meftools_compress_bound(unsigned int sample_count);
+
+  // Encode samples as one RED block (see meftools::compress_block). key is an expanded round key, or
+  // NULL for an unencrypted block; diff_buffer holds 4 * sample_count bytes, or is NULL to have one
+  // allocated for the call. Returns the bytes written to out, 0 on failure.
+  unsigned long meftools_compress_block(const int *samples, unsigned int sample_count, unsigned long uutc_time,
+                                        unsigned char discontinuity, const unsigned char *key,
+                                        unsigned char *out, unsigned char *diff_buffer);
+
+  // An open channel (meftools::MefChannel): header, block index and data key loaded.
+  typedef struct meftools_channel meftools_channel;
+
+  // Open a .mef file. Returns NULL on failure, with the MEF_* code in *err when err is not NULL.
+  meftools_channel *meftools_open(const char *path, const char *password, int *err);
+  void meftools_close(meftools_channel *channel);
+
+  unsigned long meftools_number_of_samples(const meftools_channel *channel);
+
+  // Decode blocks [b0, b1] into out from comp, their compressed bytes as they lie in the file from
+  // block b0 on. Returns a MEF_* code.
+  int meftools_decode_buffer(const meftools_channel *channel, unsigned long b0, unsigned long b1,
+                             const unsigned char *comp, int *out);
+
+  // Read and decode samples [s0, s1] (inclusive) into out. Returns a MEF_* code.
+  int meftools_read_samples(const meftools_channel *channel, unsigned long s0, unsigned long s1, int *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,276 @@
+//
+//  meftools_core.h
+//
+//  Shared, reentrant MEF 2.1 codec and reading layer used by every native meftools routine.
+//
+//  Every call works on caller-owned state, nothing is cached in statics (the AES and CRC tables are
+//  constant), and failures are reported as MEF_* codes rather than printed, so any number of threads
+//  may decode or encode different files or blocks at once.
+//
+
+#ifndef __MEFTOOLS_CORE
+#define __MEFTOOLS_CORE
+
+#include <vector>
+#include <string>
+
+#include "meftools_types.h"
+
+// RED block layout (see RED_encode.cpp)
+#define BLOCK_HEADER_BYTES                287
+#define RED_CHECKSUM_OFFSET               0
+#define RED_CHECKSUM_LENGTH               4
+#define RED_COMPRESSED_BYTE_COUNT_OFFSET  4
+#define RED_UUTC_TIME_OFFSET              8
+#define RED_DIFFERENCE_COUNT_OFFSET       16
+#define RED_SAMPLE_COUNT_OFFSET           20
+#define RED_DATA_MAX_OFFSET               24
+#define RED_DATA_MIN_OFFSET               27
+#define RED_DISCONTINUITY_OFFSET          30
+#define RED_STAT_MODEL_OFFSET             31
+#define RED_DATA_OFFSET                   BLOCK_HEADER_BYTES
+
+#define ENCRYPTION_KEY_LENGTH             240
+
+namespace meftools {
+
+  // Return codes. Zero is success, everything else is a failure that the caller decides how to report.
+  enum {
+    MEF_OK = 0,
+    MEF_ERR_OPEN,        // file could not be opened
+    MEF_ERR_READ,        // short read or I/O error
+    MEF_ERR_FORMAT,      // not a MEF 2.x file, or unknown encryption algorithm
+    MEF_ERR_ENDIAN,      // big-endian file or host
+    MEF_ERR_PASSWORD,    // session fields are encrypted and the password did not unlock them
+    MEF_ERR_MEMORY,      // allocation failure
+    MEF_ERR_RANGE,       // requested samples/blocks/times fall outside the file
+    MEF_ERR_CORRUPT,     // index or block headers are inconsistent
+    MEF_ERR_OVERFLOW,    // samples do not fit the requested output type
+    MEF_ERR_WRITE,       // output file could not be created or written
+    MEF_ERR_SERVER,      // mefd could not be reached or rejected the request
+    MEF_ERR_ALIGN        // channels to be combined sample by sample do not line up in time
+  };
+
+  const char *error_string(si4 code);
+
+  //
+  //  Codec primitives. All of them operate only on their arguments.
+  //
+
+  // Expand a (<=16 character) password into an AES-128 round key of ENCRYPTION_KEY_LENGTH bytes.
+  void expand_key(const si1 *password, ui1 *round_key);
+
+  // Decrypt and parse a MEF_HEADER_LENGTH byte header block. password may be NULL or empty.
+  si4 read_header_block(const ui1 *header_block, MEF_HEADER_INFO *header, const si1 *password);
+
+  // Read and parse the header of the file at path. On MEF_ERR_PASSWORD the unencrypted fields are still filled in.
+  si4 read_header(const char *path, const char *password, MEF_HEADER_INFO *header);
+
+  // Parse the fixed fields of a RED block header (no decryption, no CRC check).
+  si4 read_block_header(const ui1 *block, RED_BLOCK_HDR_INFO *block_hdr);
+
+  // CRC of a RED block as stored in its first four bytes.
+  ui4 block_crc(const ui1 *block);
+
+  // Decode one RED block. diff_buffer must hold at least 4 * sample_count + 1 bytes; key is the
+  // expanded data key, or NULL when data encryption is not used. Returns the bytes consumed
+  // (header + compressed data), or 0 if the block is malformed.
+  ui8 decompress_block(const ui1 *block, si4 *out, si1 *diff_buffer, const ui1 *key, RED_BLOCK_HDR_INFO *block_hdr);
+
+  // Largest number of bytes compress_block() can write for a block of sample_count samples.
+  ui8 compress_bound(ui4 sample_count);
+
+  // Encode samples in[0 .. sample_count) as one RED block, byte-for-byte as mef_lib's RED_compress_block.
+  // out must hold compress_bound(sample_count) bytes and diff_buffer 4 * sample_count; key is the expanded
+  // data key, or NULL for an unencrypted block. Returns the bytes written (header + data, padded to a
+  // multiple of 8), or 0 if there are no samples or one does not fit the 3-byte RED range.
+  ui8 compress_block(const si4 *in, ui4 sample_count, ui8 uutc_time, ui1 discontinuity, const ui1 *key,
+                     ui1 *out, ui1 *diff_buffer, RED_BLOCK_HDR_INFO *block_hdr);
+
+  //
+  //  A contiguous run of blocks: the first block carries a discontinuity flag and no later block does.
+  //
+  typedef struct {
+    ui8 first_block;
+    ui8 last_block;     // inclusive
+    ui8 first_sample;
+    ui8 last_sample;    // inclusive
+    ui8 start_time;     // uUTC of first_sample
+    ui8 end_time;       // uUTC one sample period after last_sample
+  } MEF_SEGMENT;
+
+  //
+  //  One open .mef channel: decrypted header, block index and discontinuity flags.
+  //
+  //  All reads use pread() on a private descriptor, so a single MefChannel may be shared by any number
+  //  of threads once open() has returned. open() itself is not meant to be called concurrently.
+  //
+  class MefChannel {
+  public:
+    MefChannel();
+    ~MefChannel();
+
+    si4 open(const char *path, const char *password);
+    void close();
+    bool is_open() const { return fd_ >= 0; }
+
+    const std::string &path() const { return path_; }
+    const MEF_HEADER_INFO &header() const { return header_; }
+    const std::vector<INDEX_DATA> &index() const { return index_; }
+    const std::vector<ui1> &discontinuities() const { return discontinuities_; }
+    ui8 number_of_blocks() const { return index_.size(); }
+    const ui1 *data_key() const { return data_encrypted_ ? key_ : NULL; }
+    int fd() const { return fd_; }
+
+    // Samples and on-disk bytes (including alignment padding) of block b.
+    ui8 block_samples(ui8 b) const;
+    ui8 block_bytes(ui8 b) const;
+    ui8 block_end_time(ui8 b) const;
+
+    // Block containing sample s / time t (the last block starting at or before it).
+    ui8 block_of_sample(ui8 s) const;
+    ui8 block_of_time(ui8 t) const;
+
+    // First sample at or after time t (may be one past the end of the block containing t), and the
+    // time of sample s, both interpolated from the block index.
+    ui8 sample_of_time(ui8 t) const;
+    ui8 time_of_sample(ui8 s) const;
+
+    // Contiguous segments, optionally restricted to those overlapping [time0, time1].
+    std::vector<MEF_SEGMENT> segments() const;
+    std::vector<MEF_SEGMENT> segments(ui8 time0, ui8 time1) const;
+
+    // Samples [s0, s1] of segment that fall inside [time0, time1]; false if there are none.
+    bool clip_segment(const MEF_SEGMENT &segment, ui8 time0, ui8 time1, ui8 *s0, ui8 *s1) const;
+
+    // Read the compressed bytes of blocks [b0, b1] with a single pread.
+    si4 read_blocks(ui8 b0, ui8 b1, std::vector<ui1> &buffer) const;
+
+    // Parse the RED headers of blocks [b0, b1] without touching the compressed data. The file is
+    // mapped rather than read (with readahead off), so only the pages holding headers are faulted in.
+    // MEF_ERR_CORRUPT if an index entry puts a header past the end of the file.
+    si4 read_block_headers(ui8 b0, ui8 b1, std::vector<RED_BLOCK_HDR_INFO> &headers) const;
+
+    // Decode blocks [b0, b1] from comp, their compressed bytes as read_blocks() returns them, into out.
+    si4 decode_buffer(ui8 b0, ui8 b1, const ui1 *comp, si4 *out) const;
+
+    // Decode blocks [b0, b1] into out, which must hold their total sample count. When this process is
+    // attached to the shared block cache (meftools_shared_cache.h), blocks are taken from it where
+    // possible and the rest are claimed there, decoded and published.
+    si4 decode_blocks(ui8 b0, ui8 b1, si4 *out) const;
+
+    // Decode samples [s0, s1] (inclusive) into out.
+    si4 read_samples(ui8 s0, ui8 s1, si4 *out) const;
+
+    // Decode every sample whose time falls inside [time0, time1] into out, segment after segment (gaps
+    // hold no samples). The first sample number of each segment piece goes to *starts when it is not NULL.
+    si4 read_times(ui8 time0, ui8 time1, std::vector<si4> &out, std::vector<ui8> *starts) const;
+
+    // Microvolts per raw unit: the header's voltage_conversion_factor, or 1 when it is unset.
+    sf8 microvolts_per_unit() const;
+
+    // Decode samples [s0, s1] into out already scaled to microvolts. Scaling happens per decoded
+    // batch, so no full-length integer copy is ever made.
+    si4 read_microvolts(ui8 s0, ui8 s1, sf4 *out) const;
+    si4 read_microvolts(ui8 s0, ui8 s1, sf8 *out) const;
+
+    // Smallest and largest sample of blocks [b0, b1] according to their RED headers. The file header's
+    // extremes answer without touching the blocks when they already fit 16 bits.
+    si4 block_range(ui8 b0, ui8 b1, si4 *minimum, si4 *maximum) const;
+
+    // Decode samples [s0, s1] into 16-bit out. Unless saturate is set, the block headers must show that
+    // every sample fits (MEF_ERR_OVERFLOW otherwise); with it, values are clamped to the int16 range.
+    // The number of clamped samples goes to *clipped when it is not NULL.
+    si4 read_int16(ui8 s0, ui8 s1, si2 *out, bool saturate, ui8 *clipped) const;
+
+  private:
+    MefChannel(const MefChannel &);
+    MefChannel &operator=(const MefChannel &);
+
+    si4 load_discontinuities();
+    si4 decode_blocks_uncached(ui8 b0, ui8 b1, si4 *out) const;
+
+    int fd_;
+    std::string path_;
+    MEF_HEADER_INFO header_;
+    std::vector<INDEX_DATA> index_;
+    std::vector<ui1> discontinuities_;
+    ui1 key_[ENCRYPTION_KEY_LENGTH];
+    bool data_encrypted_;
+    ui8 cache_key_;     // identity of the file in the shared block cache
+  };
+
+  // Clamp n samples to the int16 range into out. Returns the number clamped.
+  ui8 narrow_samples(const si4 * __restrict in, si2 * __restrict out, size_t n);
+
+  //
+  //  Sequential reader over samples [s0, s1] of an open channel. Blocks are decoded a batch at a time
+  //  and handed out in whatever piece sizes the caller asks for, so streaming stages never decode a
+  //  block twice and never hold more than one batch. One reader per thread.
+  //
+  class SampleReader {
+  public:
+    SampleReader(const MefChannel &channel, ui8 s0, ui8 s1);
+
+    // Copy up to n of the remaining samples into out. Returns the number copied; 0 at the end or on
+    // error (see error()).
+    size_t read(si4 *out, size_t n);
+
+    // As above, converting each sample to sample * scale on the way out.
+    size_t read(sf4 *out, size_t n, sf8 scale);
+    size_t read(sf8 *out, size_t n, sf8 scale);
+
+    // As above, clamping each sample to the int16 range; clamped samples are added to *clipped.
+    size_t read(si2 *out, size_t n, ui8 *clipped);
+
+    ui8 position() const { return next_; }
+    ui8 remaining() const { return next_ > last_ ? 0 : last_ - next_ + 1; }
+    si4 error() const { return err_; }
+
+  private:
+    si4 fill();
+    template <class T> size_t read_scaled(T *out, size_t n, sf8 scale);
+
+    const MefChannel &channel_;
+    ui8 next_, last_;
+    ui8 next_block_;
+    std::vector<si4> decoded_;
+    ui8 decoded_first_;
+    si4 err_;
+  };
+
+  //
+  //  Least-recently-used cache of decoded blocks for random access into an open channel, e.g. element
+  //  lookups that land on the same few blocks again and again. Not thread-safe; one per consumer.
+  //
+  class BlockCache {
+  public:
+    BlockCache(const MefChannel &channel, size_t capacity);
+
+    const MefChannel &channel() const { return channel_; }
+
+    // Decoded samples of block b, valid until the next call; NULL on error (see error()).
+    const si4 *block(ui8 b);
+
+    // Copy samples [s0, s0 + n) into out through the cache.
+    si4 read(ui8 s0, size_t n, si4 *out);
+
+    si4 error() const { return err_; }
+
+  private:
+    typedef struct {
+      ui8 block;
+      ui8 last_use;
+      std::vector<si4> samples;
+    } CACHED_BLOCK;
+
+    const MefChannel &channel_;
+    size_t capacity_;
+    std::vector<CACHED_BLOCK> entries_;
+    ui8 clock_;
+    si4 err_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,83 @@
+//
+//  meftools_daemon.h
+//
+//  mefd, a per-node decode server, and its client. mefd keeps every channel it is asked for open and one
+//  decoded-block cache for all of its clients, so a block is decoded once per node however many R or
+//  Python processes want it. The cache itself lives in mefd's own memory; it is not shared. Requests travel
+//  over a Unix domain socket, and the samples of each reply are copied out of the cache into a new,
+//  unlinked tmpfs file whose descriptor is passed with the reply (SCM_RIGHTS) and which the client maps,
+//  so bulk data never goes through the socket. A reply file holds at most 64 MB of samples (a larger
+//  reply comes in several), and its space is reserved before it is written, so a full /dev/shm turns
+//  into an ERR reply rather than a crash.
+//
+//  Protocol: one request per line, fields separated by tabs, one reply line per request.
+//
+//    samples <path> <password> <s0> <s1>                    samples s0..s1
+//    times   <path> <password> <t0> <t1>                    every sample timed within t0..t1 (uUTC)
+//    epochs  <path> <password> <pre> <post> <t>[,<t>...]     samples s-pre..s+post around each time's sample s
+//    stats                                                  cache and channel counts, as key=value pairs
+//
+//    MORE <k>                       k int32 samples in the attached descriptor; more of the reply follows
+//    OK <n> <first>[,<first>...]    n int32 samples in all (the attached descriptor holds those not sent
+//                                   in MORE parts; none when n is 0); first lists the first sample number
+//                                   of each contiguous piece or epoch
+//    ERR <message>
+//
+
+#ifndef __MEFTOOLS_DAEMON
+#define __MEFTOOLS_DAEMON
+
+#include <string>
+#include <vector>
+
+#include "meftools_core.h"
+
+namespace meftools {
+
+  //
+  //  The samples of one reply, mapped read-only from mefd's reply file until destruction (or, for a
+  //  reply that came in several parts, copied into one buffer).
+  //
+  class DaemonReply {
+  public:
+    DaemonReply();
+    ~DaemonReply();
+
+    const si4 *data() const { return data_; }
+    size_t size() const { return n_; }
+    const std::vector<ui8> &starts() const { return starts_; }
+    // mefd's error message, or the stats line
+    const std::string &message() const { return message_; }
+
+  private:
+    DaemonReply(const DaemonReply &);
+    DaemonReply &operator=(const DaemonReply &);
+    void release();
+
+    const si4 *data_;
+    size_t n_;
+    std::vector<si4> parts_;    // holds the samples of a reply in several parts
+    std::vector<ui8> starts_;
+    std::string message_;
+
+    friend si4 daemon_request(const char *socket_path, const std::string &request, DaemonReply &reply);
+  };
+
+  // Send one request line (without its newline) and wait for the reply. MEF_ERR_SERVER when mefd cannot
+  // be reached or answers ERR; reply.message() then says why.
+  si4 daemon_request(const char *socket_path, const std::string &request, DaemonReply &reply);
+
+  si4 daemon_read_samples(const char *socket_path, const char *path, const char *password, ui8 s0, ui8 s1,
+                          DaemonReply &reply);
+  si4 daemon_read_times(const char *socket_path, const char *path, const char *password, ui8 time0, ui8 time1,
+                        DaemonReply &reply);
+  si4 daemon_read_epochs(const char *socket_path, const char *path, const char *password,
+                         const std::vector<ui8> &times, ui8 pre, ui8 post, DaemonReply &reply);
+
+  // Run mefd on socket_path until the process is killed, caching up to cache_bytes of decoded samples.
+  // Each connection gets its own thread. Returns only if the socket cannot be set up.
+  si4 daemon_serve(const char *socket_path, size_t cache_bytes);
+
+}
+
+#endif
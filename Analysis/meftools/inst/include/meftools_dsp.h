@@ -0,0 +1,165 @@
+//
+//  meftools_dsp.h
+//
+//  Signal-processing stages that run on decoded MEF samples inside the native readers. Like
+//  meftools_core.h this layer has no R dependencies and keeps all state in the objects it hands out.
+//
+
+#ifndef __MEFTOOLS_DSP
+#define __MEFTOOLS_DSP
+
+#include <vector>
+#include <complex>
+
+#include "meftools_core.h"
+
+namespace meftools {
+
+  //
+  //  Cascade of second-order sections. Coefficients are stored six per section as b0 b1 b2 a0 a1 a2
+  //  (the layout of scipy's / Matlab's sos matrices) and normalised so that a0 == 1.
+  //
+  class SosFilter {
+  public:
+    SosFilter() {}
+    explicit SosFilter(const std::vector<sf8> &sos);
+
+    size_t sections() const { return coef_.size() / 6; }
+    const std::vector<sf8> &coefficients() const { return coef_; }
+
+    void reset();
+
+    // Filter n samples in place, continuing from the current state (transposed direct form II).
+    void process(sf8 *x, size_t n);
+
+    // Filter n samples in place from the last towards the first, continuing from the current state.
+    void process_reverse(sf8 *x, size_t n);
+
+    // Samples after which the slowest pole has decayed below 'tolerance'; used to size edge padding.
+    size_t settle_samples(sf8 tolerance) const;
+
+  private:
+    std::vector<sf8> coef_;
+    std::vector<sf8> state_;   // two per section
+  };
+
+  // Butterworth design by bilinear transform. low <= 0 gives a low-pass at high; high <= 0 or
+  // high >= fs/2 gives a high-pass at low; otherwise a band-pass of 'order' poles per band edge.
+  // Returns the six-per-section coefficients, or an empty vector if the corner frequencies are invalid.
+  std::vector<sf8> butterworth_sos(si4 order, sf8 low, sf8 high, sf8 fs);
+
+  // In-place radix-2 FFT; n must be a power of two. inverse == true computes the unscaled inverse.
+  void fft(std::complex<sf8> *x, size_t n, bool inverse);
+
+  // Smallest power of two >= n.
+  size_t fft_length(size_t n);
+
+  // Running sum of segment periodograms: all that one output of a Welch estimate keeps. Empty until
+  // the first segment is added.
+  struct WelchSum {
+    std::vector<sf8> sum;
+    ui8 count;
+
+    WelchSum() : count(0) {}
+  };
+
+  //
+  //  Welch power spectral density: Hann-windowed, mean-removed segments of 'length' samples every 'hop'
+  //  samples (zero-padded to a power of two), averaged. Segments are taken only inside the sample
+  //  ranges passed to add_range(), so a range that is one contiguous run never yields a segment that
+  //  straddles a gap. The estimator holds the window and the FFT scratch space, so it is used by one
+  //  thread at a time; the sums it adds into can be as many as there are outputs.
+  //
+  class WelchEstimator {
+  public:
+    WelchEstimator(size_t length, size_t hop, sf8 sampling_frequency);
+
+    // Stream samples [s0, s1] of one contiguous run through the estimator into acc.
+    si4 add_range(const MefChannel &channel, ui8 s0, ui8 s1, WelchSum &acc);
+
+    size_t bins() const { return nfft_ / 2 + 1; }
+    sf8 frequency(size_t k) const { return k * fs_ / (sf8) nfft_; }
+
+    // One-sided density (units^2 / Hz) of acc for bins 0 .. bins()-1; NaN if nothing was averaged.
+    void psd(const WelchSum &acc, sf8 *out) const;
+
+  private:
+    void add_segment(const sf8 *x, WelchSum &acc);
+
+    size_t length_, hop_, nfft_;
+    sf8 fs_, window_power_;
+    std::vector<sf8> window_;
+    std::vector< std::complex<sf8> > spectrum_;
+  };
+
+  // Receives the output of the streaming stages below, in order.
+  class FilteredSink {
+  public:
+    virtual ~FilteredSink() {}
+    virtual void write(ui8 first_sample, const sf8 *y, size_t n) = 0;
+  };
+
+  // Hand samples [s0, s1] to sink unfiltered, as doubles, in pieces of at most 'window' samples.
+  si4 stream_segment(const MefChannel &channel, ui8 s0, ui8 s1, size_t window, FilteredSink &sink);
+
+  //
+  //  Zero-phase (forward-backward) filtering of samples [s0, s1] of one contiguous segment, with memory
+  //  bounded by about 'window' + 2 * 'pad' samples:
+  //
+  //    - up to 'pad' samples of real context on either side of [s0, s1] are decoded when the segment has
+  //      them, and the ends of what was read are extended by odd reflection, as filtfilt does;
+  //    - the forward pass runs continuously over the stream;
+  //    - the backward pass runs over each output window plus 'pad' further forward-filtered samples,
+  //      starting from rest, so its start-up transient has decayed before the window is reached.
+  //
+  //  With pad >= filter.settle_samples(tol) the result differs from a whole-record filtfilt by about tol
+  //  relative to the signal. Output is handed to sink(first_sample, y, n) in order.
+  //
+  si4 filtfilt_segment(const MefChannel &channel, const MEF_SEGMENT &segment, ui8 s0, ui8 s1,
+                       const std::vector<sf8> &sos, size_t pad, size_t window, FilteredSink &sink);
+
+  //
+  //  Polyphase rational resampler (up / down), itself a FilteredSink: input samples of one contiguous run
+  //  go in through write(), resampled output goes to 'out' numbered from 0. The anti-aliasing filter is
+  //  the one scipy's resample_poly designs (Kaiser-windowed sinc, beta 5, cutoff at the lower Nyquist,
+  //  10 * max(up, down) taps per side) and its delay is compensated, so output m lies exactly at input
+  //  position m * down / up. Outside the run the edge samples are held. Only the filter span of input is
+  //  kept between writes.
+  //
+  class PolyphaseResampler : public FilteredSink {
+  public:
+    PolyphaseResampler(si4 up, si4 down, FilteredSink &out);
+
+    si4 up() const { return up_; }
+    si4 down() const { return down_; }
+
+    void write(ui8 first_sample, const sf8 *x, size_t n);
+
+    // Emit the outputs that need samples past the end of the run; ceil(n * up / down) in total.
+    void finish();
+
+    ui8 outputs() const { return next_out_; }
+
+    // Input samples on either side of its position that an output can depend on. A run fed from input
+    // k * down() on, with reach() samples of real input before the outputs kept, gives outputs equal to
+    // those of the whole run, numbered from k * up().
+    ui8 reach() const { return (ui8) (half_ / up_) + 2; }
+
+  private:
+    void emit(bool last);
+
+    si4 up_, down_;
+    si8 half_;                              // filter half-length, in upsampled samples
+    std::vector< std::vector<sf8> > phase_; // per phase, taps in increasing input order
+    std::vector<sf8> buffer_;
+    ui8 base_;                              // run index of buffer_[0]
+    ui8 received_;
+    ui8 next_out_;
+    sf8 first_, last_;
+    std::vector<sf8> y_;
+    FilteredSink &out_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+//
+//  meftools_events.h
+//
+//  Neuralynx event files (.nev): a 16 kB text header followed by fixed 184-byte records, each holding a
+//  microsecond timestamp, an event ID, a TTL value and a 128-byte event string. read_nev() reads all
+//  records in a few large reads into a compact table sorted by time, with each distinct event string
+//  stored once, and time ranges are then found by binary search, overall or for one event string.
+//
+//  Times are uUTC: Neuralynx timestamps plus an offset. Ncs2Mef2 adds the start time in the header of
+//  the first .ncs file it converts (-TimeCreated, read in the local time zone) to the samples and to the
+//  events, so ncs_time_created() of that file puts events on the same base as its MEF files. The .nev
+//  header's own start time is only an approximation of it: the event file is opened at its own moment.
+//
+
+#ifndef __MEFTOOLS_EVENTS
+#define __MEFTOOLS_EVENTS
+
+#include <string>
+#include <vector>
+
+#include "meftools_types.h"
+
+#define NEV_HEADER_BYTES    16384
+#define NEV_RECORD_BYTES    184
+#define NEV_STRING_LENGTH   128
+#define NCS_HEADER_BYTES    16384
+
+namespace meftools {
+
+  typedef struct {
+    ui8 time;           // uUTC
+    ui4 label;          // index of the event string in EventTable::labels()
+    ui2 ttl;
+    si2 event_id;
+  } NEV_EVENT;
+
+  // uUTC of the recording start written in a .nev or .ncs header (bytes of text).
+  si4 nev_time_created(const si1 *header, size_t bytes, ui8 *uutc);
+
+  // The same, read from the header of the .ncs file at path: the offset Ncs2Mef2 adds to timestamps.
+  si4 ncs_time_created(const char *path, ui8 *uutc);
+
+  class EventTable {
+  public:
+    EventTable() : offset_(0) {}
+
+    // Read every record of path, adding *offset (uUTC) to each timestamp, or the .nev header's start
+    // time (approximate, see above) when offset is NULL. A partial record at the end (a file cut short while recording) is ignored.
+    si4 read_nev(const char *path, const ui8 *offset);
+
+    ui8 offset() const { return offset_; }
+    size_t size() const { return events_.size(); }
+    const std::vector<NEV_EVENT> &events() const { return events_; }
+    const std::vector<std::string> &labels() const { return labels_; }
+    const std::string &label(size_t i) const { return labels_[events_[i].label]; }
+
+    // Index of an event string in labels(), or -1 when no event has it.
+    si8 find_label(const std::string &text) const;
+
+    // Positions [*first, *last) of the events timed within [t0, t1].
+    void range(ui8 t0, ui8 t1, size_t *first, size_t *last) const;
+
+    // Positions of the events with event string 'label' timed within [t0, t1], in time order.
+    void select(ui4 label, ui8 t0, ui8 t1, std::vector<size_t> &out) const;
+
+  private:
+    std::vector<NEV_EVENT> events_;
+    std::vector<std::string> labels_;
+    std::vector< std::vector<ui4> > by_label_;  // positions of each label's events
+    ui8 offset_;
+  };
+
+}
+
+#endif
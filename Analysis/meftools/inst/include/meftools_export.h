@@ -0,0 +1,66 @@
+//
+//  meftools_export.h
+//
+//  Bulk export of decoded channels to the flat interleaved int16 layout (.dat) that spike sorters read:
+//  all channels of sample 0, then all channels of sample 1, and so on, little-endian. Also the buffered
+//  output used by it and by mefcat: whole writes, and a writer thread that drains one buffer while the
+//  caller fills the next.
+//
+
+#ifndef __MEFTOOLS_EXPORT
+#define __MEFTOOLS_EXPORT
+
+#include <thread>
+#include <vector>
+
+#include "meftools_core.h"
+
+namespace meftools {
+
+  // Write all of buffer to fd, retrying short and interrupted writes. MEF_ERR_WRITE on failure.
+  si4 write_all(int fd, const void *buffer, size_t bytes);
+
+  //
+  //  Writes buffers to fd on a thread of its own, one at a time, so that the caller can fill the next
+  //  buffer meanwhile. write() first waits for the previous write, whose buffer may then be reused, and
+  //  returns its error without starting another if it failed. wait() waits for the last one and returns
+  //  the first error.
+  //
+  class BackgroundWriter {
+  public:
+    explicit BackgroundWriter(int fd) : fd_(fd), err_(MEF_OK) {}
+    ~BackgroundWriter() { wait(); }
+    si4 write(const void *buffer, size_t bytes);
+    si4 wait();
+
+  private:
+    BackgroundWriter(const BackgroundWriter &);
+    BackgroundWriter &operator=(const BackgroundWriter &);
+    int fd_;
+    si4 err_;
+    std::thread thread_;
+  };
+
+  typedef struct {
+    const MefChannel *channel;
+    ui8 first_sample;     // first sample of this channel written to the file
+    ui8 clipped;          // set on return: samples clamped to the int16 range
+  } EXPORT_CHANNEL;
+
+  //
+  //  Write 'n' samples of every channel to 'path'. Each channel is read by its own sequential scan
+  //  (meftools_scan.h), which reads ahead on a thread of its own. The output is produced a tile of
+  //  samples at a time: the channels of a tile are decoded in parallel into planar 16-bit buffers,
+  //  interleaved a cache-sized sub-tile at a time, and written with one large write from a page-aligned
+  //  buffer while the next tile is being decoded. Unless saturate is set, every channel's block headers must show that its samples
+  //  fit in 16 bits (MEF_ERR_OVERFLOW otherwise). Rows of the file are samples of the same moment, so
+  //  every channel's segments within its n samples must start at the same offsets and, to half a sample,
+  //  at the same times as the first channel's (MEF_ERR_ALIGN otherwise): gaps cannot be represented in
+  //  the flat layout. On an error *failed_channel is set to the offending channel's position.
+  //
+  si4 export_interleaved_int16(std::vector<EXPORT_CHANNEL> &channels, ui8 n, const char *path, bool saturate,
+                               int threads, si4 *failed_channel);
+
+}
+
+#endif
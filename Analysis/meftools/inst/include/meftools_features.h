@@ -0,0 +1,67 @@
+//
+//  meftools_features.h
+//
+//  Per-window feature kernels evaluated over whole channels. Windows never straddle a discontinuity:
+//  each contiguous segment is tiled on its own, and a trailing partial window is dropped.
+//
+
+#ifndef __MEFTOOLS_FEATURES
+#define __MEFTOOLS_FEATURES
+
+#include <complex>
+#include <string>
+#include <vector>
+
+#include "meftools_dsp.h"
+
+namespace meftools {
+
+  enum {
+    FEATURE_LINE_LENGTH = 0,  // sum |x[i] - x[i-1]|
+    FEATURE_RMS,              // root mean square about the window mean
+    FEATURE_MEAN,
+    FEATURE_MIN,
+    FEATURE_MAX,
+    FEATURE_ZERO_CROSSINGS,   // sign changes about the window mean
+    FEATURE_BAND_POWER        // mean-square power between low and high Hz (periodogram, Parseval-scaled)
+  };
+
+  typedef struct {
+    si4 kind;
+    sf8 low;
+    sf8 high;
+  } FEATURE;
+
+  // FEATURE_* code for a kernel name ("line_length", "rms", ...), or -1 if unknown.
+  si4 feature_kind(const std::string &name);
+
+  // Evaluates a fixed list of features on windows of a fixed length. Holds its own scratch space, so
+  // use one per thread.
+  class FeatureExtractor {
+  public:
+    FeatureExtractor(const std::vector<FEATURE> &features, sf8 sampling_frequency, size_t window);
+
+    size_t size() const { return features_.size(); }
+
+    // Write size() values for the window x[0 .. window-1] to out.
+    void compute(const sf8 *x, sf8 *out);
+
+  private:
+    std::vector<FEATURE> features_;
+    sf8 fs_;
+    size_t window_;
+    bool need_spectrum_;
+    std::vector< std::complex<sf8> > spectrum_;
+  };
+
+  // Tile each sample range [first[i], last[i]] (in file order, each within one contiguous segment) with
+  // windows every 'hop' samples, in one front-to-back scan of the channel (meftools_scan.h), and append
+  // each window's first sample and feature values to starts / values. The windows of each decoded batch
+  // are evaluated in parallel, one FeatureExtractor per worker, while the scan decodes the next batch.
+  si4 features_scan(const MefChannel &channel, const std::vector<ui8> &first, const std::vector<ui8> &last,
+                    size_t window, size_t hop, const std::vector<FEATURE> &features, int threads,
+                    std::vector<ui8> &starts, std::vector<sf8> &values);
+
+}
+
+#endif
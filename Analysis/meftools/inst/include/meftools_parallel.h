@@ -0,0 +1,69 @@
+//
+//  meftools_parallel.h
+//
+//  Minimal work-sharing loop for the native meftools routines. Items are handed out through an atomic
+//  counter so that uneven items (files of different length, segments of different duration) balance
+//  themselves. The body must not touch the R API: collect results into plain C++ storage and convert
+//  them once the loop has returned.
+//
+
+#ifndef __MEFTOOLS_PARALLEL
+#define __MEFTOOLS_PARALLEL
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace meftools {
+
+  // Number of workers to use when the caller passes threads <= 0.
+  inline unsigned default_threads()
+  {
+    unsigned n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+  }
+
+  // Workers parallel_for() and parallel_for_worker() use for n items.
+  inline unsigned worker_count(size_t n, int threads)
+  {
+    unsigned n_workers = threads > 0 ? (unsigned) threads : default_threads();
+    if (n_workers > n)
+      n_workers = (unsigned) n;
+    return n_workers > 0 ? n_workers : 1;
+  }
+
+  // Call body(w, i) for every i in [0, n), where w < worker_count(n, threads) identifies the calling
+  // worker, so each worker can keep its own scratch space.
+  template <typename Body>
+  void parallel_for_worker(size_t n, int threads, Body body)
+  {
+    unsigned n_workers = worker_count(n, threads);
+    if (n_workers <= 1) {
+      for (size_t i = 0; i < n; i++)
+        body(0u, i);
+      return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    workers.reserve(n_workers);
+    for (unsigned w = 0; w < n_workers; w++) {
+      workers.push_back(std::thread([&, w]() {
+        for (size_t i = next++; i < n; i = next++)
+          body(w, i);
+      }));
+    }
+    for (size_t w = 0; w < workers.size(); w++)
+      workers[w].join();
+  }
+
+  // Call body(i) for every i in [0, n), using up to 'threads' workers (<= 0 means one per core).
+  template <typename Body>
+  void parallel_for(size_t n, int threads, Body body)
+  {
+    parallel_for_worker(n, threads, [&](unsigned, size_t i) { body(i); });
+  }
+
+}
+
+#endif
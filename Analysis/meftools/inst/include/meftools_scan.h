@@ -0,0 +1,93 @@
+//
+//  meftools_scan.h
+//
+//  Front-to-back scan of a channel for whole-file passes (validation, overview building, ...). The file
+//  is read in large page-aligned pieces of whole blocks through a private descriptor marked for
+//  sequential access, in three overlapping stages: a reader thread fills one of two read buffers, a
+//  decoder thread decodes the other on a pool of workers into one of two batches, and the caller
+//  consumes the other batch. Pages the scan brought into the page cache are dropped once decoded, so a
+//  pass over a large recording does not evict everything else; pages cached before the scan stay.
+//
+//  Memory: two read buffers of read_bytes plus two decoded batches (4 bytes per sample each).
+//
+//  Bad blocks do not stop a scan: each block comes with its own status, and the visitor decides.
+//
+
+#ifndef __MEFTOOLS_SCAN
+#define __MEFTOOLS_SCAN
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "meftools_core.h"
+
+#define SCAN_READ_BYTES     (16 << 20)  // default size of each read
+#define SCAN_ALIGN          4096        // reads start on page boundaries
+
+namespace meftools {
+
+  struct SCAN_OPTIONS {
+    ui8 read_bytes;     // bytes per read, rounded to whole blocks
+    int threads;        // decode workers; <= 0: one per core
+    bool decode;        // false: deliver block headers only
+    bool check_crc;     // verify every block's CRC
+    bool drop_cache;    // evict the pages the scan read in (POSIX_FADV_DONTNEED)
+    bool decode_ahead;  // decode the next batch on a pipeline thread; false: decode in next()
+
+    SCAN_OPTIONS() : read_bytes(SCAN_READ_BYTES), threads(0), decode(true), check_crc(false), drop_cache(true),
+                     decode_ahead(true) {}
+  };
+
+  typedef struct {
+    ui8 first_block;
+    ui8 last_block;                         // inclusive
+    ui8 first_sample;                       // sample number of first_block's first sample
+    ui8 n_samples;
+    const si4 *samples;                     // NULL unless decoding
+    const RED_BLOCK_HDR_INFO *headers;      // one per block
+    const si4 *status;                      // one per block: MEF_OK, or MEF_ERR_CORRUPT for a block that is
+                                            // malformed, fails its CRC or does not decode (its samples are 0)
+  } SCAN_BATCH;
+
+  // Blocks [b0, b1] of a channel, one batch at a time in file order. With decode_ahead off, each batch is
+  // decoded on the calling thread (with options.threads workers) and only reading runs ahead, so many
+  // scans can run side by side without each adding a decode pool.
+  class ChannelScan {
+  public:
+    ChannelScan(const MefChannel &channel, ui8 b0, ui8 b1, const SCAN_OPTIONS &options);
+    ~ChannelScan();
+
+    // Fill batch with the next piece, valid until the following call. Returns false after the last
+    // piece or on an error (see error()).
+    bool next(SCAN_BATCH &batch);
+
+    si4 error() const { return err_; }
+
+  private:
+    ChannelScan(const ChannelScan &);
+    ChannelScan &operator=(const ChannelScan &);
+
+    struct Pipeline;
+    Pipeline *pipeline_;
+    si4 err_;
+  };
+
+  // Return MEF_OK to go on; anything else ends the scan with that code.
+  typedef std::function<si4(const SCAN_BATCH &batch)> ScanVisitor;
+
+  // Visit blocks [b0, b1] of channel in order. Returns MEF_OK, a read error, or the visitor's code.
+  si4 scan_channel(const MefChannel &channel, ui8 b0, ui8 b1, const SCAN_OPTIONS &options, const ScanVisitor &visit);
+
+  typedef struct {
+    si8 block;          // -1 for problems with the header or the index as a whole
+    std::string problem;
+  } VALIDATION_ISSUE;
+
+  // The checks of mef_lib's validate_mef() (header times against the index, index steps, block sizes
+  // against the index, CRCs, alignment, block times) plus a full decode, in one scan.
+  si4 validate_channel(const MefChannel &channel, int threads, std::vector<VALIDATION_ISSUE> &issues);
+
+}
+
+#endif
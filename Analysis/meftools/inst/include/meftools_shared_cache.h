@@ -0,0 +1,77 @@
+//
+//  meftools_shared_cache.h
+//
+//  Optional decoded-block cache shared by every process on a node. It lives in a named shared-memory
+//  file (/dev/shm/<name>), so R workers forked by parallel or future, and unrelated processes attaching
+//  the same name, decode each block once between them. Once attached, MefChannel::decode_blocks() looks
+//  every block up there first and publishes what it decodes, so no caller changes.
+//
+//  Blocks are keyed by the file's identity (its unique IDs, start time, length and channel name, not its
+//  path) and block number. The cache is split into sets of SHARED_CACHE_WAYS fixed-size slots: lookups
+//  are lock-free (each slot is a seqlock, so a reader copies the samples and then checks that no writer
+//  touched the slot meanwhile), a decoder claims a slot with one compare-and-swap before it decodes, so
+//  that concurrent readers of the same block wait for it, and each set evicts with the clock (second
+//  chance) algorithm. Blocks longer than a slot are simply not cached.
+//
+//  A claim records its owner's pid (in the same compare-and-swap that takes the slot) and the time it was
+//  made. A process that dies between claim and publish would otherwise leave its slot claimed for good,
+//  so a lookup or claim that meets a claim whose owner is gone takes it over and frees the slot, as it
+//  does a claim that was set up more than SHARED_CACHE_CLAIM_US ago and whose samples are not yet being
+//  written.
+//
+
+#ifndef __MEFTOOLS_SHARED_CACHE
+#define __MEFTOOLS_SHARED_CACHE
+
+#include "meftools_types.h"
+
+#define SHARED_CACHE_WAYS           8
+#define SHARED_CACHE_SLOT_SAMPLES   32768   // one second at 32 kHz, Ncs2Mef2's default block
+#define SHARED_CACHE_RUN_BLOCKS     16      // most missing blocks claimed and decoded together
+#define SHARED_CACHE_CLAIM_US       10000000    // a claim held this long is taken to be abandoned
+
+namespace meftools {
+
+  typedef struct {
+    ui8 slots;
+    ui4 slot_samples;
+    ui8 bytes;          // size of the shared segment
+    ui8 used;           // slots holding a block
+  } SHARED_CACHE_INFO;
+
+  typedef struct {
+    si8 slot;           // -1: nothing claimed
+    ui8 seq;            // the slot's sequence word while this claim holds it
+  } SHARED_CACHE_CLAIM;
+
+  // Attach to the cache called name, creating it with about 'bytes' of slots of slot_samples samples
+  // when it does not exist yet; an existing cache keeps its own geometry. Replaces any cache this process
+  // was attached to. Not to be called while other threads are reading.
+  si4 shared_cache_attach(const char *name, ui8 bytes, ui4 slot_samples);
+
+  // Stop using the cache (its segment stays for other processes) and, with remove, delete its name so
+  // that the memory is freed once the last process detaches.
+  void shared_cache_detach(bool remove);
+
+  bool shared_cache_attached();
+
+  // Key of a file's blocks in the cache.
+  ui8 shared_cache_file_key(const MEF_HEADER_INFO *header);
+
+  bool shared_cache_info(SHARED_CACHE_INFO *info);
+
+  // Copy block 'block' of the file identified by file_key (n samples) into out. False on a miss. A block
+  // another process has claimed is waited for (briefly) instead of being missed.
+  bool shared_cache_lookup(ui8 file_key, ui8 block, ui4 n, si4 *out);
+
+  // Reserve a slot for a block about to be decoded, so that other processes wait for it rather than
+  // decode it too. Slot -1 when it does not fit a slot, its set is busy or someone else already has it.
+  SHARED_CACHE_CLAIM shared_cache_claim(ui8 file_key, ui8 block, ui4 n);
+
+  // Fill a claimed slot and make it visible; samples NULL (the decode failed) releases it empty. Does
+  // nothing when the claim was taken over meanwhile.
+  void shared_cache_publish(const SHARED_CACHE_CLAIM &claim, const si4 *samples);
+
+}
+
+#endif
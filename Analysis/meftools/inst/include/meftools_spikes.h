@@ -0,0 +1,70 @@
+//
+//  meftools_spikes.h
+//
+//  Threshold-crossing spike detection on a stream of (optionally filtered) samples. The detector is a
+//  FilteredSink, so it sits directly behind stream_segment() or filtfilt_segment() and sees each sample
+//  once, holding only one noise window plus the snippet margins.
+//
+
+#ifndef __MEFTOOLS_SPIKES
+#define __MEFTOOLS_SPIKES
+
+#include <vector>
+
+#include "meftools_dsp.h"
+
+namespace meftools {
+
+  typedef struct {
+    sf8 threshold;      // multiple of the noise estimate
+    si4 polarity;       // -1 troughs, +1 peaks, 0 either
+    ui8 window;         // samples per noise estimate
+    ui8 dead_time;      // samples after a detected peak during which crossings are ignored
+    ui8 pre;            // snippet samples before the peak
+    ui8 post;           // snippet samples after the peak
+  } SPIKE_PARAMS;
+
+  typedef struct {
+    ui8 sample;         // sample number of the peak
+    sf8 amplitude;      // signed value at the peak
+    sf8 threshold;      // absolute threshold in force (noise * params.threshold)
+  } SPIKE;
+
+  //
+  //  Noise is estimated per window as median(|x - median(x)|) / 0.6745, which is insensitive to the
+  //  spikes themselves. A spike is the extremum (in the detected polarity) within dead_time samples of a
+  //  crossing; spikes whose snippet would run past either end of the stream are dropped.
+  //
+  class SpikeDetector : public FilteredSink {
+  public:
+    explicit SpikeDetector(const SPIKE_PARAMS &params);
+
+    void write(ui8 first_sample, const sf8 *y, size_t n);
+
+    // Process what is left once the stream has ended.
+    void finish();
+
+    const std::vector<SPIKE> &spikes() const { return spikes_; }
+    // (pre + post + 1) values per spike, in spike order.
+    const std::vector<sf8> &waveforms() const { return waveforms_; }
+
+  private:
+    void process_window(bool last);
+    sf8 noise(ui8 w0, ui8 w1);
+
+    SPIKE_PARAMS params_;
+    std::vector<sf8> buffer_;
+    ui8 base_;              // sample number of buffer_[0]
+    ui8 stream_first_;
+    ui8 window_start_;      // first sample of the next window to process
+    ui8 next_allowed_;      // end of the current dead time
+    sf8 last_noise_;        // estimate from the previous full window
+    bool started_;
+    std::vector<sf8> scratch_;
+    std::vector<SPIKE> spikes_;
+    std::vector<sf8> waveforms_;
+  };
+
+}
+
+#endif
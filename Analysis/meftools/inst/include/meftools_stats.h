@@ -0,0 +1,82 @@
+//
+//  meftools_stats.h
+//
+//  Always-on counters for the native read path: calls and nanoseconds per stage, bytes read, blocks and
+//  samples decoded, block cache hits and misses. They are process-wide totals updated with relaxed atomic
+//  adds, at most a few per block, so they can stay enabled; meftools_stats() in R snapshots and resets them.
+//
+
+#ifndef __MEFTOOLS_STATS
+#define __MEFTOOLS_STATS
+
+#include "meftools_types.h"
+#include "meftools_trace.h"
+
+namespace meftools {
+
+  // Timed stages, in the order a read goes through them. Stages do not nest.
+  enum {
+    STAGE_OPEN = 0,           // opening the file and reading its header block
+    STAGE_HEADER_DECRYPT,     // password validation, header decryption and parsing
+    STAGE_KEY_EXPANSION,      // AES key schedule for the data key
+    STAGE_INDEX_LOAD,         // reading and checking the block index and discontinuity flags
+    STAGE_BLOCK_READ,         // reading compressed blocks (or mapping their headers)
+    STAGE_RANGE_DECODE,       // model decryption and range decoding of a block's differences
+    STAGE_DIFF_RECONSTRUCT,   // turning a block's differences back into samples
+    STAGE_OUTPUT_COPY,        // copying decoded samples into the caller's (R's) vector
+    STAGE_COUNT
+  };
+
+  enum {
+    COUNTER_BYTES_READ = 0,
+    COUNTER_BLOCKS_DECODED,
+    COUNTER_SAMPLES_DECODED,
+    COUNTER_CACHE_HITS,
+    COUNTER_CACHE_MISSES,
+    COUNTER_SHARED_HITS,      // blocks found in the cross-process cache (meftools_shared_cache.h)
+    COUNTER_SHARED_MISSES,
+    COUNTER_COUNT
+  };
+
+  // A snapshot. Each field is read atomically, the set as a whole is not.
+  typedef struct {
+    ui8 calls[STAGE_COUNT];
+    ui8 nanoseconds[STAGE_COUNT];
+    ui8 counters[COUNTER_COUNT];
+  } MEF_STATS;
+
+  const char *stage_name(int stage);
+  const char *counter_name(int counter);
+
+  // Monotonic clock in nanoseconds.
+  ui8 stats_clock();
+
+  void stats_stage(int stage, ui8 nanoseconds);
+  void stats_count(int counter, ui8 n);
+
+  void stats_snapshot(MEF_STATS *stats);
+  void stats_reset();
+
+  // Adds one call and the time until it goes out of scope (or stop()) to a stage, and an event to the
+  // trace when tracing is on.
+  class StageTimer {
+  public:
+    explicit StageTimer(int stage) : stage_(stage), start_(stats_clock()) {}
+    ~StageTimer() { stop(); }
+    void stop() {
+      if (stage_ >= 0) {
+        ui8 end = stats_clock();
+        stats_stage(stage_, end - start_);
+        if (tracing())
+          trace_span(stage_name(stage_), "stage", start_, end);
+        stage_ = -1;
+      }
+    }
+  private:
+    int stage_;
+    ui8 start_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,49 @@
+//
+//  meftools_trace.h
+//
+//  Opt-in timeline of the native read path. While tracing is on, every StageTimer (see meftools_stats.h)
+//  and every TraceSpan records a complete event with its thread, and trace_write() dumps them in the
+//  Chrome trace-event JSON format that chrome://tracing and ui.perfetto.dev open. When tracing is off a
+//  span costs one relaxed atomic load.
+//
+
+#ifndef __MEFTOOLS_TRACE
+#define __MEFTOOLS_TRACE
+
+#include <atomic>
+
+#include "meftools_types.h"
+
+namespace meftools {
+
+  extern std::atomic<bool> trace_enabled;
+
+  inline bool tracing() { return trace_enabled.load(std::memory_order_relaxed); }
+
+  // Discard any recorded events and start recording; timestamps are relative to this call.
+  void trace_start();
+  void trace_stop();
+  ui8 trace_event_count();
+
+  // Record one event that ran from start to end (stats_clock() nanoseconds) on the calling thread.
+  // name and category must be string literals or otherwise outlive the trace. arg < 0 means no argument.
+  void trace_span(const char *name, const char *category, ui8 start, ui8 end, si8 arg = -1);
+
+  // Write the recorded events to path. Returns MEF_OK or MEF_ERR_WRITE.
+  si4 trace_write(const char *path);
+
+  // Records a span from construction to destruction (or stop()) when tracing is on.
+  class TraceSpan {
+  public:
+    TraceSpan(const char *name, const char *category, si8 arg = -1);
+    ~TraceSpan() { stop(); }
+    void stop();
+  private:
+    const char *name_, *category_;
+    si8 arg_;
+    ui8 start_;
+  };
+
+}
+
+#endif
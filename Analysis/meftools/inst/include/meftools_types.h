@@ -1,4 +1,15 @@
+#ifndef __MEFTOOLS_TYPES
+#define __MEFTOOLS_TYPES
+
+// The R package build defines MEFTOOLS_R (src/Makevars), which also makes the header structure
+// visible to Rcpp as Rcpp::MEF_HEADER_INFO. Anywhere else (C/libmeftools, programs including the
+// installed headers) the codec is built without R: MEFTOOLS_STANDALONE.
+#if !defined(MEFTOOLS_R) && !defined(MEFTOOLS_STANDALONE)
+#define MEFTOOLS_STANDALONE
+#endif
+#ifndef MEFTOOLS_STANDALONE
 #include <RcppCommon.h>
+#endif
 
   /******************** header fields *************************/
   /************* header version & constants *******************/
@@ -154,8 +165,6 @@
 
   // BEGIN --- endian_functions.c
   
-  namespace Rcpp {
-  // [[Rcpp::export]]
   typedef struct {
     si1	institution[INSTITUTION_LENGTH];
     si1	unencrypted_text_field[UNENCRYPTED_TEXT_FIELD_LENGTH];
@@ -208,11 +217,16 @@
     ui8 *discontinuity_data;
   } MEF_HEADER_INFO;
   
+#ifndef MEFTOOLS_STANDALONE
+  namespace Rcpp {
+  using ::MEF_HEADER_INFO;
+  
   template <> SEXP wrap(const MEF_HEADER_INFO& x);
   
   template<> MEF_HEADER_INFO* as(SEXP x);
   
   } 
+#endif
   
   typedef struct {
     ui4 CRC_32;
@@ -235,68 +249,8 @@
     ui1	*ob_p;
   } RANGE_STATS;
 
-  // #include "size_types.h" // already listed above
-  // #include "endian_functions.h"
-  // BEGIN --- endian_functions.h ---
-#ifndef __ENDIAN_FUNCTIONS
-#define __ENDIAN_FUNCTIONS
-  
-  // get cpu endianness: 0 = big, 1 = little */
-  static ui1	cpu_endianness();
-  static void init_crc32_tab( void );
-
-  static void	reverse_in_place(void *x, si4 len);
-  static int	getSBoxValue(int num);
-  static int	getSBoxInvert(int num);
-  static void	AES_KeyExpansion(int Nk, int Nr, unsigned char *RoundKey, unsigned char *Key);
-  static void	AddRoundKey(int round, unsigned char state[][4], unsigned char *RoundKey);
-  static void	SubBytes(unsigned char state[][4]);
-  static void	InvSubBytes(unsigned char state[][4]);
-  static void	ShiftRows(unsigned char state[][4]);
-  static void	InvShiftRows(unsigned char state[][4]);
-  static void	MixColumns(unsigned char state[][4]);
-  static void	InvMixColumns(unsigned char state[][4]);
-  static void Cipher(int Nr, unsigned char *in, unsigned char *out, unsigned char state[][4], unsigned char *RoundKey);
-  static void	InvCipher(int Nr, unsigned char *in, unsigned char *out, unsigned char state[][4], unsigned char *RoundKey);
-  static void	AES_encrypt(unsigned char *in, unsigned char *out, char *password);
-  static void	AES_encryptWithKey(unsigned char *in, unsigned char *out, unsigned char *RoundKey);
-  static void	AES_decrypt(unsigned char *in, unsigned char *out, char *password);
-  static void	AES_decryptWithKey(unsigned char *in, unsigned char *out, unsigned char *RoundKey);
-  static si4 check_header_block_alignment(ui1 *header_block, si4 verbose);
-  static void strncpy2(si1 *s1, si1 *s2, si4 n);
-  static void init_hdr_struct(Rcpp::MEF_HEADER_INFO *header);
-  static si4	write_mef(si4 *samps, Rcpp::MEF_HEADER_INFO *mef_header, ui8 len, si1 *out_file, si1 *subject_password);
-  static si4	write_mef_ind(si4 *samps, Rcpp::MEF_HEADER_INFO *mef_header, ui8 len, si1 *out_file, si1 *subject_password, INDEX_DATA *index_block, si4 num_blocks, ui1 *discontinuity_array);
-  static si4	build_RED_block_header(ui1 *header_block, RED_BLOCK_HDR_INFO *header_struct);
-  static ui8 set_session_unique_ID(char *file_name, ui1 *array);
-  static void set_hdr_unique_ID(Rcpp::MEF_HEADER_INFO *header, ui1 *array);
-  static ui8 generate_unique_ID(ui1 *array);
-  static ui4 calculate_CRC(ui1 *data_block);  
-  static si4	validate_password(ui1 *header_block, si1 *password);
-  static si4	build_mef_header_block(ui1 *encrypted_hdr_block, Rcpp::MEF_HEADER_INFO *hdr_struct, si1 *password);
-  static si4	read_mef_header_block(ui1 *header_block, Rcpp::MEF_HEADER_INFO *header_struct, si1 *password);
-  static void set_block_hdr_unique_ID(ui1 *block_header, ui1 *array);
-  static si4 validate_mef(char *mef_filename, char *log_filename, char *password);
-  static void encode_symbol(ui1 symbol, ui4 symbol_cnts, ui4 cnts_lt_symbol, ui4 tot_cnts, RANGE_STATS *rstats );
-  static void done_encoding(RANGE_STATS *rstats);
-  static void enc_normalize(RANGE_STATS *rstats);
-  static si4	read_RED_block_header(ui1 *header_block, RED_BLOCK_HDR_INFO *header_struct);
-  static ui8 RED_compress_block(si4 *in_buffer, ui1 *out_buffer, ui4 num_entries, ui8 uUTC_time, ui1 discontinuity, si1 *key, RED_BLOCK_HDR_INFO *block_hdr);
-  static void showHeader(Rcpp::MEF_HEADER_INFO *headerStruct);
   
   
   
-  static si2	rev_si2(si2 x);
-  static ui2	rev_ui2(ui2 x);
-  static si4	rev_si4(si4 x);
-  static ui4	rev_ui4(ui4 x);
-  static sf4	rev_sf4(sf4 x);
-  static si8	rev_si8(si8 x);
-  static ui8	rev_ui8(ui8 x);
-  static sf8	rev_sf8(sf8 x);
-  
+
 #endif
-  // END --- endian_functions.h ---
-  
-  
-  
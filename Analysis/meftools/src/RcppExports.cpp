@@ -11,8 +11,35 @@ Rcpp::Rostream<true>&  Rcpp::Rcout = Rcpp::Rcpp_cout_get();
 Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
+// build_mef_pyramid
+std::string build_mef_pyramid(Rcpp::StringVector strings, Rcpp::NumericVector rates, int threads);
+RcppExport SEXP _meftools_build_mef_pyramid(SEXP stringsSEXP, SEXP ratesSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type rates(ratesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(build_mef_pyramid(strings, rates, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// butter_sos
+Rcpp::NumericMatrix butter_sos(int order, double low, double high, double fs);
+RcppExport SEXP _meftools_butter_sos(SEXP orderSEXP, SEXP lowSEXP, SEXP highSEXP, SEXP fsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type order(orderSEXP);
+    Rcpp::traits::input_parameter< double >::type low(lowSEXP);
+    Rcpp::traits::input_parameter< double >::type high(highSEXP);
+    Rcpp::traits::input_parameter< double >::type fs(fsSEXP);
+    rcpp_result_gen = Rcpp::wrap(butter_sos(order, low, high, fs));
+    return rcpp_result_gen;
+END_RCPP
+}
 // decomp_mef
-std::vector<int> decomp_mef(Rcpp::StringVector strings);
+Rcpp::IntegerVector decomp_mef(Rcpp::StringVector strings);
 RcppExport SEXP _meftools_decomp_mef(SEXP stringsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
@@ -34,6 +61,271 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// mef_envelope
+Rcpp::DataFrame mef_envelope(Rcpp::StringVector strings, int bins);
+RcppExport SEXP _meftools_mef_envelope(SEXP stringsSEXP, SEXP binsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< int >::type bins(binsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_envelope(strings, bins));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mef_epochs
+Rcpp::List mef_epochs(Rcpp::StringVector files, Rcpp::StringVector strings, Rcpp::NumericVector times, int pre, int post, int threads);
+RcppExport SEXP _meftools_mef_epochs(SEXP filesSEXP, SEXP stringsSEXP, SEXP timesSEXP, SEXP preSEXP, SEXP postSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type files(filesSEXP);
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type times(timesSEXP);
+    Rcpp::traits::input_parameter< int >::type pre(preSEXP);
+    Rcpp::traits::input_parameter< int >::type post(postSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_epochs(files, strings, times, pre, post, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mef_export_dat
+Rcpp::DataFrame mef_export_dat(Rcpp::StringVector files, Rcpp::StringVector strings, bool saturate, int threads);
+RcppExport SEXP _meftools_mef_export_dat(SEXP filesSEXP, SEXP stringsSEXP, SEXP saturateSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type files(filesSEXP);
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< bool >::type saturate(saturateSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_export_dat(files, strings, saturate, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mef_features
+Rcpp::DataFrame mef_features(Rcpp::StringVector strings, double window, double hop, Rcpp::StringVector features, Rcpp::NumericMatrix bands, int threads);
+RcppExport SEXP _meftools_mef_features(SEXP stringsSEXP, SEXP windowSEXP, SEXP hopSEXP, SEXP featuresSEXP, SEXP bandsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< double >::type window(windowSEXP);
+    Rcpp::traits::input_parameter< double >::type hop(hopSEXP);
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type features(featuresSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type bands(bandsSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_features(strings, window, hop, features, bands, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mef_filtfilt
+Rcpp::List mef_filtfilt(Rcpp::StringVector strings, Rcpp::NumericMatrix sos, int threads);
+RcppExport SEXP _meftools_mef_filtfilt(SEXP stringsSEXP, SEXP sosSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type sos(sosSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_filtfilt(strings, sos, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mef_int16
+Rcpp::RawVector mef_int16(Rcpp::StringVector strings, bool saturate);
+RcppExport SEXP _meftools_mef_int16(SEXP stringsSEXP, SEXP saturateSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< bool >::type saturate(saturateSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_int16(strings, saturate));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mef_microvolts
+Rcpp::NumericVector mef_microvolts(Rcpp::StringVector strings);
+RcppExport SEXP _meftools_mef_microvolts(SEXP stringsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_microvolts(strings));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mef_open
+SEXP mef_open(Rcpp::StringVector strings);
+RcppExport SEXP _meftools_mef_open(SEXP stringsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_open(strings));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mef_psd
+Rcpp::List mef_psd(Rcpp::StringVector strings, double interval, double segment, double overlap, int threads);
+RcppExport SEXP _meftools_mef_psd(SEXP stringsSEXP, SEXP intervalSEXP, SEXP segmentSEXP, SEXP overlapSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< double >::type interval(intervalSEXP);
+    Rcpp::traits::input_parameter< double >::type segment(segmentSEXP);
+    Rcpp::traits::input_parameter< double >::type overlap(overlapSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_psd(strings, interval, segment, overlap, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mef_resample
+Rcpp::List mef_resample(Rcpp::StringVector strings, int up, int down, int threads);
+RcppExport SEXP _meftools_mef_resample(SEXP stringsSEXP, SEXP upSEXP, SEXP downSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< int >::type up(upSEXP);
+    Rcpp::traits::input_parameter< int >::type down(downSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_resample(strings, up, down, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mef_spikes
+Rcpp::List mef_spikes(Rcpp::StringVector strings, double threshold, int polarity, double window, double dead_time, int pre, int post, Rcpp::NumericMatrix sos, int threads);
+RcppExport SEXP _meftools_mef_spikes(SEXP stringsSEXP, SEXP thresholdSEXP, SEXP polaritySEXP, SEXP windowSEXP, SEXP dead_timeSEXP, SEXP preSEXP, SEXP postSEXP, SEXP sosSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< double >::type threshold(thresholdSEXP);
+    Rcpp::traits::input_parameter< int >::type polarity(polaritySEXP);
+    Rcpp::traits::input_parameter< double >::type window(windowSEXP);
+    Rcpp::traits::input_parameter< double >::type dead_time(dead_timeSEXP);
+    Rcpp::traits::input_parameter< int >::type pre(preSEXP);
+    Rcpp::traits::input_parameter< int >::type post(postSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type sos(sosSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_spikes(strings, threshold, polarity, window, dead_time, pre, post, sos, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mef_validate
+Rcpp::DataFrame mef_validate(Rcpp::StringVector strings, int threads);
+RcppExport SEXP _meftools_mef_validate(SEXP stringsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_validate(strings, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mef_vector
+SEXP mef_vector(SEXP handle);
+RcppExport SEXP _meftools_mef_vector(SEXP handleSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    rcpp_result_gen = Rcpp::wrap(mef_vector(handle));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mefd_epochs
+Rcpp::IntegerMatrix mefd_epochs(std::string socket, Rcpp::StringVector strings, Rcpp::NumericVector times, int pre, int post);
+RcppExport SEXP _meftools_mefd_epochs(SEXP socketSEXP, SEXP stringsSEXP, SEXP timesSEXP, SEXP preSEXP, SEXP postSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type socket(socketSEXP);
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type times(timesSEXP);
+    Rcpp::traits::input_parameter< int >::type pre(preSEXP);
+    Rcpp::traits::input_parameter< int >::type post(postSEXP);
+    rcpp_result_gen = Rcpp::wrap(mefd_epochs(socket, strings, times, pre, post));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mefd_times
+Rcpp::IntegerVector mefd_times(std::string socket, Rcpp::StringVector strings);
+RcppExport SEXP _meftools_mefd_times(SEXP socketSEXP, SEXP stringsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type socket(socketSEXP);
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mefd_times(socket, strings));
+    return rcpp_result_gen;
+END_RCPP
+}
+// meftools_shared_cache
+Rcpp::NumericVector meftools_shared_cache(double size_mb, std::string name, int slot_samples, bool remove);
+RcppExport SEXP _meftools_meftools_shared_cache(SEXP size_mbSEXP, SEXP nameSEXP, SEXP slot_samplesSEXP, SEXP removeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< double >::type size_mb(size_mbSEXP);
+    Rcpp::traits::input_parameter< std::string >::type name(nameSEXP);
+    Rcpp::traits::input_parameter< int >::type slot_samples(slot_samplesSEXP);
+    Rcpp::traits::input_parameter< bool >::type remove(removeSEXP);
+    rcpp_result_gen = Rcpp::wrap(meftools_shared_cache(size_mb, name, slot_samples, remove));
+    return rcpp_result_gen;
+END_RCPP
+}
+// meftools_stats
+Rcpp::List meftools_stats(bool reset);
+RcppExport SEXP _meftools_meftools_stats(SEXP resetSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< bool >::type reset(resetSEXP);
+    rcpp_result_gen = Rcpp::wrap(meftools_stats(reset));
+    return rcpp_result_gen;
+END_RCPP
+}
+// meftools_trace
+double meftools_trace(bool enable, std::string file);
+RcppExport SEXP _meftools_meftools_trace(SEXP enableSEXP, SEXP fileSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< bool >::type enable(enableSEXP);
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    rcpp_result_gen = Rcpp::wrap(meftools_trace(enable, file));
+    return rcpp_result_gen;
+END_RCPP
+}
+// nev_events
+Rcpp::DataFrame nev_events(SEXP handle, double start, double stop, std::string event);
+RcppExport SEXP _meftools_nev_events(SEXP handleSEXP, SEXP startSEXP, SEXP stopSEXP, SEXP eventSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< double >::type start(startSEXP);
+    Rcpp::traits::input_parameter< double >::type stop(stopSEXP);
+    Rcpp::traits::input_parameter< std::string >::type event(eventSEXP);
+    rcpp_result_gen = Rcpp::wrap(nev_events(handle, start, stop, event));
+    return rcpp_result_gen;
+END_RCPP
+}
+// nev_open
+SEXP nev_open(Rcpp::StringVector strings);
+RcppExport SEXP _meftools_nev_open(SEXP stringsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    rcpp_result_gen = Rcpp::wrap(nev_open(strings));
+    return rcpp_result_gen;
+END_RCPP
+}
 // read_mef_header
 Rcpp::MEF_HEADER_INFO read_mef_header(Rcpp::StringVector strings);
 RcppExport SEXP _meftools_read_mef_header(SEXP stringsSEXP) {
@@ -45,6 +337,30 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// read_mef_pyramid
+Rcpp::DataFrame read_mef_pyramid(Rcpp::StringVector strings, int pixels);
+RcppExport SEXP _meftools_read_mef_pyramid(SEXP stringsSEXP, SEXP pixelsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< int >::type pixels(pixelsSEXP);
+    rcpp_result_gen = Rcpp::wrap(read_mef_pyramid(strings, pixels));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scan_mef_catalog
+Rcpp::DataFrame scan_mef_catalog(Rcpp::StringVector strings, int threads);
+RcppExport SEXP _meftools_scan_mef_catalog(SEXP stringsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type strings(stringsSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_mef_catalog(strings, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // table_of_contents
 Rcpp::NumericMatrix table_of_contents(Rcpp::StringVector strings);
 RcppExport SEXP _meftools_table_of_contents(SEXP stringsSEXP) {
@@ -58,14 +374,40 @@ END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
+    {"_meftools_build_mef_pyramid", (DL_FUNC) &_meftools_build_mef_pyramid, 3},
+    {"_meftools_butter_sos", (DL_FUNC) &_meftools_butter_sos, 4},
     {"_meftools_decomp_mef", (DL_FUNC) &_meftools_decomp_mef, 1},
     {"_meftools_get_discontinuities", (DL_FUNC) &_meftools_get_discontinuities, 2},
+    {"_meftools_mef_envelope", (DL_FUNC) &_meftools_mef_envelope, 2},
+    {"_meftools_mef_epochs", (DL_FUNC) &_meftools_mef_epochs, 6},
+    {"_meftools_mef_export_dat", (DL_FUNC) &_meftools_mef_export_dat, 4},
+    {"_meftools_mef_features", (DL_FUNC) &_meftools_mef_features, 6},
+    {"_meftools_mef_filtfilt", (DL_FUNC) &_meftools_mef_filtfilt, 3},
+    {"_meftools_mef_int16", (DL_FUNC) &_meftools_mef_int16, 2},
+    {"_meftools_mef_microvolts", (DL_FUNC) &_meftools_mef_microvolts, 1},
+    {"_meftools_mef_open", (DL_FUNC) &_meftools_mef_open, 1},
+    {"_meftools_mef_psd", (DL_FUNC) &_meftools_mef_psd, 5},
+    {"_meftools_mef_resample", (DL_FUNC) &_meftools_mef_resample, 4},
+    {"_meftools_mef_spikes", (DL_FUNC) &_meftools_mef_spikes, 9},
+    {"_meftools_mef_validate", (DL_FUNC) &_meftools_mef_validate, 2},
+    {"_meftools_mef_vector", (DL_FUNC) &_meftools_mef_vector, 1},
+    {"_meftools_mefd_epochs", (DL_FUNC) &_meftools_mefd_epochs, 5},
+    {"_meftools_mefd_times", (DL_FUNC) &_meftools_mefd_times, 2},
+    {"_meftools_meftools_shared_cache", (DL_FUNC) &_meftools_meftools_shared_cache, 4},
+    {"_meftools_meftools_stats", (DL_FUNC) &_meftools_meftools_stats, 1},
+    {"_meftools_meftools_trace", (DL_FUNC) &_meftools_meftools_trace, 2},
+    {"_meftools_nev_events", (DL_FUNC) &_meftools_nev_events, 4},
+    {"_meftools_nev_open", (DL_FUNC) &_meftools_nev_open, 1},
     {"_meftools_read_mef_header", (DL_FUNC) &_meftools_read_mef_header, 1},
+    {"_meftools_read_mef_pyramid", (DL_FUNC) &_meftools_read_mef_pyramid, 2},
+    {"_meftools_scan_mef_catalog", (DL_FUNC) &_meftools_scan_mef_catalog, 2},
     {"_meftools_table_of_contents", (DL_FUNC) &_meftools_table_of_contents, 1},
     {NULL, NULL, 0}
 };
 
+void init_mef_vector(DllInfo* dll);
 RcppExport void R_init_meftools(DllInfo *dll) {
     R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
     R_useDynamicSymbols(dll, FALSE);
+    init_mef_vector(dll);
 }
@@ -1,10 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-#include "../inst/include/meftools_types.h"
+#include <string>
+
+#include "../inst/include/meftools_core.h"
         
 // [[Rcpp::plugins("cpp11")]]
 
@@ -18,22 +20,24 @@
 //' @export
 // [[Rcpp::export]]
 Rcpp::NumericVector get_discontinuities( Rcpp::StringVector strings, Rcpp::NumericMatrix ToC ) {
-  char *filename = strings(0);
+  std::string filename = Rcpp::as<std::string>( strings(0) );
   int number_of_index_entries = atoi( strings(1) );
+  if ( number_of_index_entries > ToC.ncol() )
+    Rcpp::stop( filename + ": more index entries than table of contents columns" );
 
-  FILE *fp = fopen( filename, "r" );
-  unsigned char* buf = (unsigned char *)malloc( 1 * sizeof(unsigned char) );
-  // Convert "buf" into a 3-column matrix.
+  int fd = open( filename.c_str(), O_RDONLY );
+  if ( fd < 0 )
+    Rcpp::stop( filename + ": " + meftools::error_string( meftools::MEF_ERR_OPEN ) );
+  // The flag is the discontinuity byte of each RED block header.
   Rcpp::NumericVector discontinuities(number_of_index_entries);
   for (int col=0; col<number_of_index_entries; col++ ) {
-    fseek( fp, ToC(1,col)+30, SEEK_SET );
-    fread( buf, sizeof(unsigned char), 1, fp );
-    discontinuities(col) = (int) buf[0];
+    ui1 flag;
+    if ( pread( fd, &flag, 1, (off_t) ToC(1,col) + RED_DISCONTINUITY_OFFSET ) != 1 ) {
+      close( fd );
+      Rcpp::stop( filename + ": " + meftools::error_string( meftools::MEF_ERR_READ ) );
+    }
+    discontinuities(col) = (int) flag;
   }
-  fclose( fp );
+  close( fd );
   return( discontinuities );
 }
-
-
-
-
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_parallel.h"
+
+//
+//  Session catalog: one row per .mef channel found below a directory.
+//
+//  Only the header, block index and discontinuity index of each file are read, so a scan costs a few
+//  kilobytes of I/O per channel. Files are opened on worker threads; the data frame is assembled on the
+//  calling thread afterwards.
+//
+
+namespace {
+
+  typedef struct {
+    std::string channel;
+    sf8 start_time;
+    sf8 end_time;
+    sf8 sampling_frequency;
+    sf8 number_of_samples;
+    sf8 number_of_blocks;
+    sf8 discontinuities;
+    std::string file_unique_ID;
+    std::string status;
+  } CATALOG_ROW;
+
+  bool has_mef_suffix(const char *name)
+  {
+    size_t len = strlen(name);
+    return len > 4 && strcmp(name + len - 4, ".mef") == 0;
+  }
+
+  void find_mef_files(const std::string &directory, std::vector<std::string> &paths)
+  {
+    DIR *dir;
+    struct dirent *entry;
+    struct stat sb;
+
+    dir = opendir(directory.c_str());
+    if (dir == NULL)
+      return;
+    while ((entry = readdir(dir)) != NULL) {
+      if (entry->d_name[0] == '.')
+        continue;
+      std::string path = directory + "/" + entry->d_name;
+      if (stat(path.c_str(), &sb) != 0)
+        continue;
+      if (S_ISDIR(sb.st_mode))
+        find_mef_files(path, paths);
+      else if (S_ISREG(sb.st_mode) && has_mef_suffix(entry->d_name))
+        paths.push_back(path);
+    }
+    closedir(dir);
+  }
+
+  void catalog_file(const std::string &path, const char *password, CATALOG_ROW *row)
+  {
+    meftools::MefChannel channel;
+    si1 hex[2 * FILE_UNIQUE_ID_LENGTH + 1];
+    si4 err;
+
+    row->start_time = row->end_time = NA_REAL;
+    row->sampling_frequency = row->number_of_samples = NA_REAL;
+    row->number_of_blocks = row->discontinuities = NA_REAL;
+
+    err = channel.open(path.c_str(), password);
+    if (err) {
+      row->status = meftools::error_string(err);
+      return;
+    }
+
+    const Rcpp::MEF_HEADER_INFO &h = channel.header();
+    std::vector<meftools::MEF_SEGMENT> segments = channel.segments();
+    row->channel = h.channel_name;
+    row->sampling_frequency = h.sampling_frequency;
+    row->number_of_samples = (sf8) h.number_of_samples;
+    row->number_of_blocks = (sf8) channel.number_of_blocks();
+    row->discontinuities = segments.empty() ? 0 : (sf8) (segments.size() - 1);
+    if (segments.empty()) {
+      row->start_time = (sf8) h.recording_start_time;
+      row->end_time = (sf8) h.recording_end_time;
+    } else {
+      row->start_time = (sf8) segments.front().start_time;
+      row->end_time = (sf8) segments.back().end_time;
+    }
+    for (si4 i = 0; i < FILE_UNIQUE_ID_LENGTH; i++)
+      sprintf(hex + 2 * i, "%02x", h.file_unique_ID[i]);
+    row->file_unique_ID = hex;
+    row->status = "ok";
+  }
+
+}
+
+//' Scan a directory tree for .mef files and summarise each channel.
+//'
+//' @param strings StringVector: directory, password
+//' @param threads Number of worker threads; 0 uses one per core.
+//' @return data.frame with one row per file. Times are uUTC (microseconds); discontinuities counts the
+//'   breaks after the first block, so a fully contiguous channel has 0.
+//' @export
+// [[Rcpp::export]]
+Rcpp::DataFrame scan_mef_catalog( Rcpp::StringVector strings, int threads ) {
+    std::string directory = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+
+    while ( directory.size() > 1 && directory[directory.size()-1] == '/' )
+        directory.erase( directory.size() - 1 );
+
+    std::vector<std::string> paths;
+    find_mef_files( directory, paths );
+    std::sort( paths.begin(), paths.end() );
+
+    std::vector<CATALOG_ROW> rows( paths.size() );
+    const char *pwd = password.c_str();
+    meftools::parallel_for( paths.size(), threads, [&]( size_t i ) {
+        catalog_file( paths[i], pwd, &rows[i] );
+    } );
+
+    size_t n = rows.size();
+    Rcpp::CharacterVector channel( n ), file_unique_ID( n ), path( n ), status( n );
+    Rcpp::NumericVector start_time( n ), end_time( n ), sampling_frequency( n ), number_of_samples( n );
+    Rcpp::NumericVector number_of_blocks( n ), discontinuities( n );
+    for ( size_t i = 0; i < n; i++ ) {
+        channel[i] = rows[i].channel;
+        start_time[i] = rows[i].start_time;
+        end_time[i] = rows[i].end_time;
+        sampling_frequency[i] = rows[i].sampling_frequency;
+        number_of_samples[i] = rows[i].number_of_samples;
+        number_of_blocks[i] = rows[i].number_of_blocks;
+        discontinuities[i] = rows[i].discontinuities;
+        file_unique_ID[i] = rows[i].file_unique_ID;
+        path[i] = paths[i];
+        status[i] = rows[i].status;
+    }
+
+    return Rcpp::DataFrame::create( Rcpp::Named("channel") = channel,
+                                    Rcpp::Named("start_time") = start_time,
+                                    Rcpp::Named("end_time") = end_time,
+                                    Rcpp::Named("sampling_frequency") = sampling_frequency,
+                                    Rcpp::Named("number_of_samples") = number_of_samples,
+                                    Rcpp::Named("number_of_blocks") = number_of_blocks,
+                                    Rcpp::Named("discontinuities") = discontinuities,
+                                    Rcpp::Named("file_unique_ID") = file_unique_ID,
+                                    Rcpp::Named("path") = path,
+                                    Rcpp::Named("status") = status,
+                                    Rcpp::Named("stringsAsFactors") = false );
+}
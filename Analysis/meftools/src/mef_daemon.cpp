@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_daemon.h"
+
+//' Read a time window through mefd.
+//'
+//' mefd (C/libmeftools) is a per-node server that keeps channels open and decodes each block once into
+//' a cache shared by every client, so many R processes reading the same channels do not each decode
+//' them. The cache is private to mefd; each reply's samples are copied into a memory-mapped tmpfs file
+//' rather than sent through the socket.
+//'
+//' @param socket Path of mefd's socket.
+//' @param strings StringVector: filename, password, t0, t1 (uUTC, inclusive)
+//' @return Integer vector of every sample timed within t0..t1, with attribute 'starts': the first
+//'   sample number of each contiguous piece (a gap in the recording starts a new piece).
+//' @export
+// [[Rcpp::export]]
+Rcpp::IntegerVector mefd_times( std::string socket, Rcpp::StringVector strings ) {
+    if ( strings.size() < 4 )
+        Rcpp::stop( "strings must hold filename, password, t0 and t1" );
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    std::string password = Rcpp::as<std::string>( strings(1) );
+    ui8 t0 = (ui8) atof( strings(2) );
+    ui8 t1 = (ui8) atof( strings(3) );
+
+    meftools::DaemonReply reply;
+    si4 err = meftools::daemon_read_times( socket.c_str(), filename.c_str(), password.c_str(), t0, t1, reply );
+    if ( err )
+        Rcpp::stop( reply.message().empty() ? filename + ": " + meftools::error_string( err ) : reply.message() );
+
+    Rcpp::IntegerVector out( reply.data(), reply.data() + reply.size() );
+    out.attr( "starts" ) = Rcpp::NumericVector( reply.starts().begin(), reply.starts().end() );
+    return out;
+}
+
+//' Read epochs around event times through mefd.
+//'
+//' @param socket Path of mefd's socket.
+//' @param strings StringVector: filename, password
+//' @param times Event times (uUTC).
+//' @param pre Samples before each event's sample.
+//' @param post Samples after each event's sample.
+//' @return Integer matrix with pre + 1 + post rows and one column per event, with attribute 'starts':
+//'   the first sample number of each epoch.
+//' @export
+// [[Rcpp::export]]
+Rcpp::IntegerMatrix mefd_epochs( std::string socket, Rcpp::StringVector strings, Rcpp::NumericVector times,
+                                 int pre, int post ) {
+    if ( strings.size() < 2 )
+        Rcpp::stop( "strings must hold filename and password" );
+    if ( pre < 0 || post < 0 )
+        Rcpp::stop( "pre and post must not be negative" );
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    std::string password = Rcpp::as<std::string>( strings(1) );
+    std::vector<ui8> t( times.size() );
+    for ( R_xlen_t i = 0; i < times.size(); i++ )
+        t[i] = (ui8) times[i];
+
+    meftools::DaemonReply reply;
+    si4 err = meftools::daemon_read_epochs( socket.c_str(), filename.c_str(), password.c_str(), t, pre, post, reply );
+    if ( err )
+        Rcpp::stop( reply.message().empty() ? filename + ": " + meftools::error_string( err ) : reply.message() );
+
+    // epochs arrive one after another, which is R's column-major order
+    Rcpp::IntegerMatrix out( pre + 1 + post, (int) t.size() );
+    memcpy( out.begin(), reply.data(), reply.size() * sizeof(si4) );
+    out.attr( "starts" ) = Rcpp::NumericVector( reply.starts().begin(), reply.starts().end() );
+    return out;
+}
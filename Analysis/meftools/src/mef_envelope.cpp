@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+
+//
+//  Min/max envelope from RED block headers. Every block header carries the block's extreme values,
+//  sample count and start time, so an overview of any length costs one header read per block and no
+//  decoding at all.
+//
+
+//' Return the min/max envelope of a MEF channel without decoding samples.
+//'
+//' @param strings StringVector: filename, password, and optionally time0, time1 (uUTC)
+//' @param bins Number of time bins to merge blocks into; 0 returns one row per block.
+//' @return data.frame with start_time, end_time, min, max, samples and discontinuity. Values are in
+//'   raw sample units, as returned by decomp_mef. With bins > 0, empty bins are omitted and a row's
+//'   discontinuity is 1 when any block merged into it starts a new segment.
+//' @export
+// [[Rcpp::export]]
+Rcpp::DataFrame mef_envelope( Rcpp::StringVector strings, int bins ) {
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+
+    meftools::MefChannel channel;
+    si4 err = channel.open( filename.c_str(), password.c_str() );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+    if ( channel.number_of_blocks() == 0 )
+        Rcpp::stop( filename + ": no blocks" );
+
+    ui8 time0 = channel.index()[0].time;
+    ui8 time1 = channel.block_end_time( channel.number_of_blocks() - 1 );
+    if ( strings.size() > 3 ) {
+        time0 = std::max( time0, (ui8) atof( strings(2) ) );
+        time1 = std::min( time1, (ui8) atof( strings(3) ) );
+    }
+    if ( time1 <= time0 )
+        Rcpp::stop( "empty time range" );
+
+    ui8 b0 = channel.block_of_time( time0 );
+    ui8 b1 = channel.block_of_time( time1 );
+    std::vector<RED_BLOCK_HDR_INFO> headers;
+    err = channel.read_block_headers( b0, b1, headers );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+
+    const std::vector<ui1> &discontinuities = channel.discontinuities();
+    std::vector<sf8> start, stop, minimum, maximum, samples, discontinuity;
+
+    if ( bins <= 0 ) {
+        for ( ui8 b = b0; b <= b1; b++ ) {
+            const RED_BLOCK_HDR_INFO &h = headers[b - b0];
+            start.push_back( (sf8) channel.index()[b].time );
+            stop.push_back( (sf8) channel.block_end_time( b ) );
+            minimum.push_back( h.min_value );
+            maximum.push_back( h.max_value );
+            samples.push_back( h.sample_count );
+            discontinuity.push_back( discontinuities[b] );
+        }
+    } else {
+        sf8 width = (sf8) ( time1 - time0 ) / bins;
+        si8 current = -1;
+        for ( ui8 b = b0; b <= b1; b++ ) {
+            const RED_BLOCK_HDR_INFO &h = headers[b - b0];
+            ui8 t = std::max( channel.index()[b].time, time0 );
+            si8 bin = std::min( (si8) ( ( t - time0 ) / width ), (si8) bins - 1 );
+            if ( bin != current ) {
+                current = bin;
+                start.push_back( (sf8) channel.index()[b].time );
+                stop.push_back( (sf8) channel.block_end_time( b ) );
+                minimum.push_back( h.min_value );
+                maximum.push_back( h.max_value );
+                samples.push_back( h.sample_count );
+                discontinuity.push_back( discontinuities[b] );
+            } else {
+                stop.back() = (sf8) channel.block_end_time( b );
+                minimum.back() = std::min( minimum.back(), (sf8) h.min_value );
+                maximum.back() = std::max( maximum.back(), (sf8) h.max_value );
+                samples.back() += h.sample_count;
+                discontinuity.back() = std::max( discontinuity.back(), (sf8) discontinuities[b] );
+            }
+        }
+    }
+
+    return Rcpp::DataFrame::create( Rcpp::Named("start_time") = Rcpp::NumericVector( start.begin(), start.end() ),
+                                    Rcpp::Named("end_time") = Rcpp::NumericVector( stop.begin(), stop.end() ),
+                                    Rcpp::Named("min") = Rcpp::NumericVector( minimum.begin(), minimum.end() ),
+                                    Rcpp::Named("max") = Rcpp::NumericVector( maximum.begin(), maximum.end() ),
+                                    Rcpp::Named("samples") = Rcpp::NumericVector( samples.begin(), samples.end() ),
+                                    Rcpp::Named("discontinuity") = Rcpp::NumericVector( discontinuity.begin(), discontinuity.end() ) );
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_async_io.h"
+
+//' Read epochs around event times from many channels at once.
+//'
+//' Every epoch of every channel is one window of a single batch: the block reads of all of them are put
+//' in flight together (through io_uring on Linux, a pool of reader threads elsewhere) and each is
+//' decoded as soon as it arrives, so the batch waits on the storage once rather than once per epoch.
+//'
+//' @param files StringVector of .mef files.
+//' @param strings StringVector: password
+//' @param times Event times (uUTC).
+//' @param pre Samples before each event's sample.
+//' @param post Samples after each event's sample.
+//' @param threads Number of decode threads; 0 uses one per core.
+//' @return List with one integer matrix per file (named by file) of pre + 1 + post rows and one column
+//'   per event, with attribute 'starts': the first sample number of each epoch.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List mef_epochs( Rcpp::StringVector files, Rcpp::StringVector strings, Rcpp::NumericVector times,
+                       int pre, int post, int threads ) {
+    std::string password = strings.size() > 0 ? Rcpp::as<std::string>( strings(0) ) : "";
+    if ( pre < 0 || post < 0 )
+        Rcpp::stop( "pre and post must not be negative" );
+
+    size_t n_files = files.size(), n_events = times.size(), length = (size_t) pre + 1 + post;
+    std::vector<meftools::MefChannel> channels( n_files );
+    std::vector<std::string> paths( n_files );
+    std::vector<meftools::READ_WINDOW> windows( n_files * n_events );
+    Rcpp::List out( n_files );
+
+    for ( size_t c = 0; c < n_files; c++ ) {
+        paths[c] = Rcpp::as<std::string>( files(c) );
+        si4 err = channels[c].open( paths[c].c_str(), password.c_str() );
+        if ( err )
+            Rcpp::stop( paths[c] + ": " + meftools::error_string( err ) );
+        ui8 n_samples = channels[c].header().number_of_samples;
+
+        // epochs are filled in place: one column each of R's column-major matrix
+        Rcpp::IntegerMatrix epochs( (int) length, (int) n_events );
+        Rcpp::NumericVector starts( n_events );
+        for ( size_t i = 0; i < n_events; i++ ) {
+            ui8 s = channels[c].sample_of_time( (ui8) times[i] );
+            if ( s < (ui8) pre || s + post >= n_samples )
+                Rcpp::stop( paths[c] + ": epoch at " + std::to_string( (ui8) times[i] ) + " runs outside the file" );
+            meftools::READ_WINDOW &w = windows[c * n_events + i];
+            w.channel = &channels[c];
+            w.first_sample = s - pre;
+            w.last_sample = s + post;
+            w.out = (si4 *) &epochs[i * length];
+            starts[i] = (double) ( s - pre );
+        }
+        epochs.attr( "starts" ) = starts;
+        out[c] = epochs;
+    }
+
+    meftools::read_windows( windows, threads );
+    for ( size_t k = 0; k < windows.size(); k++ )
+        if ( windows[k].status )
+            Rcpp::stop( paths[k / n_events] + ": " + meftools::error_string( windows[k].status ) );
+
+    out.attr( "names" ) = files;
+    return out;
+}
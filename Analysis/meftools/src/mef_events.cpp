@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include <string>
+#include <vector>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_events.h"
+
+//' Read a Neuralynx event file (.nev) and return a handle to its events.
+//'
+//' All records are read in a few large reads into a table sorted by time, so nev_events() finds any
+//' time window, overall or for one event string, by binary search.
+//'
+//' Event times are Neuralynx timestamps plus an offset. To put them on the same time base as the MEF
+//' files Ncs2Mef2 wrote, pass the first .ncs file it converted: it adds that file's header start time to
+//' samples and events alike. Without an offset the .nev header's own start time is used, which is only
+//' approximate, since the event file is opened at a moment of its own.
+//'
+//' @param strings StringVector: filename, and optionally either the companion .ncs file or an offset
+//'   (a whole number of microseconds added to every timestamp).
+//' @return External pointer to the event table.
+//' @export
+// [[Rcpp::export]]
+SEXP nev_open( Rcpp::StringVector strings ) {
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    ui8 offset = 0;
+    if ( strings.size() > 1 ) {
+        std::string value = Rcpp::as<std::string>( strings(1) );
+        std::string suffix = value.size() > 4 ? value.substr( value.size() - 4 ) : "";
+        for ( size_t i = 0; i < suffix.size(); i++ )
+            suffix[i] = (char) tolower( (unsigned char) suffix[i] );
+        if ( suffix == ".ncs" ) {
+            si4 err = meftools::ncs_time_created( value.c_str(), &offset );
+            if ( err )
+                Rcpp::stop( value + ": " + ( err == meftools::MEF_ERR_FORMAT ? std::string( "no start time in the header" )
+                                                                               : meftools::error_string( err ) ) );
+        } else {
+            char *end = NULL;
+            errno = 0;
+            if ( !value.empty() && isdigit( (unsigned char) value[0] ) )
+                offset = strtoull( value.c_str(), &end, 10 );
+            if ( end == NULL || *end != 0 || errno )
+                Rcpp::stop( "offset must be a whole number of microseconds or an .ncs file: '" + value + "'" );
+        }
+    }
+
+    meftools::EventTable *table = new meftools::EventTable;
+    si4 err = table->read_nev( filename.c_str(), strings.size() > 1 ? &offset : NULL );
+    if ( err ) {
+        delete table;
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+    }
+    Rcpp::XPtr<meftools::EventTable> handle( table, true );
+    handle.attr("class") = "nev_handle";
+    return handle;
+}
+
+//' Events of a .nev file within a time window.
+//'
+//' @param handle Event handle from nev_open().
+//' @param start Window start (uUTC, inclusive); NA for the first event.
+//' @param stop Window end (uUTC, inclusive); NA for the last event.
+//' @param event Event string to keep (exact match); "" keeps every event.
+//' @return data.frame with one row per event in time order: time (uUTC), ttl, event_id and event.
+//' @export
+// [[Rcpp::export]]
+Rcpp::DataFrame nev_events( SEXP handle, double start = NA_REAL, double stop = NA_REAL, std::string event = "" ) {
+    if ( TYPEOF( handle ) != EXTPTRSXP || !Rf_inherits( handle, "nev_handle" ) || R_ExternalPtrAddr( handle ) == NULL )
+        Rcpp::stop( "handle must come from nev_open()" );
+    const meftools::EventTable *table = (const meftools::EventTable *) R_ExternalPtrAddr( handle );
+
+    ui8 t0 = ISNAN( start ) || start < 0 ? 0 : (ui8) start;
+    ui8 t1 = ISNAN( stop ) ? ~(ui8) 0 : stop < 0 ? 0 : (ui8) stop;
+    std::vector<size_t> rows;
+    if ( event.empty() ) {
+        size_t first, last;
+        table->range( t0, t1, &first, &last );
+        for ( size_t i = first; i < last; i++ )
+            rows.push_back( i );
+    } else {
+        si8 label = table->find_label( event );
+        if ( label >= 0 )
+            table->select( (ui4) label, t0, t1, rows );
+    }
+
+    Rcpp::NumericVector time( rows.size() );
+    Rcpp::IntegerVector ttl( rows.size() ), event_id( rows.size() );
+    Rcpp::CharacterVector text( rows.size() );
+    for ( size_t i = 0; i < rows.size(); i++ ) {
+        const meftools::NEV_EVENT &e = table->events()[rows[i]];
+        time[i] = (double) e.time;
+        ttl[i] = e.ttl;
+        event_id[i] = e.event_id;
+        text[i] = table->label( rows[i] );
+    }
+    return Rcpp::DataFrame::create( Rcpp::Named("time") = time,
+                                    Rcpp::Named("ttl") = ttl,
+                                    Rcpp::Named("event_id") = event_id,
+                                    Rcpp::Named("event") = text,
+                                    Rcpp::Named("stringsAsFactors") = false );
+}
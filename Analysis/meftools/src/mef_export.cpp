@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_export.h"
+
+//' Export MEF channels to an interleaved int16 flat binary (.dat) file.
+//'
+//' Writes the layout spike sorters expect: for each sample, one little-endian int16 per channel, in
+//' the order of 'files'. Channels are decoded in parallel a tile at a time and the file is written in
+//' large aligned chunks while the next tile decodes, so nothing channel-length is held in memory.
+//'
+//' Rows are aligned by time: every channel starts at its first sample at or after time0 (or after the
+//' latest channel start, when that is later) and contributes the same number of samples, the shortest
+//' channel's count up to time1. All channels must share a sampling frequency and, within the exported
+//' range, have their gaps at the same times; the flat layout cannot represent a gap in one channel only,
+//' so export the stretches between such gaps separately, with time0 and time1.
+//'
+//' @param files StringVector of .mef files, one per output channel.
+//' @param strings StringVector: output filename, password, and optionally time0, time1 (uUTC)
+//' @param saturate Clamp samples that do not fit 16 bits instead of failing.
+//' @param threads Number of worker threads; 0 uses one per core.
+//' @return data.frame with one row per channel: path, first_sample, samples and clipped (clamped samples).
+//' @export
+// [[Rcpp::export]]
+Rcpp::DataFrame mef_export_dat( Rcpp::StringVector files, Rcpp::StringVector strings, bool saturate, int threads ) {
+    std::string output = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+
+    size_t n_channels = files.size();
+    if ( n_channels == 0 )
+        Rcpp::stop( "no channels given" );
+
+    ui8 time0 = 0, time1 = (ui8) -1;
+    if ( strings.size() > 3 ) {
+        time0 = (ui8) atof( strings(2) );
+        time1 = (ui8) atof( strings(3) );
+    }
+
+    std::vector<meftools::MefChannel> channels( n_channels );
+    std::vector<meftools::EXPORT_CHANNEL> parts( n_channels );
+    std::vector<std::string> paths( n_channels );
+    ui8 n = (ui8) -1;
+    for ( size_t c = 0; c < n_channels; c++ ) {
+        paths[c] = Rcpp::as<std::string>( files(c) );
+        si4 err = channels[c].open( paths[c].c_str(), password.c_str() );
+        if ( err )
+            Rcpp::stop( paths[c] + ": " + meftools::error_string( err ) );
+        const Rcpp::MEF_HEADER_INFO &header = channels[c].header();
+        if ( channels[c].number_of_blocks() == 0 )
+            Rcpp::stop( paths[c] + ": no blocks" );
+        if ( fabs( header.sampling_frequency - channels[0].header().sampling_frequency ) > 1e-6 * header.sampling_frequency )
+            Rcpp::stop( paths[c] + ": sampling frequency differs from " + paths[0] );
+        // the first row is the first moment every channel has recorded
+        time0 = std::max( time0, channels[c].time_of_sample( 0 ) );
+    }
+    for ( size_t c = 0; c < n_channels; c++ ) {
+        const Rcpp::MEF_HEADER_INFO &header = channels[c].header();
+        ui8 s0 = channels[c].sample_of_time( time0 );
+        ui8 end = time1 == (ui8) -1 ? header.number_of_samples : channels[c].sample_of_time( time1 + 1 );
+        end = std::min( end, header.number_of_samples );
+        if ( s0 >= end )
+            Rcpp::stop( paths[c] + ": no samples in the requested time range" );
+        parts[c].channel = &channels[c];
+        parts[c].first_sample = s0;
+        parts[c].clipped = 0;
+        n = std::min( n, end - s0 );
+    }
+
+    si4 failed;
+    si4 err = meftools::export_interleaved_int16( parts, n, output.c_str(), saturate, threads, &failed );
+    if ( err == meftools::MEF_ERR_OVERFLOW )
+        Rcpp::stop( paths[failed] + ": samples exceed 16 bits; use saturate = TRUE to clamp them" );
+    if ( err == meftools::MEF_ERR_ALIGN )
+        Rcpp::stop( paths[failed] + ": gaps fall at different times than in " + paths[0] + "; export the stretches between them separately" );
+    if ( err )
+        Rcpp::stop( ( failed >= 0 ? paths[failed] : output ) + ": " + meftools::error_string( err ) );
+
+    Rcpp::CharacterVector path( n_channels );
+    Rcpp::NumericVector first_sample( n_channels ), samples( n_channels ), clipped( n_channels );
+    for ( size_t c = 0; c < n_channels; c++ ) {
+        path[c] = paths[c];
+        first_sample[c] = (sf8) parts[c].first_sample;
+        samples[c] = (sf8) n;
+        clipped[c] = (sf8) parts[c].clipped;
+    }
+    return Rcpp::DataFrame::create( Rcpp::Named("path") = path,
+                                    Rcpp::Named("first_sample") = first_sample,
+                                    Rcpp::Named("samples") = samples,
+                                    Rcpp::Named("clipped") = clipped,
+                                    Rcpp::Named("stringsAsFactors") = false );
+}
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_features.h"
+
+//' Compute per-window features over a MEF channel.
+//'
+//' Each contiguous segment is tiled with windows of 'window' seconds every 'hop' seconds; windows never
+//' cross a discontinuity. The channel is read front to back once (see meftools_scan.h), and the windows
+//' of each decoded piece are evaluated in parallel while the next piece decodes.
+//'
+//' @param strings StringVector: filename, password, and optionally time0, time1 (uUTC)
+//' @param window Window length in seconds.
+//' @param hop Seconds between window starts.
+//' @param features StringVector of kernels: line_length, rms, mean, min, max, zero_crossings, band_power.
+//'   rms and zero_crossings are taken about the window mean. Values are in raw sample units.
+//' @param bands Matrix of band edges in Hz (low, high), one row per band; each "band_power" entry
+//'   uses the next row.
+//' @param threads Number of worker threads; 0 uses one per core.
+//' @return data.frame with the window start time (uUTC) and sample number, then one column per feature.
+//' @export
+// [[Rcpp::export]]
+Rcpp::DataFrame mef_features( Rcpp::StringVector strings, double window, double hop, Rcpp::StringVector features,
+                              Rcpp::NumericMatrix bands, int threads ) {
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+
+    meftools::MefChannel channel;
+    si4 err = channel.open( filename.c_str(), password.c_str() );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+
+    const sf8 fs = channel.header().sampling_frequency;
+    size_t window_samples = (size_t) floor( window * fs + 0.5 );
+    size_t hop_samples = (size_t) floor( hop * fs + 0.5 );
+    if ( window_samples < 2 || hop_samples < 1 )
+        Rcpp::stop( "window must span at least two samples and hop at least one" );
+
+    std::vector<meftools::FEATURE> kernels;
+    std::vector<std::string> names;
+    int band = 0;
+    for ( size_t i = 0; i < (size_t) features.size(); i++ ) {
+        std::string name = Rcpp::as<std::string>( features(i) );
+        meftools::FEATURE f = { meftools::feature_kind( name ), 0.0, 0.0 };
+        if ( f.kind < 0 )
+            Rcpp::stop( "unknown feature: " + name );
+        if ( f.kind == meftools::FEATURE_BAND_POWER ) {
+            if ( bands.ncol() != 2 || band >= bands.nrow() )
+                Rcpp::stop( "each band_power needs a row (low, high) in bands" );
+            f.low = bands( band, 0 );
+            f.high = bands( band, 1 );
+            band++;
+            char label[64];
+            snprintf( label, sizeof(label), "band_power_%g_%g", f.low, f.high );
+            name = label;
+        }
+        kernels.push_back( f );
+        names.push_back( name );
+    }
+
+    ui8 time0 = 0, time1 = (ui8) -1;
+    if ( strings.size() > 3 ) {
+        time0 = (ui8) atof( strings(2) );
+        time1 = (ui8) atof( strings(3) );
+    }
+
+    std::vector<meftools::MEF_SEGMENT> all = channel.segments( time0, time1 );
+    std::vector<ui8> first, last;
+    for ( size_t i = 0; i < all.size(); i++ ) {
+        ui8 s0, s1;
+        if ( channel.clip_segment( all[i], time0, time1, &s0, &s1 ) ) {
+            first.push_back( s0 );
+            last.push_back( s1 );
+        }
+    }
+
+    std::vector<ui8> starts;
+    std::vector<sf8> values;
+    err = meftools::features_scan( channel, first, last, window_samples, hop_samples, kernels, threads, starts, values );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+
+    size_t n = starts.size(), n_features = kernels.size();
+    Rcpp::NumericVector time( n ), sample( n );
+    std::vector<Rcpp::NumericVector> columns;
+    for ( size_t f = 0; f < n_features; f++ )
+        columns.push_back( Rcpp::NumericVector( n ) );
+    for ( size_t k = 0; k < n; k++ ) {
+        time[k] = (sf8) channel.time_of_sample( starts[k] );
+        sample[k] = (sf8) starts[k];
+        for ( size_t f = 0; f < n_features; f++ )
+            columns[f][k] = values[k * n_features + f];
+    }
+
+    Rcpp::List out( n_features + 2 );
+    Rcpp::CharacterVector column_names( n_features + 2 );
+    out[0] = time; column_names[0] = "time";
+    out[1] = sample; column_names[1] = "sample";
+    for ( size_t f = 0; f < n_features; f++ ) {
+        out[f + 2] = columns[f];
+        column_names[f + 2] = names[f];
+    }
+    out.attr("names") = column_names;
+    return Rcpp::DataFrame( out );
+}
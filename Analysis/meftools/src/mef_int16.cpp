@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+
+//' Decode a sample range of a MEF channel as 16-bit integers.
+//'
+//' NCS-derived channels hold 16-bit ADC values, so two bytes per sample suffice. R has no 16-bit
+//' integer type, so the samples come back packed in a raw vector (little-endian int16, two bytes per
+//' sample), ready for writeBin() or for readBin(x, "integer", size = 2, n = length(x) / 2).
+//'
+//' Without saturate, the RED block headers covering the range must show that every sample fits in
+//' 16 bits, and an error is raised otherwise. With saturate, out-of-range samples are clamped to
+//' -32768 / 32767 and counted.
+//'
+//' @param strings StringVector: filename, password, s0, s1 (sample numbers, zero-based, inclusive)
+//' @param saturate Clamp samples that do not fit instead of failing.
+//' @return Raw vector of 2 * (s1 - s0 + 1) bytes, with attribute 'clipped' (the number of clamped samples).
+//' @export
+// [[Rcpp::export]]
+Rcpp::RawVector mef_int16( Rcpp::StringVector strings, bool saturate = false ) {
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+
+    if ( strings.size() < 4 )
+        Rcpp::stop( "strings must hold filename, password, s0 and s1" );
+    ui8 s0 = (ui8) atof( strings(2) );
+    ui8 s1 = (ui8) atof( strings(3) );
+
+    meftools::MefChannel channel;
+    si4 err = channel.open( filename.c_str(), password.c_str() );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+    if ( s0 > s1 || s1 >= channel.header().number_of_samples )
+        Rcpp::stop( filename + ": " + meftools::error_string( meftools::MEF_ERR_RANGE ) );
+
+    // the core only runs on little-endian hosts, so native int16 is the packed layout
+    Rcpp::RawVector out( Rcpp::no_init( 2 * ( s1 - s0 + 1 ) ) );
+    ui8 clipped = 0;
+    err = channel.read_int16( s0, s1, (si2 *) out.begin(), saturate, &clipped );
+    if ( err == meftools::MEF_ERR_OVERFLOW )
+        Rcpp::stop( filename + ": samples exceed 16 bits; use saturate = TRUE to clamp them" );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+    out.attr("clipped") = (sf8) clipped;
+    return out;
+}
@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+
+//' Decode a sample range of a MEF channel directly to microvolts.
+//'
+//' Samples are multiplied by the header's voltage_conversion_factor inside the decode loop, a batch
+//' of blocks at a time, so the raw integers are never materialised as a separate vector. R has no
+//' single-precision type, so values come back as doubles; native callers of the core library can
+//' decode to float32 instead.
+//'
+//' @param strings StringVector: filename, password, s0, s1 (sample numbers, zero-based, inclusive)
+//' @return A new numeric vector of s1 - s0 + 1 samples in microvolts.
+//' @export
+// [[Rcpp::export]]
+Rcpp::NumericVector mef_microvolts( Rcpp::StringVector strings ) {
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+
+    if ( strings.size() < 4 )
+        Rcpp::stop( "strings must hold filename, password, s0 and s1" );
+    ui8 s0 = (ui8) atof( strings(2) );
+    ui8 s1 = (ui8) atof( strings(3) );
+
+    meftools::MefChannel channel;
+    si4 err = channel.open( filename.c_str(), password.c_str() );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+    if ( s0 > s1 || s1 >= channel.header().number_of_samples )
+        Rcpp::stop( filename + ": " + meftools::error_string( meftools::MEF_ERR_RANGE ) );
+
+    Rcpp::NumericVector out( Rcpp::no_init( (R_xlen_t) ( s1 - s0 + 1 ) ) );
+    err = channel.read_microvolts( s0, s1, out.begin() );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+    return out;
+}
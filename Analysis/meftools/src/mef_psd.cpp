@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_dsp.h"
+#include "../inst/include/meftools_parallel.h"
+
+//' Welch power spectral density per output interval.
+//'
+//' The requested time range is divided into intervals of 'interval' seconds. Within each interval, every
+//' contiguous run of data is streamed through Hann-windowed segments, so no segment straddles a
+//' discontinuity or an interval boundary, and the segment spectra are averaged. Intervals are
+//' processed in parallel; each worker holds one segment of samples and one FFT buffer, and each
+//' interval only its running sum of spectra.
+//'
+//' @param strings StringVector: filename, password, and optionally time0, time1 (uUTC)
+//' @param interval Output interval in seconds (e.g. 3600 for hourly spectra).
+//' @param segment Welch segment length in seconds; zero-padded to a power of two for the FFT.
+//' @param overlap Fraction of a segment shared with the next one, in [0, 1).
+//' @param threads Number of worker threads; 0 uses one per core.
+//' @return List with 'time' (interval starts, uUTC), 'frequency' (Hz), 'psd' (intervals x frequencies,
+//'   raw units^2 / Hz; NaN where an interval held no complete segment) and 'segments' (segments
+//'   averaged per interval).
+//' @export
+// [[Rcpp::export]]
+Rcpp::List mef_psd( Rcpp::StringVector strings, double interval, double segment, double overlap, int threads ) {
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+
+    meftools::MefChannel channel;
+    si4 err = channel.open( filename.c_str(), password.c_str() );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+    if ( channel.number_of_blocks() == 0 )
+        Rcpp::stop( filename + ": no blocks" );
+    if ( interval <= 0 || segment <= 0 || overlap < 0 || overlap >= 1 )
+        Rcpp::stop( "invalid interval, segment or overlap" );
+
+    const sf8 fs = channel.header().sampling_frequency;
+    size_t length = (size_t) floor( segment * fs + 0.5 );
+    size_t hop = std::max( (size_t) 1, (size_t) floor( length * ( 1.0 - overlap ) + 0.5 ) );
+    if ( length < 2 )
+        Rcpp::stop( "segment must span at least two samples" );
+
+    std::vector<meftools::MEF_SEGMENT> all = channel.segments();
+    ui8 time0 = all.front().start_time, time1 = all.back().end_time - 1;
+    if ( strings.size() > 3 ) {
+        time0 = std::max( time0, (ui8) atof( strings(2) ) );
+        time1 = std::min( time1, (ui8) atof( strings(3) ) );
+    }
+    if ( time1 < time0 )
+        Rcpp::stop( "empty time range" );
+
+    const ui8 interval_us = (ui8) floor( interval * 1000000.0 + 0.5 );
+    size_t n_intervals = (size_t) ( ( time1 - time0 ) / interval_us + 1 );
+
+    // one window and FFT scratch per worker; each interval keeps only its running sum
+    unsigned n_workers = meftools::worker_count( n_intervals, threads );
+    std::vector<meftools::WelchEstimator> estimators( n_workers, meftools::WelchEstimator( length, hop, fs ) );
+    std::vector<meftools::WelchSum> sums( n_intervals );
+    std::vector<si4> results( n_intervals, meftools::MEF_OK );
+    meftools::parallel_for_worker( n_intervals, (int) n_workers, [&]( unsigned w, size_t i ) {
+        ui8 t0 = time0 + i * interval_us;
+        ui8 t1 = std::min( t0 + interval_us - 1, time1 );
+        for ( size_t s = 0; s < all.size() && results[i] == meftools::MEF_OK; s++ ) {
+            ui8 s0, s1;
+            if ( channel.clip_segment( all[s], t0, t1, &s0, &s1 ) )
+                results[i] = estimators[w].add_range( channel, s0, s1, sums[i] );
+        }
+    } );
+
+    const meftools::WelchEstimator &welch = estimators[0];
+    size_t bins = welch.bins();
+    Rcpp::NumericVector time( n_intervals ), frequency( bins ), counts( n_intervals );
+    Rcpp::NumericMatrix psd( n_intervals, bins );
+    std::vector<sf8> row( bins );
+    for ( size_t k = 0; k < bins; k++ )
+        frequency[k] = welch.frequency( k );
+    for ( size_t i = 0; i < n_intervals; i++ ) {
+        if ( results[i] )
+            Rcpp::stop( filename + ": " + meftools::error_string( results[i] ) );
+        time[i] = (sf8) ( time0 + i * interval_us );
+        counts[i] = (sf8) sums[i].count;
+        welch.psd( sums[i], &row[0] );
+        std::vector<sf8>().swap( sums[i].sum );
+        for ( size_t k = 0; k < bins; k++ )
+            psd( i, k ) = row[k];
+    }
+
+    return Rcpp::List::create( Rcpp::Named("time") = time,
+                               Rcpp::Named("frequency") = frequency,
+                               Rcpp::Named("psd") = psd,
+                               Rcpp::Named("segments") = counts );
+}
@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_parallel.h"
+#include "../inst/include/meftools_scan.h"
+
+//
+//  Overview pyramid: min/max/mean of a channel at several decimated rates, stored in a small file next
+//  to the .mef so that viewers never have to decode full-rate data just to draw a zoomed-out trace.
+//
+//  Layout (little-endian):
+//    PYRAMID_HEADER
+//    PYRAMID_LEVEL   x number_of_levels      (finest first)
+//    PYRAMID_SEGMENT x number_of_segments    (contiguous runs, in time order)
+//    for each level: PYRAMID_BIN records, segment after segment
+//
+//  Bins restart at every segment, so no bin straddles a discontinuity, and every segment's position in a
+//  level is known before any data are decoded. Bins are therefore written straight into place as one
+//  sequential scan of the channel (meftools_scan.h) fills them.
+//
+
+#define PYRAMID_MAGIC             "MEFPYR01"
+#define PYRAMID_CHUNK_BYTES       (1 << 20)   // bins buffered per level between writes
+
+namespace {
+
+  typedef struct {
+    si1 magic[8];
+    ui4 number_of_levels;
+    ui4 number_of_segments;
+    sf8 sampling_frequency;
+    ui8 number_of_samples;
+    ui1 file_unique_ID[FILE_UNIQUE_ID_LENGTH];
+  } PYRAMID_HEADER;
+
+  typedef struct {
+    ui8 factor;         // samples per bin
+    ui8 number_of_bins;
+    ui8 data_offset;
+  } PYRAMID_LEVEL;
+
+  typedef struct {
+    ui8 start_time;
+    ui8 first_sample;
+    ui8 number_of_samples;
+  } PYRAMID_SEGMENT;
+
+  typedef struct {
+    si4 min;
+    si4 max;
+    sf4 mean;
+  } PYRAMID_BIN;
+
+  inline ui8 bins_in(ui8 samples, ui8 factor)
+  {
+    return (samples + factor - 1) / factor;
+  }
+
+  // Running reduction of one level; completed bins are buffered and written in large pieces.
+  struct LevelAccumulator {
+    ui8 factor;
+    ui8 count;
+    si4 min, max;
+    sf8 sum;
+    std::vector<PYRAMID_BIN> out;
+    off_t offset;
+
+    void add(si4 v) {
+      if (count == 0 || v < min) min = v;
+      if (count == 0 || v > max) max = v;
+      sum += v;
+      if (++count == factor) close_bin();
+    }
+    void close_bin() {
+      if (count == 0) return;
+      PYRAMID_BIN bin = { min, max, (sf4) (sum / (sf8) count) };
+      out.push_back(bin);
+      count = 0; sum = 0.0;
+    }
+    si4 flush(int fd) {
+      size_t bytes = out.size() * sizeof(PYRAMID_BIN);
+      if (bytes == 0) return meftools::MEF_OK;
+      ssize_t n = pwrite(fd, &out[0], bytes, offset);
+      if (n < 0 || (size_t) n != bytes) return meftools::MEF_ERR_WRITE;
+      offset += bytes;
+      out.clear();
+      return meftools::MEF_OK;
+    }
+  };
+
+  // Reduce every segment to every level in one front-to-back scan of the channel. Bins restart at each
+  // segment and go straight to that segment's place in each level. The levels are independent, so each
+  // batch is reduced to all of them side by side while the scan decodes the next one.
+  si4 build_levels(const meftools::MefChannel &channel, const std::vector<meftools::MEF_SEGMENT> &segments,
+                   const std::vector<PYRAMID_LEVEL> &levels, const std::vector< std::vector<ui8> > &bin_offsets,
+                   int fd, int threads)
+  {
+    std::vector<LevelAccumulator> acc(levels.size());
+    std::vector<size_t> segment(levels.size(), 0);  // each level's current segment
+    std::vector<si4> result(levels.size());
+    meftools::SCAN_OPTIONS options;
+    si4 err;
+
+    auto start_segment = [&](size_t l) {
+      acc[l].factor = levels[l].factor;
+      acc[l].count = 0; acc[l].sum = 0.0; acc[l].min = acc[l].max = 0;
+      acc[l].offset = (off_t) (levels[l].data_offset + bin_offsets[segment[l]][l] * sizeof(PYRAMID_BIN));
+    };
+    auto reduce = [&](size_t l, const meftools::SCAN_BATCH &batch) -> si4 {
+      si4 e;
+      for (ui8 b = batch.first_block; b <= batch.last_block; b++) {
+        if (batch.status[b - batch.first_block])
+          return batch.status[b - batch.first_block];
+        if (b > segments[segment[l]].last_block) {
+          acc[l].close_bin();
+          if ((e = acc[l].flush(fd)))
+            return e;
+          segment[l]++;
+          start_segment(l);
+        }
+        const si4 *samples = batch.samples + (channel.index()[b].sample_number - batch.first_sample);
+        ui8 n = channel.block_samples(b);
+        for (ui8 i = 0; i < n; i++)
+          acc[l].add(samples[i]);
+        if (acc[l].out.size() * sizeof(PYRAMID_BIN) >= PYRAMID_CHUNK_BYTES && (e = acc[l].flush(fd)))
+          return e;
+      }
+      return meftools::MEF_OK;
+    };
+
+    for (size_t l = 0; l < levels.size(); l++)
+      start_segment(l);
+    options.threads = threads;
+    err = meftools::scan_channel(channel, 0, channel.number_of_blocks() - 1, options, [&](const meftools::SCAN_BATCH &batch) -> si4 {
+      meftools::parallel_for(acc.size(), threads, [&](size_t l) { result[l] = reduce(l, batch); });
+      for (size_t l = 0; l < result.size(); l++)
+        if (result[l])
+          return result[l];
+      return meftools::MEF_OK;
+    });
+    for (size_t l = 0; l < acc.size() && !err; l++) {
+      acc[l].close_bin();
+      err = acc[l].flush(fd);
+    }
+    return err;
+  }
+
+  std::string pyramid_name(const std::string &mef_name)
+  {
+    size_t len = mef_name.size();
+    if (len > 4 && mef_name.compare(len - 4, 4, ".mef") == 0)
+      return mef_name.substr(0, len - 4) + ".pyr";
+    return mef_name + ".pyr";
+  }
+
+}
+
+//' Build a min/max/mean overview pyramid next to a MEF file.
+//'
+//' The channel is read front to back once, with large sequential reads that do not stay in the page
+//' cache, decoded on a pool of threads and reduced to every level in the same pass (the levels side by
+//' side, while the next piece decodes). Pyramid data are written unencrypted.
+//'
+//' @param strings StringVector: filename, password, and optionally the pyramid filename (default: the
+//'   .mef name with a .pyr extension)
+//' @param rates NumericVector: level rates in Hz; rates at or above the sampling frequency are skipped.
+//' @param threads Number of worker threads; 0 uses one per core.
+//' @return The pyramid filename.
+//' @export
+// [[Rcpp::export]]
+std::string build_mef_pyramid( Rcpp::StringVector strings, Rcpp::NumericVector rates, int threads ) {
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+    std::string output = strings.size() > 2 ? Rcpp::as<std::string>( strings(2) ) : pyramid_name( filename );
+
+    meftools::MefChannel channel;
+    si4 err = channel.open( filename.c_str(), password.c_str() );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+
+    const Rcpp::MEF_HEADER_INFO &h = channel.header();
+    std::vector<meftools::MEF_SEGMENT> segments = channel.segments();
+
+    // levels, finest first
+    std::vector<ui8> factors;
+    for ( size_t i = 0; i < (size_t) rates.size(); i++ ) {
+        if ( rates[i] <= 0 || rates[i] >= h.sampling_frequency )
+            continue;
+        factors.push_back( (ui8) floor( h.sampling_frequency / rates[i] + 0.5 ) );
+    }
+    std::sort( factors.begin(), factors.end() );
+    factors.erase( std::unique( factors.begin(), factors.end() ), factors.end() );
+    if ( factors.empty() )
+        Rcpp::stop( "no pyramid level below the sampling frequency" );
+
+    PYRAMID_HEADER header;
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, PYRAMID_MAGIC, 8 );
+    header.number_of_levels = factors.size();
+    header.number_of_segments = segments.size();
+    header.sampling_frequency = h.sampling_frequency;
+    header.number_of_samples = h.number_of_samples;
+    memcpy( header.file_unique_ID, h.file_unique_ID, FILE_UNIQUE_ID_LENGTH );
+
+    std::vector<PYRAMID_SEGMENT> seg_table( segments.size() );
+    for ( size_t s = 0; s < segments.size(); s++ ) {
+        seg_table[s].start_time = segments[s].start_time;
+        seg_table[s].first_sample = segments[s].first_sample;
+        seg_table[s].number_of_samples = segments[s].last_sample - segments[s].first_sample + 1;
+    }
+
+    // bin_offsets[s][l]: first bin of segment s within level l
+    std::vector<PYRAMID_LEVEL> levels( factors.size() );
+    std::vector< std::vector<ui8> > bin_offsets( segments.size(), std::vector<ui8>( factors.size() ) );
+    ui8 offset = sizeof(PYRAMID_HEADER) + levels.size() * sizeof(PYRAMID_LEVEL) + seg_table.size() * sizeof(PYRAMID_SEGMENT);
+    for ( size_t l = 0; l < levels.size(); l++ ) {
+        levels[l].factor = factors[l];
+        levels[l].number_of_bins = 0;
+        levels[l].data_offset = offset;
+        for ( size_t s = 0; s < seg_table.size(); s++ ) {
+            bin_offsets[s][l] = levels[l].number_of_bins;
+            levels[l].number_of_bins += bins_in( seg_table[s].number_of_samples, factors[l] );
+        }
+        offset += levels[l].number_of_bins * sizeof(PYRAMID_BIN);
+    }
+
+    int fd = open( output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if ( fd < 0 )
+        Rcpp::stop( output + ": could not open for writing" );
+    bool ok = pwrite( fd, &header, sizeof(header), 0 ) == (ssize_t) sizeof(header)
+        && pwrite( fd, &levels[0], levels.size() * sizeof(PYRAMID_LEVEL), sizeof(header) ) == (ssize_t) ( levels.size() * sizeof(PYRAMID_LEVEL) );
+    if ( ok && !seg_table.empty() )
+        ok = pwrite( fd, &seg_table[0], seg_table.size() * sizeof(PYRAMID_SEGMENT), sizeof(header) + levels.size() * sizeof(PYRAMID_LEVEL) )
+            == (ssize_t) ( seg_table.size() * sizeof(PYRAMID_SEGMENT) );
+
+    if ( ok && !segments.empty() )
+        err = build_levels( channel, segments, levels, bin_offsets, fd, threads );
+    close( fd );
+
+    if ( !ok || err ) {
+        unlink( output.c_str() );
+        Rcpp::stop( output + ": " + ( ok ? meftools::error_string( err ) : "write error" ) );
+    }
+    return output;
+}
+
+//' Read the overview of a time range at the coarsest pyramid level that still gives at least 'pixels'
+//' bins (or the finest level, if none does).
+//'
+//' The pyramid must have been built from this MEF file: its recorded file_unique_ID and sample count are
+//' checked against the MEF header, so a pyramid left over from an older or different recording is refused.
+//'
+//' @param strings StringVector: MEF filename, password, and optionally the pyramid filename ("" or
+//'   omitted: the .mef name with a .pyr extension) and time0, time1 (uUTC)
+//' @param pixels Number of horizontal pixels (bins) wanted.
+//' @return data.frame with time, min, max and mean; the "factor" attribute gives samples per bin.
+//' @export
+// [[Rcpp::export]]
+Rcpp::DataFrame read_mef_pyramid( Rcpp::StringVector strings, int pixels ) {
+    std::string mef_name = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+    std::string filename = strings.size() > 2 ? Rcpp::as<std::string>( strings(2) ) : "";
+    if ( filename.empty() )
+        filename = pyramid_name( mef_name );
+
+    Rcpp::MEF_HEADER_INFO h;
+    memset( &h, 0, sizeof(h) );
+    si4 err = meftools::read_header( mef_name.c_str(), password.c_str(), &h );
+    if ( err )
+        Rcpp::stop( mef_name + ": " + meftools::error_string( err ) );
+
+    int fd = open( filename.c_str(), O_RDONLY );
+    if ( fd < 0 )
+        Rcpp::stop( filename + ": could not open" );
+
+    PYRAMID_HEADER header;
+    std::vector<PYRAMID_LEVEL> levels;
+    std::vector<PYRAMID_SEGMENT> segments;
+    bool ok = pread( fd, &header, sizeof(header), 0 ) == (ssize_t) sizeof(header)
+        && memcmp( header.magic, PYRAMID_MAGIC, 8 ) == 0 && header.number_of_levels > 0;
+    if ( ok ) {
+        levels.resize( header.number_of_levels );
+        segments.resize( header.number_of_segments );
+        ok = pread( fd, &levels[0], levels.size() * sizeof(PYRAMID_LEVEL), sizeof(header) ) == (ssize_t) ( levels.size() * sizeof(PYRAMID_LEVEL) );
+        if ( ok && !segments.empty() )
+            ok = pread( fd, &segments[0], segments.size() * sizeof(PYRAMID_SEGMENT), sizeof(header) + levels.size() * sizeof(PYRAMID_LEVEL) )
+                == (ssize_t) ( segments.size() * sizeof(PYRAMID_SEGMENT) );
+    }
+    if ( !ok ) {
+        close( fd );
+        Rcpp::stop( filename + ": not a MEF pyramid" );
+    }
+    if ( header.number_of_samples != h.number_of_samples || memcmp( header.file_unique_ID, h.file_unique_ID, FILE_UNIQUE_ID_LENGTH ) != 0 ) {
+        close( fd );
+        Rcpp::stop( filename + ": not a pyramid of " + mef_name + " (rebuild it with build_mef_pyramid)" );
+    }
+
+    const sf8 us_per_sample = 1000000.0 / header.sampling_frequency;
+    ui8 time0 = 0, time1 = (ui8) -1;
+    if ( strings.size() > 4 ) {
+        time0 = (ui8) atof( strings(3) );
+        time1 = (ui8) atof( strings(4) );
+    }
+    if ( time1 < time0 ) {
+        close( fd );
+        Rcpp::stop( filename + ": time1 precedes time0" );
+    }
+
+    // samples inside the window decide the level
+    sf8 wanted = 0;
+    for ( size_t s = 0; s < segments.size(); s++ ) {
+        sf8 t0 = std::max( (sf8) time0, (sf8) segments[s].start_time );
+        sf8 t1 = std::min( (sf8) time1, segments[s].start_time + segments[s].number_of_samples * us_per_sample );
+        if ( t1 > t0 )
+            wanted += ( t1 - t0 ) / us_per_sample;
+    }
+    size_t level = 0;
+    for ( size_t l = 1; l < levels.size(); l++ )
+        if ( wanted / levels[l].factor >= pixels )
+            level = l;
+    const PYRAMID_LEVEL &lv = levels[level];
+
+    std::vector<sf8> time, minimum, maximum, mean;
+    std::vector<PYRAMID_BIN> bins;
+    ui8 first_bin = 0;
+    for ( size_t s = 0; s < segments.size(); s++ ) {
+        const PYRAMID_SEGMENT &seg = segments[s];
+        ui8 n_bins = bins_in( seg.number_of_samples, lv.factor );
+        sf8 us_per_bin = lv.factor * us_per_sample;
+        sf8 seg_end = seg.start_time + seg.number_of_samples * us_per_sample;
+        if ( seg_end > time0 && seg.start_time <= time1 ) {
+            ui8 i0 = time0 > seg.start_time ? (ui8) ( ( time0 - seg.start_time ) / us_per_bin ) : 0;
+            ui8 i1 = (sf8) time1 < seg_end ? (ui8) ( ( time1 - seg.start_time ) / us_per_bin ) : n_bins - 1;
+            i1 = std::min( i1, n_bins - 1 );
+            bins.resize( i1 - i0 + 1 );
+            size_t bytes = bins.size() * sizeof(PYRAMID_BIN);
+            if ( pread( fd, &bins[0], bytes, (off_t) ( lv.data_offset + ( first_bin + i0 ) * sizeof(PYRAMID_BIN) ) ) != (ssize_t) bytes ) {
+                close( fd );
+                Rcpp::stop( filename + ": read error" );
+            }
+            for ( ui8 i = i0; i <= i1; i++ ) {
+                time.push_back( floor( seg.start_time + i * us_per_bin + 0.5 ) );
+                minimum.push_back( bins[i - i0].min );
+                maximum.push_back( bins[i - i0].max );
+                mean.push_back( bins[i - i0].mean );
+            }
+        }
+        first_bin += n_bins;
+    }
+    close( fd );
+
+    Rcpp::DataFrame result = Rcpp::DataFrame::create( Rcpp::Named("time") = Rcpp::NumericVector( time.begin(), time.end() ),
+                                                      Rcpp::Named("min") = Rcpp::NumericVector( minimum.begin(), minimum.end() ),
+                                                      Rcpp::Named("max") = Rcpp::NumericVector( maximum.begin(), maximum.end() ),
+                                                      Rcpp::Named("mean") = Rcpp::NumericVector( mean.begin(), mean.end() ) );
+    result.attr("factor") = (sf8) lv.factor;
+    return result;
+}
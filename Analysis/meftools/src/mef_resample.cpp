@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_dsp.h"
+#include "../inst/include/meftools_parallel.h"
+
+//
+//  Decimation / rational resampling inside the reader: samples go from the decoder straight into the
+//  polyphase filter, so only the reduced-rate output is ever held in full.
+//
+
+#define RESAMPLE_STREAM_SAMPLES (1 << 16)
+#define RESAMPLE_CHUNK_SAMPLES  (1 << 22)   // input samples per parallel task
+
+namespace {
+
+  // Keeps outputs [m0, m1) of a chunk's resampler, whose output 0 is segment output 'offset', at their
+  // place in the segment's output.
+  class ChunkSink : public meftools::FilteredSink {
+  public:
+    ChunkSink(sf8 *out, ui8 offset, ui8 m0, ui8 m1) : out_(out), offset_(offset), m0_(m0), m1_(m1) {}
+    void write(ui8 first, const sf8 *y, size_t n) {
+      for (size_t k = 0; k < n; k++) {
+        ui8 m = offset_ + first + k;
+        if (m >= m0_ && m < m1_)
+          out_[m] = y[k];
+      }
+    }
+  private:
+    sf8 *out_;
+    ui8 offset_, m0_, m1_;
+  };
+
+  typedef struct {
+    size_t segment;
+    ui8 n0, n1;         // inputs of the segment (from 0) whose outputs the chunk produces: [n0, n1)
+  } RESAMPLE_CHUNK;
+
+}
+
+//' Decode a MEF channel at a reduced (or changed) sampling rate.
+//'
+//' Each contiguous segment is passed through an anti-aliased polyphase resampler by the rational
+//' factor up / down (e.g. up = 1, down = 16 for 32 kHz to 2 kHz); filter state runs across block
+//' boundaries but never across a discontinuity. Long segments are split into chunks resampled in
+//' parallel; each chunk starts on a multiple of down and reads the filter's reach of input on both
+//' sides, so the output is the same as resampling the whole segment at once.
+//'
+//' @param strings StringVector: filename, password, and optionally time0, time1 (uUTC)
+//' @param up Interpolation factor.
+//' @param down Decimation factor.
+//' @param threads Number of worker threads; 0 uses one per core.
+//' @return List with one numeric vector per contiguous segment, in raw sample units, each carrying
+//'   attributes t0, t1 (uUTC of its first and last output sample), sampling_frequency (the output rate)
+//'   and s0, s1 (the input samples it spans).
+//' @export
+// [[Rcpp::export]]
+Rcpp::List mef_resample( Rcpp::StringVector strings, int up, int down, int threads ) {
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+
+    if ( up < 1 || down < 1 )
+        Rcpp::stop( "up and down must be positive integers" );
+
+    meftools::MefChannel channel;
+    si4 err = channel.open( filename.c_str(), password.c_str() );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+
+    ui8 time0 = 0, time1 = (ui8) -1;
+    if ( strings.size() > 3 ) {
+        time0 = (ui8) atof( strings(2) );
+        time1 = (ui8) atof( strings(3) );
+    }
+
+    std::vector<meftools::MEF_SEGMENT> all = channel.segments( time0, time1 );
+    std::vector<ui8> first, last;
+    for ( size_t i = 0; i < all.size(); i++ ) {
+        ui8 s0, s1;
+        if ( channel.clip_segment( all[i], time0, time1, &s0, &s1 ) ) {
+            first.push_back( s0 );
+            last.push_back( s1 );
+        }
+    }
+
+    // chunks of whole multiples of down, so that every chunk's outputs fall on the segment's output grid
+    ChunkSink unused( NULL, 0, 0, 0 );
+    meftools::PolyphaseResampler shape( up, down, unused );
+    ui8 r_up = shape.up(), r_down = shape.down();
+    ui8 reach = ( shape.reach() + r_down - 1 ) / r_down * r_down;
+    ui8 chunk = std::max( r_down, (ui8) RESAMPLE_CHUNK_SAMPLES / r_down * r_down );
+    std::vector<RESAMPLE_CHUNK> chunks;
+    std::vector< std::vector<sf8> > resampled( first.size() );
+    for ( size_t i = 0; i < first.size(); i++ ) {
+        ui8 n = last[i] - first[i] + 1;
+        resampled[i].resize( ( n * r_up + r_down - 1 ) / r_down );
+        for ( ui8 n0 = 0; n0 < n; n0 += chunk ) {
+            RESAMPLE_CHUNK c = { i, n0, std::min( n, n0 + chunk ) };
+            chunks.push_back( c );
+        }
+    }
+
+    std::vector<si4> results( chunks.size(), meftools::MEF_OK );
+    meftools::parallel_for( chunks.size(), threads, [&]( size_t j ) {
+        const RESAMPLE_CHUNK &c = chunks[j];
+        ui8 n = last[c.segment] - first[c.segment] + 1;
+        ui8 a = c.n0 > reach ? c.n0 - reach : 0, b = std::min( n, c.n1 + reach );
+        ChunkSink sink( &resampled[c.segment][0], a / r_down * r_up, c.n0 / r_down * r_up,
+                        c.n1 == n ? resampled[c.segment].size() : c.n1 / r_down * r_up );
+        meftools::PolyphaseResampler resampler( up, down, sink );
+        results[j] = meftools::stream_segment( channel, first[c.segment] + a, first[c.segment] + b - 1, RESAMPLE_STREAM_SAMPLES, resampler );
+        if ( b == n )
+            resampler.finish();
+    } );
+    for ( size_t j = 0; j < chunks.size(); j++ )
+        if ( results[j] )
+            Rcpp::stop( filename + ": " + meftools::error_string( results[j] ) );
+
+    // output m of a segment lies at input position m * down / up
+    const sf8 fs = channel.header().sampling_frequency;
+    const sf8 step = 1000000.0 * down / ( (sf8) up * fs );
+
+    Rcpp::List out( first.size() );
+    for ( size_t i = 0; i < first.size(); i++ ) {
+        Rcpp::NumericVector y( resampled[i].begin(), resampled[i].end() );
+        std::vector<sf8>().swap( resampled[i] );
+        sf8 t0 = (sf8) channel.time_of_sample( first[i] );
+        y.attr("t0") = t0;
+        y.attr("t1") = y.size() > 0 ? floor( t0 + ( y.size() - 1 ) * step + 0.5 ) : t0;
+        y.attr("sampling_frequency") = fs * up / (sf8) down;
+        y.attr("s0") = (sf8) first[i];
+        y.attr("s1") = (sf8) last[i];
+        out[i] = y;
+    }
+    return out;
+}
@@ -0,0 +1,48 @@
+#include <string>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_shared_cache.h"
+
+//' Share decoded blocks between R processes on this node.
+//'
+//' Attaches this process to a decoded-block cache kept in shared memory (/dev/shm/<name>). From then on
+//' every read (decomp_mef, mef_open, mef_int16, ...) takes blocks from it where it can and publishes
+//' the blocks it decodes, so workers forked by parallel or future, or other R sessions attached to the
+//' same name, decode each block once between them. A worker that needs a block another is decoding
+//' waits for it. Forked workers inherit the attachment; call this in the parent before forking. Passes
+//' that stream whole channels front to back (mef_features, mef_export_dat, mef_validate,
+//' build_mef_pyramid) read the file directly instead.
+//'
+//' @param size_mb Size of a new cache in megabytes (an existing one keeps its size). 0 detaches, and
+//'   NA only reports.
+//' @param name Name of the cache; processes using the same name share it.
+//' @param slot_samples Largest block a new cache holds, in samples.
+//' @param remove When detaching, also delete the cache so its memory is freed once the last process detaches.
+//' @return Named numeric vector: slots, slot_samples, bytes and used (slots holding a block); all 0 when detached.
+//' @export
+// [[Rcpp::export]]
+Rcpp::NumericVector meftools_shared_cache( double size_mb = NA_REAL, std::string name = "meftools",
+                                           int slot_samples = 32768, bool remove = false ) {
+    if ( !ISNAN( size_mb ) ) {
+        if ( size_mb < 0 || slot_samples <= 0 )
+            Rcpp::stop( "size_mb and slot_samples must be positive" );
+        if ( size_mb == 0 ) {
+            meftools::shared_cache_detach( remove );
+        } else {
+            si4 err = meftools::shared_cache_attach( name.c_str(), (ui8) ( size_mb * 1048576.0 ), (ui4) slot_samples );
+            if ( err )
+                Rcpp::stop( name + ": " + meftools::error_string( err ) );
+        }
+    }
+
+    meftools::SHARED_CACHE_INFO info = { 0, 0, 0, 0 };
+    meftools::shared_cache_info( &info );
+    Rcpp::NumericVector out = Rcpp::NumericVector::create( Rcpp::Named( "slots" ) = (double) info.slots,
+                                                           Rcpp::Named( "slot_samples" ) = (double) info.slot_samples,
+                                                           Rcpp::Named( "bytes" ) = (double) info.bytes,
+                                                           Rcpp::Named( "used" ) = (double) info.used );
+    return out;
+}
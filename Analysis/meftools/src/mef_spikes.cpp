@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_dsp.h"
+#include "../inst/include/meftools_spikes.h"
+#include "../inst/include/meftools_parallel.h"
+
+//
+//  Native spike detection: decode -> (optional zero-phase band-pass) -> threshold detector, one
+//  contiguous segment per worker.
+//
+
+#define SPIKE_STREAM_SAMPLES    (1 << 16)
+#define SPIKE_SETTLE_TOLERANCE  1e-9
+
+//' Detect threshold-crossing spikes and extract waveform snippets.
+//'
+//' @param strings StringVector: filename, password, and optionally time0, time1 (uUTC)
+//' @param threshold Detection threshold as a multiple of the robust noise estimate (MAD / 0.6745).
+//' @param polarity -1 for negative-going spikes, 1 for positive, 0 for either.
+//' @param window Seconds of data per noise estimate.
+//' @param dead_time Seconds after a spike during which further crossings are ignored.
+//' @param pre Snippet samples before the peak.
+//' @param post Snippet samples after the peak.
+//' @param sos Second-order sections (e.g. butter_sos(2, 300, 3000, fs)) applied forward-backward
+//'   before detection; a matrix with no rows detects on the raw samples.
+//' @param threads Number of worker threads; 0 uses one per core.
+//' @return List with 'spikes', a data.frame of time (uUTC), sample, amplitude and threshold, and
+//'   'waveforms', a matrix with one row of pre + post + 1 samples per spike.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List mef_spikes( Rcpp::StringVector strings, double threshold, int polarity, double window, double dead_time,
+                       int pre, int post, Rcpp::NumericMatrix sos, int threads ) {
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+
+    if ( sos.nrow() > 0 && sos.ncol() != 6 )
+        Rcpp::stop( "sos must have six columns: b0 b1 b2 a0 a1 a2" );
+    if ( pre < 0 || post < 0 || window <= 0 || dead_time < 0 )
+        Rcpp::stop( "invalid detection parameters" );
+    std::vector<sf8> coef;
+    for ( int r = 0; r < sos.nrow(); r++ )
+        for ( int c = 0; c < 6; c++ )
+            coef.push_back( sos( r, c ) );
+
+    meftools::MefChannel channel;
+    si4 err = channel.open( filename.c_str(), password.c_str() );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+
+    ui8 time0 = 0, time1 = (ui8) -1;
+    if ( strings.size() > 3 ) {
+        time0 = (ui8) atof( strings(2) );
+        time1 = (ui8) atof( strings(3) );
+    }
+
+    const sf8 fs = channel.header().sampling_frequency;
+    meftools::SPIKE_PARAMS params;
+    params.threshold = threshold;
+    params.polarity = polarity;
+    params.window = (ui8) ceil( window * fs );
+    params.dead_time = (ui8) ceil( dead_time * fs );
+    params.pre = pre;
+    params.post = post;
+
+    std::vector<meftools::MEF_SEGMENT> all = channel.segments( time0, time1 ), segments;
+    std::vector<ui8> first, last;
+    for ( size_t i = 0; i < all.size(); i++ ) {
+        ui8 s0, s1;
+        if ( channel.clip_segment( all[i], time0, time1, &s0, &s1 ) ) {
+            segments.push_back( all[i] );
+            first.push_back( s0 );
+            last.push_back( s1 );
+        }
+    }
+
+    size_t pad = coef.empty() ? 0 : meftools::SosFilter( coef ).settle_samples( SPIKE_SETTLE_TOLERANCE );
+    std::vector<meftools::SpikeDetector> detectors( segments.size(), meftools::SpikeDetector( params ) );
+    std::vector<si4> results( segments.size(), meftools::MEF_OK );
+    meftools::parallel_for( segments.size(), threads, [&]( size_t i ) {
+        if ( coef.empty() )
+            results[i] = meftools::stream_segment( channel, first[i], last[i], SPIKE_STREAM_SAMPLES, detectors[i] );
+        else
+            results[i] = meftools::filtfilt_segment( channel, segments[i], first[i], last[i], coef, pad, SPIKE_STREAM_SAMPLES, detectors[i] );
+        detectors[i].finish();
+    } );
+
+    size_t n = 0;
+    for ( size_t i = 0; i < segments.size(); i++ ) {
+        if ( results[i] )
+            Rcpp::stop( filename + ": " + meftools::error_string( results[i] ) );
+        n += detectors[i].spikes().size();
+    }
+
+    const int width = pre + post + 1;
+    Rcpp::NumericVector time( n ), sample( n ), amplitude( n ), level( n );
+    Rcpp::NumericMatrix waveforms( n, width );
+    size_t k = 0;
+    for ( size_t i = 0; i < segments.size(); i++ ) {
+        const std::vector<meftools::SPIKE> &spikes = detectors[i].spikes();
+        const std::vector<sf8> &w = detectors[i].waveforms();
+        for ( size_t j = 0; j < spikes.size(); j++, k++ ) {
+            time[k] = (sf8) channel.time_of_sample( spikes[j].sample );
+            sample[k] = (sf8) spikes[j].sample;
+            amplitude[k] = spikes[j].amplitude;
+            level[k] = spikes[j].threshold;
+            for ( int c = 0; c < width; c++ )
+                waveforms( k, c ) = w[j * width + c];
+        }
+    }
+
+    return Rcpp::List::create( Rcpp::Named("spikes") = Rcpp::DataFrame::create( Rcpp::Named("time") = time,
+                                                                                Rcpp::Named("sample") = sample,
+                                                                                Rcpp::Named("amplitude") = amplitude,
+                                                                                Rcpp::Named("threshold") = level ),
+                               Rcpp::Named("waveforms") = waveforms );
+}
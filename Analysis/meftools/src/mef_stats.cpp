@@ -0,0 +1,75 @@
+#include <string>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_stats.h"
+#include "../inst/include/meftools_trace.h"
+
+//' Read-path timing and counters.
+//'
+//' The native reader keeps process-wide totals of how many times each stage ran and how long it took
+//' (open, header_decrypt, key_expansion, index_load, block_read, range_decode, diff_reconstruct,
+//' output_copy), plus bytes read, blocks and samples decoded and block cache hits and misses. They are
+//' cheap enough to be always on; call this before and after a workload, or with reset = TRUE, to see
+//' where the time goes.
+//'
+//' @param reset Zero all totals after taking the snapshot.
+//' @return list with 'stages', a data.frame of stage, calls and seconds, and 'counters', a named numeric vector.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List meftools_stats( bool reset = false ) {
+    meftools::MEF_STATS stats;
+    meftools::stats_snapshot( &stats );
+    if ( reset )
+        meftools::stats_reset();
+
+    Rcpp::CharacterVector stage( meftools::STAGE_COUNT );
+    Rcpp::NumericVector calls( meftools::STAGE_COUNT ), seconds( meftools::STAGE_COUNT );
+    for ( int i = 0; i < meftools::STAGE_COUNT; i++ ) {
+        stage(i) = meftools::stage_name( i );
+        calls(i) = (double) stats.calls[i];
+        seconds(i) = stats.nanoseconds[i] / 1e9;
+    }
+
+    Rcpp::NumericVector counters( meftools::COUNTER_COUNT );
+    Rcpp::CharacterVector names( meftools::COUNTER_COUNT );
+    for ( int i = 0; i < meftools::COUNTER_COUNT; i++ ) {
+        counters(i) = (double) stats.counters[i];
+        names(i) = meftools::counter_name( i );
+    }
+    counters.attr( "names" ) = names;
+
+    return Rcpp::List::create( Rcpp::Named( "stages" ) = Rcpp::DataFrame::create( Rcpp::Named( "stage" ) = stage,
+                                                                                 Rcpp::Named( "calls" ) = calls,
+                                                                                 Rcpp::Named( "seconds" ) = seconds,
+                                                                                 Rcpp::Named( "stringsAsFactors" ) = false ),
+                               Rcpp::Named( "counters" ) = counters );
+}
+
+//' Record a timeline of the read path in Chrome trace-event format.
+//'
+//' While tracing is on, every native stage (see meftools_stats) and every decode, interleave and
+//' write tile of mef_export_dat is recorded with its start, duration and thread. The trace shows
+//' whether I/O, decoding and writing actually overlap; open the file in chrome://tracing or
+//' https://ui.perfetto.dev. Tracing is off by default and costs almost nothing while off.
+//'
+//' @param enable TRUE to discard earlier events and start recording, FALSE to stop.
+//' @param file If not empty, the events recorded so far are written here (as JSON) before recording restarts.
+//' @return The number of events recorded so far.
+//' @export
+// [[Rcpp::export]]
+double meftools_trace( bool enable, std::string file = "" ) {
+    if ( !enable )
+        meftools::trace_stop();
+    double n = (double) meftools::trace_event_count();
+    if ( !file.empty() ) {
+        si4 err = meftools::trace_write( file.c_str() );
+        if ( err )
+            Rcpp::stop( file + ": " + meftools::error_string( err ) );
+    }
+    if ( enable )
+        meftools::trace_start();
+    return n;
+}
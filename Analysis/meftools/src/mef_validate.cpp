@@ -0,0 +1,45 @@
+#include <string>
+#include <vector>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_scan.h"
+
+//' Check a MEF file block by block.
+//'
+//' Runs the checks of mef_lib's validate_mef (header times against the block index, index steps, block
+//' sizes against the index, CRCs, 8-byte alignment, block start times) and decodes every block, in a
+//' single sequential pass with large reads that are not left in the page cache.
+//'
+//' @param strings StringVector: filename, password
+//' @param threads Number of decode threads; 0 uses one per core.
+//' @return data.frame with one row per problem found: block (0-based; NA for the header or index as a
+//'   whole) and problem. No rows means the file is sound.
+//' @export
+// [[Rcpp::export]]
+Rcpp::DataFrame mef_validate( Rcpp::StringVector strings, int threads ) {
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+
+    meftools::MefChannel channel;
+    si4 err = channel.open( filename.c_str(), password.c_str() );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+
+    std::vector<meftools::VALIDATION_ISSUE> issues;
+    err = meftools::validate_channel( channel, threads, issues );
+    if ( err )
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+
+    Rcpp::NumericVector block( issues.size() );
+    Rcpp::CharacterVector problem( issues.size() );
+    for ( size_t i = 0; i < issues.size(); i++ ) {
+        block[i] = issues[i].block < 0 ? NA_REAL : (double) issues[i].block;
+        problem[i] = issues[i].problem;
+    }
+    return Rcpp::DataFrame::create( Rcpp::Named("block") = block,
+                                    Rcpp::Named("problem") = problem,
+                                    Rcpp::Named("stringsAsFactors") = false );
+}
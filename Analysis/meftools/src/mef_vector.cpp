@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+#include <string>
+
+#include <RcppCommon.h>
+#include <Rcpp.h>
+
+// R_ext/Altrep.h names a parameter 'class' in some R versions
+#define class klass
+extern "C" {
+#include <R_ext/Altrep.h>
+}
+#undef class
+
+#include "../inst/include/meftools_core.h"
+
+//
+//  A channel handle is an external pointer owning an open MefChannel. A mef_vector is an ALTREP
+//  integer vector whose data1 is an external pointer to a BlockCache over that channel (protecting
+//  the handle, so the channel outlives every vector made from it) and whose data2 is R_NilValue until
+//  R insists on a contiguous copy, after which it holds the materialized samples.
+//
+//  The callbacks below are called from R's C code, so no C++ exception may leave them: the reads that
+//  can throw go through fill_region(), which turns an exception into an error code. A channel cannot
+//  be reopened in another session (the handle holds no password), so a saved vector serializes as its
+//  samples and reads back as an ordinary integer vector.
+//
+
+#define MEF_VECTOR_CACHE_BLOCKS 16
+
+namespace {
+
+  R_altrep_class_t mef_vector_class;
+
+  meftools::BlockCache *vector_cache( SEXP x ) {
+      return (meftools::BlockCache *) R_ExternalPtrAddr( R_altrep_data1( x ) );
+  }
+
+  void cache_finalizer( SEXP ptr ) {
+      meftools::BlockCache *cache = (meftools::BlockCache *) R_ExternalPtrAddr( ptr );
+      if ( cache ) {
+          delete cache;
+          R_ClearExternalPtr( ptr );
+      }
+  }
+
+  // Errors are raised by the callers below once nothing with a destructor is left on their stack.
+  si4 fill_region( meftools::BlockCache *cache, R_xlen_t start, R_xlen_t n, int *out ) {
+      try {
+          // long runs bypass the cache so they do not evict the blocks element access keeps reusing
+          if ( (ui8) n > 2 * cache->channel().header().maximum_block_length )
+              return cache->channel().read_samples( (ui8) start, (ui8) ( start + n - 1 ), (si4 *) out );
+          return cache->read( (ui8) start, (size_t) n, (si4 *) out );
+      }
+      catch ( const std::bad_alloc & ) {
+          return meftools::MEF_ERR_MEMORY;
+      }
+      catch ( ... ) {
+          return meftools::MEF_ERR_READ;
+      }
+  }
+
+  // Copy samples [start, start + n) into out, from the materialized copy when there is one.
+  si4 copy_region( SEXP x, R_xlen_t start, R_xlen_t n, int *out ) {
+      SEXP data = R_altrep_data2( x );
+      if ( data != R_NilValue ) {
+          memcpy( out, INTEGER( data ) + start, n * sizeof(int) );
+          return meftools::MEF_OK;
+      }
+      return fill_region( vector_cache( x ), start, n, out );
+  }
+
+  R_xlen_t mef_vector_length( SEXP x ) {
+      return (R_xlen_t) vector_cache( x )->channel().header().number_of_samples;
+  }
+
+  void *mef_vector_dataptr( SEXP x, Rboolean ) {
+      SEXP data = R_altrep_data2( x );
+      if ( data == R_NilValue ) {
+          meftools::BlockCache *cache = vector_cache( x );
+          R_xlen_t n = mef_vector_length( x );
+          PROTECT( data = Rf_allocVector( INTSXP, n ) );
+          si4 err = n > 0 ? fill_region( cache, 0, n, INTEGER( data ) ) : meftools::MEF_OK;
+          if ( err ) {
+              UNPROTECT( 1 );
+              Rf_error( "%s: %s", cache->channel().path().c_str(), meftools::error_string( err ) );
+          }
+          R_set_altrep_data2( x, data );
+          UNPROTECT( 1 );
+      }
+      return INTEGER( data );
+  }
+
+  const void *mef_vector_dataptr_or_null( SEXP x ) {
+      SEXP data = R_altrep_data2( x );
+      return data == R_NilValue ? NULL : INTEGER( data );
+  }
+
+  int mef_vector_elt( SEXP x, R_xlen_t i ) {
+      SEXP data = R_altrep_data2( x );
+      if ( data != R_NilValue )
+          return INTEGER( data )[i];
+      meftools::BlockCache *cache = vector_cache( x );
+      int value;
+      si4 err = fill_region( cache, i, 1, &value );
+      if ( err )
+          Rf_error( "%s: %s", cache->channel().path().c_str(), meftools::error_string( err ) );
+      return value;
+  }
+
+  R_xlen_t mef_vector_get_region( SEXP x, R_xlen_t start, R_xlen_t size, int *buf ) {
+      R_xlen_t n = mef_vector_length( x );
+      if ( start >= n )
+          return 0;
+      if ( size > n - start )
+          size = n - start;
+      si4 err = copy_region( x, start, size, buf );
+      if ( err )
+          Rf_error( "%s: %s", vector_cache( x )->channel().path().c_str(), meftools::error_string( err ) );
+      return size;
+  }
+
+  // x[i] for integer or double indices, read run by run of consecutive indices; out-of-range and NA
+  // indices give NA. Other index types (and logical masks) are left to R.
+  SEXP mef_vector_extract_subset( SEXP x, SEXP indx, SEXP ) {
+      if ( TYPEOF( indx ) != INTSXP && TYPEOF( indx ) != REALSXP )
+          return NULL;
+      R_xlen_t n = mef_vector_length( x );
+      R_xlen_t m = XLENGTH( indx );
+      SEXP result = PROTECT( Rf_allocVector( INTSXP, m ) );
+      int *out = INTEGER( result );
+      si4 err = meftools::MEF_OK;
+
+      // zero-based position of index k, or -1 when it is NA or outside the vector
+      auto position = [&]( R_xlen_t k ) -> R_xlen_t {
+          if ( TYPEOF( indx ) == INTSXP ) {
+              int v = INTEGER( indx )[k];
+              return v == NA_INTEGER || v < 1 || v > n ? -1 : (R_xlen_t) v - 1;
+          }
+          double v = REAL( indx )[k];
+          return ISNAN( v ) || v < 1 || v >= (double) n + 1 ? -1 : (R_xlen_t) v - 1;
+      };
+      for ( R_xlen_t k = 0, run; k < m && !err; k += run ) {
+          R_xlen_t first = position( k );
+          if ( first < 0 ) {
+              out[k] = NA_INTEGER;
+              run = 1;
+              continue;
+          }
+          for ( run = 1; k + run < m && position( k + run ) == first + run; run++ )
+              ;
+          err = copy_region( x, first, run, out + k );
+      }
+      UNPROTECT( 1 );
+      if ( err )
+          Rf_error( "%s: %s", vector_cache( x )->channel().path().c_str(), meftools::error_string( err ) );
+      return result;
+  }
+
+  // The samples themselves, copied region by region so that saving does not materialize the vector.
+  SEXP mef_vector_serialized_state( SEXP x ) {
+      SEXP data = R_altrep_data2( x );
+      if ( data != R_NilValue )
+          return data;
+      R_xlen_t n = mef_vector_length( x );
+      SEXP state = PROTECT( Rf_allocVector( INTSXP, n ) );
+      si4 err = n > 0 ? fill_region( vector_cache( x ), 0, n, INTEGER( state ) ) : meftools::MEF_OK;
+      UNPROTECT( 1 );
+      if ( err )
+          Rf_error( "%s: %s", vector_cache( x )->channel().path().c_str(), meftools::error_string( err ) );
+      return state;
+  }
+
+  SEXP mef_vector_unserialize( SEXP, SEXP state ) {
+      return state;
+  }
+
+  // MEF samples are never NA, which lets sum() and friends skip their NA checks.
+  int mef_vector_no_na( SEXP ) {
+      return 1;
+  }
+
+  // An unmodified vector duplicates as another lazy view of the same cache.
+  SEXP mef_vector_duplicate( SEXP x, Rboolean ) {
+      if ( R_altrep_data2( x ) != R_NilValue )
+          return NULL;
+      return R_new_altrep( mef_vector_class, R_altrep_data1( x ), R_NilValue );
+  }
+
+  Rboolean mef_vector_inspect( SEXP x, int, int, int, void (*)( SEXP, int, int, int ) ) {
+      Rprintf( " meftools::mef_vector %s (%s)\n", vector_cache( x )->channel().path().c_str(),
+               R_altrep_data2( x ) == R_NilValue ? "lazy" : "materialized" );
+      return TRUE;
+  }
+
+}
+
+// [[Rcpp::init]]
+void init_mef_vector( DllInfo *dll ) {
+    mef_vector_class = R_make_altinteger_class( "mef_vector", "meftools", dll );
+    R_set_altrep_Length_method( mef_vector_class, mef_vector_length );
+    R_set_altrep_Inspect_method( mef_vector_class, mef_vector_inspect );
+    R_set_altrep_Duplicate_method( mef_vector_class, mef_vector_duplicate );
+    R_set_altrep_Serialized_state_method( mef_vector_class, mef_vector_serialized_state );
+    R_set_altrep_Unserialize_method( mef_vector_class, mef_vector_unserialize );
+    R_set_altvec_Extract_subset_method( mef_vector_class, mef_vector_extract_subset );
+    R_set_altvec_Dataptr_method( mef_vector_class, mef_vector_dataptr );
+    R_set_altvec_Dataptr_or_null_method( mef_vector_class, mef_vector_dataptr_or_null );
+    R_set_altinteger_Elt_method( mef_vector_class, mef_vector_elt );
+    R_set_altinteger_Get_region_method( mef_vector_class, mef_vector_get_region );
+    R_set_altinteger_No_NA_method( mef_vector_class, mef_vector_no_na );
+}
+
+//' Open a MEF channel and return a handle to it.
+//'
+//' The handle keeps the file open (and its index and decryption key in memory) until it is garbage
+//' collected, so repeated reads through it skip the header and index parsing.
+//'
+//' @param strings StringVector: filename, password
+//' @return External pointer to the open channel.
+//' @export
+// [[Rcpp::export]]
+SEXP mef_open( Rcpp::StringVector strings ) {
+    std::string filename = Rcpp::as<std::string>( strings(0) );
+    std::string password = strings.size() > 1 ? Rcpp::as<std::string>( strings(1) ) : "";
+
+    meftools::MefChannel *channel = new meftools::MefChannel;
+    si4 err = channel->open( filename.c_str(), password.c_str() );
+    if ( err ) {
+        delete channel;
+        Rcpp::stop( filename + ": " + meftools::error_string( err ) );
+    }
+    Rcpp::XPtr<meftools::MefChannel> handle( channel, true );
+    handle.attr("class") = "mef_handle";
+    return handle;
+}
+
+//' An integer vector over all samples of a MEF channel, decoded on demand.
+//'
+//' The vector is an ALTREP object: indexing it (x[i], x[t0:t1], head(x), ...) decodes only the blocks
+//' that hold the requested samples, through a small cache of recently used blocks. The whole channel
+//' is decoded into memory only if R code asks for a contiguous pointer to the data (or modifies it).
+//'
+//' @param handle Channel handle from mef_open().
+//' @return Integer vector of length number_of_samples, in raw sample units.
+//' @export
+// [[Rcpp::export]]
+SEXP mef_vector( SEXP handle ) {
+    if ( TYPEOF( handle ) != EXTPTRSXP || !Rf_inherits( handle, "mef_handle" ) || R_ExternalPtrAddr( handle ) == NULL )
+        Rcpp::stop( "handle must come from mef_open()" );
+    meftools::MefChannel *channel = (meftools::MefChannel *) R_ExternalPtrAddr( handle );
+
+    SEXP cache = PROTECT( R_MakeExternalPtr( new meftools::BlockCache( *channel, MEF_VECTOR_CACHE_BLOCKS ), R_NilValue, handle ) );
+    R_RegisterCFinalizerEx( cache, cache_finalizer, TRUE );
+    SEXP x = R_new_altrep( mef_vector_class, cache, R_NilValue );
+    UNPROTECT( 1 );
+    return x;
+}
@@ -0,0 +1,588 @@
+/*
+		meftools_async_io.cpp
+
+ Asynchronous multi-channel block reader declared in meftools_async_io.h.
+
+ The io_uring backend talks to the kernel directly: it maps the submission and completion rings set up
+ by io_uring_setup(2) and issues IORING_OP_READV requests (Linux 5.1 and later), so nothing beyond the
+ kernel headers is needed to build it. Any request the ring cannot complete is retried with pread().
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define MEFTOOLS_IO_URING
+#endif
+#endif
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../inst/include/meftools_async_io.h"
+#include "../inst/include/meftools_parallel.h"
+#include "../inst/include/meftools_shared_cache.h"
+#include "../inst/include/meftools_stats.h"
+#include "../inst/include/meftools_trace.h"
+
+#define ASYNC_READ_THREADS  16      // most pread threads of the fallback backend
+
+namespace meftools {
+
+namespace {
+
+  typedef struct {
+    int fd;
+    ui8 offset;
+    ui8 bytes;
+    ui8 done;           // bytes read so far
+    ui1 *buffer;
+    size_t tag;
+  } READ_REQUEST;
+
+  // pread whatever of the request has not arrived yet
+  bool read_rest(READ_REQUEST &r)
+  {
+    ssize_t n;
+
+    while (r.done < r.bytes) {
+      n = pread(r.fd, r.buffer + r.done, r.bytes - r.done, (off_t) (r.offset + r.done));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      r.done += (ui8) n;
+    }
+    return true;
+  }
+
+}
+
+struct AsyncReader::Backend {
+  virtual ~Backend() {}
+  virtual const char *name() const = 0;
+  virtual void submit(const READ_REQUEST &request) = 0;
+  virtual bool wait(size_t *tag, si4 *status) = 0;
+  virtual size_t outstanding() const = 0;
+};
+
+namespace {
+
+  //
+  //  Fallback: a pool of threads, each taking the next queued request and reading it with pread().
+  //
+  class ThreadBackend : public AsyncReader::Backend {
+  public:
+    explicit ThreadBackend(unsigned n_threads) : outstanding_(0), stop_(false)
+    {
+      for (unsigned i = 0; i < n_threads; i++)
+        threads_.push_back(std::thread(&ThreadBackend::work, this));
+    }
+
+    ~ThreadBackend()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      queued_cv_.notify_all();
+      for (size_t i = 0; i < threads_.size(); i++)
+        threads_[i].join();
+    }
+
+    const char *name() const { return "threads"; }
+
+    void submit(const READ_REQUEST &request)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_.push_back(request);
+      }
+      outstanding_++;
+      queued_cv_.notify_one();
+    }
+
+    bool wait(size_t *tag, si4 *status)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+
+      if (outstanding_ == 0)
+        return false;
+      done_cv_.wait(lock, [this]() { return !done_.empty(); });
+      *tag = done_.front().first;
+      *status = done_.front().second;
+      done_.pop_front();
+      outstanding_--;
+      return true;
+    }
+
+    size_t outstanding() const { return outstanding_; }
+
+  private:
+    void work()
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      READ_REQUEST r;
+      bool ok;
+
+      for (;;) {
+        queued_cv_.wait(lock, [this]() { return stop_ || !queued_.empty(); });
+        if (stop_)
+          return;
+        r = queued_.front();
+        queued_.pop_front();
+        lock.unlock();
+        ok = read_rest(r);
+        lock.lock();
+        done_.push_back(std::make_pair(r.tag, ok ? MEF_OK : MEF_ERR_READ));
+        done_cv_.notify_one();
+      }
+    }
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable queued_cv_, done_cv_;
+    std::deque<READ_REQUEST> queued_;
+    std::deque<std::pair<size_t, si4> > done_;
+    size_t outstanding_;    // only touched by the driving thread
+    bool stop_;
+  };
+
+#ifdef MEFTOOLS_IO_URING
+
+  //
+  //  io_uring: requests go into the submission ring a batch at a time and one io_uring_enter() both
+  //  submits them and sleeps until something completes. At most sq_entries requests are in flight, so
+  //  the completion ring (twice as large) can never overflow.
+  //
+  class UringBackend : public AsyncReader::Backend {
+  public:
+    UringBackend() : fd_(-1), sq_map_(NULL), cq_map_(NULL), sqes_(NULL), in_flight_(0), unsubmitted_(0) {}
+
+    ~UringBackend()
+    {
+      if (sqes_ != NULL)
+        munmap(sqes_, sqes_bytes_);
+      if (cq_map_ != NULL && cq_map_ != sq_map_)
+        munmap(cq_map_, cq_bytes_);
+      if (sq_map_ != NULL)
+        munmap(sq_map_, sq_bytes_);
+      if (fd_ >= 0)
+        close(fd_);
+    }
+
+    // False when the kernel does not offer io_uring to this process.
+    bool setup(unsigned depth)
+    {
+      struct io_uring_params p;
+      ui1 *sq, *cq;
+      void *map;
+
+      memset(&p, 0, sizeof(p));
+      fd_ = (int) syscall(__NR_io_uring_setup, depth, &p);
+      if (fd_ < 0)
+        return false;
+
+      sq_bytes_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+      cq_bytes_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+      if (p.features & IORING_FEAT_SINGLE_MMAP)
+        sq_bytes_ = cq_bytes_ = std::max(sq_bytes_, cq_bytes_);
+      map = mmap(NULL, sq_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+      if (map == MAP_FAILED)
+        return false;
+      sq_map_ = map;
+      if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        cq_map_ = sq_map_;
+      } else {
+        map = mmap(NULL, cq_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (map == MAP_FAILED)
+          return false;
+        cq_map_ = map;
+      }
+      sqes_bytes_ = p.sq_entries * sizeof(struct io_uring_sqe);
+      map = mmap(NULL, sqes_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+      if (map == MAP_FAILED)
+        return false;
+      sqes_ = (struct io_uring_sqe *) map;
+
+      sq = (ui1 *) sq_map_;
+      cq = (ui1 *) cq_map_;
+      sq_tail_ = (unsigned *) (sq + p.sq_off.tail);
+      sq_mask_ = *(unsigned *) (sq + p.sq_off.ring_mask);
+      sq_array_ = (unsigned *) (sq + p.sq_off.array);
+      cq_head_ = (unsigned *) (cq + p.cq_off.head);
+      cq_tail_ = (unsigned *) (cq + p.cq_off.tail);
+      cq_mask_ = *(unsigned *) (cq + p.cq_off.ring_mask);
+      cqes_ = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+      slots_.resize(p.sq_entries);
+      iovecs_.resize(p.sq_entries);
+      for (unsigned i = 0; i < p.sq_entries; i++)
+        free_.push_back(p.sq_entries - 1 - i);
+      return true;
+    }
+
+    const char *name() const { return "io_uring"; }
+
+    void submit(const READ_REQUEST &request)
+    {
+      pending_.push_back(request);
+    }
+
+    bool wait(size_t *tag, si4 *status)
+    {
+      struct io_uring_cqe *cqe;
+      unsigned head, tail, slot;
+      si4 res;
+      long ret;
+
+      if (pending_.empty() && in_flight_ == 0)
+        return false;
+      for (;;) {
+        fill();
+        head = *cq_head_;
+        tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+          // nothing has completed yet: submit what is queued and sleep until something does
+          ret = syscall(__NR_io_uring_enter, fd_, unsubmitted_, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+          if (ret > 0)
+            unsubmitted_ -= std::min((unsigned) ret, unsubmitted_);
+          else if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            usleep(1000);
+          continue;
+        }
+        cqe = &cqes_[head & cq_mask_];
+        slot = (unsigned) cqe->user_data;
+        res = cqe->res;
+        __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+
+        READ_REQUEST &r = slots_[slot];
+        if (res > 0 && r.done + (ui8) res < r.bytes) {
+          // short read: ask for the rest from the same slot
+          r.done += (ui8) res;
+          push(slot);
+          continue;
+        }
+        if (res >= 0)
+          r.done += (ui8) res;
+        else if (res != -EIO)
+          read_rest(r);     // the ring refused the request (an old kernel, say): read it here instead
+        *tag = r.tag;
+        *status = r.done == r.bytes ? MEF_OK : MEF_ERR_READ;
+        free_.push_back(slot);
+        in_flight_--;
+        return true;
+      }
+    }
+
+    size_t outstanding() const { return pending_.size() + in_flight_; }
+
+  private:
+    // move queued requests into free slots of the submission ring
+    void fill()
+    {
+      unsigned slot;
+
+      while (!pending_.empty() && !free_.empty()) {
+        slot = free_.back();
+        free_.pop_back();
+        slots_[slot] = pending_.front();
+        pending_.pop_front();
+        in_flight_++;
+        push(slot);
+      }
+      if (unsubmitted_ > 0) {
+        long ret = syscall(__NR_io_uring_enter, fd_, unsubmitted_, 0, 0, NULL, 0);
+        if (ret > 0)
+          unsubmitted_ -= std::min((unsigned) ret, unsubmitted_);
+      }
+    }
+
+    // add a read of what is left of slot's request to the submission ring
+    void push(unsigned slot)
+    {
+      READ_REQUEST &r = slots_[slot];
+      unsigned tail = *sq_tail_, index = tail & sq_mask_;
+      struct io_uring_sqe *sqe = &sqes_[index];
+
+      iovecs_[slot].iov_base = r.buffer + r.done;
+      iovecs_[slot].iov_len = (size_t) std::min(r.bytes - r.done, (ui8) 1 << 30);
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_READV;
+      sqe->fd = r.fd;
+      sqe->off = r.offset + r.done;
+      sqe->addr = (unsigned long) &iovecs_[slot];
+      sqe->len = 1;
+      sqe->user_data = slot;
+      sq_array_[index] = index;
+      __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+      unsubmitted_++;
+    }
+
+    int fd_;
+    void *sq_map_, *cq_map_;
+    size_t sq_bytes_, cq_bytes_, sqes_bytes_;
+    struct io_uring_sqe *sqes_;
+    unsigned *sq_tail_, *sq_array_, sq_mask_;
+    unsigned *cq_head_, *cq_tail_, cq_mask_;
+    struct io_uring_cqe *cqes_;
+
+    std::vector<READ_REQUEST> slots_;   // the request behind each user_data
+    std::vector<struct iovec> iovecs_;
+    std::vector<unsigned> free_;
+    std::deque<READ_REQUEST> pending_;  // not yet in the ring
+    unsigned in_flight_;
+    unsigned unsubmitted_;              // in the ring, not yet taken by the kernel
+  };
+
+#endif
+
+  typedef struct {
+    size_t window;
+    ui8 b0, b1;
+    ui8 offset;
+    ui8 bytes;
+    std::vector<ui1> buffer;
+  } CHUNK;
+
+  // decode a chunk's blocks and keep the part that falls inside its window
+  si4 decode_chunk(READ_WINDOW &w, const CHUNK &c)
+  {
+    const MefChannel &ch = *w.channel;
+    std::vector<si4> tmp;
+    ui8 first, last, lo, hi;
+    si4 err;
+
+    first = ch.index()[c.b0].sample_number;
+    last = ch.index()[c.b1].sample_number + ch.block_samples(c.b1) - 1;
+    if (first >= w.first_sample && last <= w.last_sample)
+      return ch.decode_buffer(c.b0, c.b1, &c.buffer[0], w.out + (first - w.first_sample));
+
+    try {
+      tmp.resize(last - first + 1);
+    } catch (...) {
+      return(MEF_ERR_MEMORY);
+    }
+    if ((err = ch.decode_buffer(c.b0, c.b1, &c.buffer[0], &tmp[0])) != MEF_OK)
+      return(err);
+    lo = std::max(first, w.first_sample);
+    hi = std::min(last, w.last_sample);
+    StageTimer copy_timer(STAGE_OUTPUT_COPY);
+    memcpy(w.out + (lo - w.first_sample), &tmp[lo - first], (hi - lo + 1) * sizeof(si4));
+    return(MEF_OK);
+  }
+
+}
+
+AsyncReader::AsyncReader(unsigned depth, bool use_io_uring) : backend_(NULL)
+{
+    if (depth == 0)
+        depth = 1;
+#ifdef MEFTOOLS_IO_URING
+    if (use_io_uring) {
+        UringBackend *ring = new UringBackend;
+        if (ring->setup(depth))
+            backend_ = ring;
+        else
+            delete ring;
+    }
+#else
+    (void) use_io_uring;
+#endif
+    if (backend_ == NULL)
+        backend_ = new ThreadBackend(std::min(depth, (unsigned) ASYNC_READ_THREADS));
+}
+
+AsyncReader::~AsyncReader()
+{
+    delete backend_;
+}
+
+const char *AsyncReader::backend() const
+{
+    return backend_->name();
+}
+
+void AsyncReader::submit(int fd, ui8 offset, ui8 bytes, ui1 *buffer, size_t tag)
+{
+    READ_REQUEST r;
+
+    r.fd = fd;
+    r.offset = offset;
+    r.bytes = bytes;
+    r.done = 0;
+    r.buffer = buffer;
+    r.tag = tag;
+    backend_->submit(r);
+}
+
+bool AsyncReader::wait(size_t *tag, si4 *status)
+{
+    return backend_->wait(tag, status);
+}
+
+size_t AsyncReader::outstanding() const
+{
+    return backend_->outstanding();
+}
+
+si4 read_windows(std::vector<READ_WINDOW> &windows, int threads)
+{
+    TraceSpan span("read_windows", "async_io", (si8) windows.size());
+    std::vector<CHUNK> chunks;
+    std::deque<size_t> ready;           // chunks read and waiting for a decoder
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable ready_cv, room_cv;
+    ui8 held = 0;                       // bytes of chunks read or being read but not yet decoded
+    bool finished = false;
+    unsigned n_workers;
+    size_t i, next, tag;
+    ui8 b, e, b0, b1;
+    si4 status;
+
+    // check the windows and cut each into reads of consecutive blocks
+    for (i = 0; i < windows.size(); i++) {
+        READ_WINDOW &w = windows[i];
+        const MefChannel *ch = w.channel;
+        w.status = MEF_OK;
+        if (ch == NULL || !ch->is_open() || ch->number_of_blocks() == 0 || w.first_sample > w.last_sample
+            || w.last_sample >= ch->header().number_of_samples) {
+            w.status = MEF_ERR_RANGE;
+            continue;
+        }
+        if (shared_cache_attached())
+            continue;
+        b0 = ch->block_of_sample(w.first_sample);
+        b1 = ch->block_of_sample(w.last_sample);
+        for (b = b0; b <= b1; b = e + 1) {
+            for (e = b; e < b1 && ch->index()[e + 1].file_offset + ch->block_bytes(e + 1) - ch->index()[b].file_offset <= ASYNC_CHUNK_BYTES; e++)
+                ;
+            chunks.push_back(CHUNK());
+            CHUNK &c = chunks.back();
+            c.window = i;
+            c.b0 = b;
+            c.b1 = e;
+            c.offset = ch->index()[b].file_offset;
+            c.bytes = ch->index()[e].file_offset + ch->block_bytes(e) - c.offset;
+        }
+    }
+
+    if (shared_cache_attached()) {
+        // cached blocks must not be read at all, so leave the reading to decode_blocks()
+        parallel_for(windows.size(), threads, [&](size_t k) {
+            READ_WINDOW &w = windows[k];
+            if (w.status == MEF_OK)
+                w.status = w.channel->read_samples(w.first_sample, w.last_sample, w.out);
+        });
+    } else if (!chunks.empty()) {
+        AsyncReader reader(ASYNC_QUEUE_DEPTH);
+
+        n_workers = threads > 0 ? (unsigned) threads : default_threads();
+        n_workers = (unsigned) std::min((size_t) n_workers, chunks.size());
+        for (unsigned k = 0; k < n_workers; k++) {
+            workers.push_back(std::thread([&]() {
+                std::unique_lock<std::mutex> lock(mutex);
+                size_t c;
+                si4 err;
+
+                for (;;) {
+                    ready_cv.wait(lock, [&]() { return finished || !ready.empty(); });
+                    if (ready.empty())
+                        return;
+                    c = ready.front();
+                    ready.pop_front();
+                    lock.unlock();
+                    {
+                        TraceSpan chunk_span("decode_chunk", "async_io", (si8) c);
+                        err = decode_chunk(windows[chunks[c].window], chunks[c]);
+                        std::vector<ui1>().swap(chunks[c].buffer);
+                    }
+                    lock.lock();
+                    if (err != MEF_OK && windows[chunks[c].window].status == MEF_OK)
+                        windows[chunks[c].window].status = err;
+                    held -= chunks[c].bytes;
+                    room_cv.notify_one();
+                }
+            }));
+        }
+
+        // keep the queue full within the memory budget and pass each finished read to the decoders
+        next = 0;
+        while (next < chunks.size() || reader.outstanding() > 0) {
+            while (next < chunks.size() && reader.outstanding() < ASYNC_QUEUE_DEPTH) {
+                CHUNK &c = chunks[next];
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (windows[c.window].status != MEF_OK) {
+                        next++;
+                        continue;
+                    }
+                    if (held > 0 && held + c.bytes > ASYNC_INFLIGHT_BYTES) {
+                        if (reader.outstanding() > 0)
+                            break;
+                        room_cv.wait(lock, [&]() { return held == 0 || held + c.bytes <= ASYNC_INFLIGHT_BYTES; });
+                    }
+                    held += c.bytes;
+                }
+                try {
+                    c.buffer.resize(c.bytes);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    windows[c.window].status = MEF_ERR_MEMORY;
+                    held -= c.bytes;
+                    next++;
+                    continue;
+                }
+                reader.submit(windows[c.window].channel->fd(), c.offset, c.bytes, &c.buffer[0], next);
+                next++;
+            }
+            if (!reader.wait(&tag, &status))
+                continue;
+            if (status == MEF_OK) {
+                stats_count(COUNTER_BYTES_READ, chunks[tag].bytes);
+                std::lock_guard<std::mutex> lock(mutex);
+                ready.push_back(tag);
+                ready_cv.notify_one();
+            } else {
+                std::vector<ui1>().swap(chunks[tag].buffer);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (windows[chunks[tag].window].status == MEF_OK)
+                    windows[chunks[tag].window].status = status;
+                held -= chunks[tag].bytes;
+                room_cv.notify_one();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        ready_cv.notify_all();
+        for (i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    for (i = 0; i < windows.size(); i++)
+        if (windows[i].status != MEF_OK)
+            return(windows[i].status);
+    return(MEF_OK);
+}
+
+}
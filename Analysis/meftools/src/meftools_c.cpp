@@ -0,0 +1,92 @@
+/*
+		meftools_c.cpp
+
+ C linkage wrappers over the codec in meftools_core.cpp (see meftools_c.h).
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <new>
+#include <vector>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_c.h"
+
+const char *meftools_error_string(int code)
+{
+    return meftools::error_string(code);
+}
+
+void meftools_expand_key(const char *password, unsigned char *round_key)
+{
+    meftools::expand_key(password, round_key);
+}
+
+unsigned long meftools_compress_bound(unsigned int sample_count)
+{
+    return meftools::compress_bound(sample_count);
+}
+
+unsigned long meftools_compress_block(const int *samples, unsigned int sample_count, unsigned long uutc_time,
+                                      unsigned char discontinuity, const unsigned char *key,
+                                      unsigned char *out, unsigned char *diff_buffer)
+{
+    std::vector<ui1> own;
+
+    if (diff_buffer == NULL) {
+        try {
+            own.resize(4 * (size_t) sample_count + 4);
+        } catch (...) {
+            return(0);
+        }
+        diff_buffer = &own[0];
+    }
+    return meftools::compress_block(samples, sample_count, uutc_time, discontinuity, key, out, diff_buffer, NULL);
+}
+
+struct meftools_channel {
+    meftools::MefChannel channel;
+};
+
+meftools_channel *meftools_open(const char *path, const char *password, int *err)
+{
+    meftools_channel *handle = new (std::nothrow) meftools_channel;
+    si4 result = handle == NULL ? meftools::MEF_ERR_MEMORY : handle->channel.open(path, password);
+
+    if (err != NULL)
+        *err = result;
+    if (result != meftools::MEF_OK) {
+        delete handle;
+        return(NULL);
+    }
+    return(handle);
+}
+
+void meftools_close(meftools_channel *channel)
+{
+    delete channel;
+}
+
+unsigned long meftools_number_of_samples(const meftools_channel *channel)
+{
+    return channel->channel.header().number_of_samples;
+}
+
+int meftools_decode_buffer(const meftools_channel *channel, unsigned long b0, unsigned long b1,
+                           const unsigned char *comp, int *out)
+{
+    try {
+        return channel->channel.decode_buffer(b0, b1, comp, out);
+    } catch (...) {
+        return(meftools::MEF_ERR_MEMORY);
+    }
+}
+
+int meftools_read_samples(const meftools_channel *channel, unsigned long s0, unsigned long s1, int *out)
+{
+    try {
+        return channel->channel.read_samples(s0, s1, out);
+    } catch (...) {
+        return(meftools::MEF_ERR_MEMORY);
+    }
+}
@@ -0,0 +1,1617 @@
+/*
+		meftools_core.cpp
+
+ Reentrant MEF 2.1 codec layer: AES-128, CRC-32, RED block encoding and decoding, header parsing and
+ the MefChannel reader declared in meftools_core.h.
+
+ The algorithms are those of mef_lib.c / RED_encode.c / RED_decode.c / AES_Encryption.c (Mayo Systems
+ Electrophysiology Laboratory), rewritten so that no routine keeps state between calls:
+ the S-box and CRC tables are constant, buffers belong to the caller, and errors are returned.
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_shared_cache.h"
+#include "../inst/include/meftools_stats.h"
+
+//RED Codec
+#define TOP_VALUE		(ui4) 0x80000000
+#define TOP_VALUE_M_1		(ui4) 0x7FFFFFFF
+#define CARRY_CHECK		(ui4) 0x7F800000
+#define BOTTOM_VALUE		(ui4) 0x800000
+#define SHIFT_BITS		23
+#define EXTRA_BITS		7
+#define FILLER_BYTE		(ui1) 0x55
+#define RED_MAX_VALUE		8388607     // samples are stored in at most 3 bytes
+
+#define LITTLE_ENDIAN_CODE	1
+
+namespace meftools {
+
+namespace {
+
+// BEGIN --- AES_Encryption.c (128-bit only) ---
+
+// The number of columns comprising a state in AES. This is a constant in AES. Value=4
+#define Nb 4
+// xtime is a macro that finds the product of {02} and the argument to xtime modulo {1b}
+#define xtime(x) ((x<<1) ^ (((x>>7) & 1) * 0x1b))
+// Multiplty is a macro used to multiply numbers in the field GF(2^8)
+#define Multiply(x,y) (((y & 1) * x) ^ ((y>>1 & 1) * xtime(x)) ^ ((y>>2 & 1) * xtime(xtime(x))) ^ ((y>>3 & 1) * xtime(xtime(xtime(x)))) ^ ((y>>4 & 1) * xtime(xtime(xtime(xtime(x))))))
+
+const ui1 sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16 };
+
+const ui1 rsbox[256] = {
+    0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
+    0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87, 0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
+    0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
+    0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2, 0x76, 0x5b, 0xa2, 0x49, 0x6d, 0x8b, 0xd1, 0x25,
+    0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16, 0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92,
+    0x6c, 0x70, 0x48, 0x50, 0xfd, 0xed, 0xb9, 0xda, 0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
+    0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a, 0xf7, 0xe4, 0x58, 0x05, 0xb8, 0xb3, 0x45, 0x06,
+    0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02, 0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b,
+    0x3a, 0x91, 0x11, 0x41, 0x4f, 0x67, 0xdc, 0xea, 0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
+    0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
+    0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89, 0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
+    0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
+    0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
+    0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d, 0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
+    0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
+    0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d };
+
+// Round constants; only the first eleven are used by a 128-bit key.
+const ui1 Rcon[11] = { 0x8d, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+
+// This function produces Nb(Nr+1) round keys. The round keys are used in each round to encrypt the states.
+void AES_KeyExpansion(int Nk, int Nr, ui1 *RoundKey, const ui1 *Key)
+{
+    int		i;
+    ui1	temp[4], k;
+
+    // The first round key is the key itself.
+    for (i = 0; i < Nk; i++) {
+        RoundKey[i * 4] = Key[i * 4];
+        RoundKey[i * 4 + 1] = Key[i * 4 + 1];
+        RoundKey[i * 4 + 2] = Key[i * 4 + 2];
+        RoundKey[i * 4 + 3] = Key[i * 4 + 3];
+    }
+
+    // All other round keys are found from the previous round keys.
+    while (i < (Nb * (Nr + 1))) {
+        temp[0] = RoundKey[(i - 1) * 4];
+        temp[1] = RoundKey[(i - 1) * 4 + 1];
+        temp[2] = RoundKey[(i - 1) * 4 + 2];
+        temp[3] = RoundKey[(i - 1) * 4 + 3];
+        if (i % Nk == 0) {
+            // rotate the word left once, then apply the S-box
+            k = temp[0];
+            temp[0] = sbox[temp[1]];
+            temp[1] = sbox[temp[2]];
+            temp[2] = sbox[temp[3]];
+            temp[3] = sbox[k];
+            temp[0] = temp[0] ^ Rcon[i / Nk];
+        }
+        RoundKey[i * 4] = RoundKey[(i - Nk) * 4] ^ temp[0];
+        RoundKey[i * 4 + 1] = RoundKey[(i - Nk) * 4 + 1] ^ temp[1];
+        RoundKey[i * 4 + 2] = RoundKey[(i - Nk) * 4 + 2] ^ temp[2];
+        RoundKey[i * 4 + 3] = RoundKey[(i - Nk) * 4 + 3] ^ temp[3];
+        i++;
+    }
+}
+
+// The round key is added to the state by an XOR function.
+void AddRoundKey(int round, ui1 state[][4], const ui1 *RoundKey)
+{
+    int	i, j;
+
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            state[j][i] ^= RoundKey[round * Nb * 4 + i * Nb + j];
+}
+
+void SubBytes(ui1 state[][4])
+{
+    int	i, j;
+
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            state[i][j] = sbox[state[i][j]];
+}
+
+void InvSubBytes(ui1 state[][4])
+{
+    int	i, j;
+
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            state[i][j] = rsbox[state[i][j]];
+}
+
+void ShiftRows(ui1 state[][4])
+{
+    ui1	temp;
+
+    // Rotate first row 1 columns to left
+    temp = state[1][0];
+    state[1][0] = state[1][1];
+    state[1][1] = state[1][2];
+    state[1][2] = state[1][3];
+    state[1][3] = temp;
+
+    // Rotate second row 2 columns to left
+    temp = state[2][0];
+    state[2][0] = state[2][2];
+    state[2][2] = temp;
+    temp = state[2][1];
+    state[2][1] = state[2][3];
+    state[2][3] = temp;
+
+    // Rotate third row 3 columns to left
+    temp = state[3][0];
+    state[3][0] = state[3][3];
+    state[3][3] = state[3][2];
+    state[3][2] = state[3][1];
+    state[3][1] = temp;
+}
+
+void InvShiftRows(ui1 state[][4])
+{
+    ui1	temp;
+
+    // Rotate first row 1 columns to right
+    temp = state[1][3];
+    state[1][3] = state[1][2];
+    state[1][2] = state[1][1];
+    state[1][1] = state[1][0];
+    state[1][0] = temp;
+
+    // Rotate second row 2 columns to right
+    temp = state[2][0];
+    state[2][0] = state[2][2];
+    state[2][2] = temp;
+    temp = state[2][1];
+    state[2][1] = state[2][3];
+    state[2][3] = temp;
+
+    // Rotate third row 3 columns to right
+    temp = state[3][0];
+    state[3][0] = state[3][1];
+    state[3][1] = state[3][2];
+    state[3][2] = state[3][3];
+    state[3][3] = temp;
+}
+
+void MixColumns(ui1 state[][4])
+{
+    int		i;
+    ui1	Tmp, Tm, t;
+
+    for (i = 0; i < 4; i++) {
+        t = state[0][i];
+        Tmp = state[0][i] ^ state[1][i] ^ state[2][i] ^ state[3][i];
+        Tm = state[0][i] ^ state[1][i]; Tm = xtime(Tm); state[0][i] ^= Tm ^ Tmp;
+        Tm = state[1][i] ^ state[2][i]; Tm = xtime(Tm); state[1][i] ^= Tm ^ Tmp;
+        Tm = state[2][i] ^ state[3][i]; Tm = xtime(Tm); state[2][i] ^= Tm ^ Tmp;
+        Tm = state[3][i] ^ t; Tm = xtime(Tm); state[3][i] ^= Tm ^ Tmp;
+    }
+}
+
+void InvMixColumns(ui1 state[][4])
+{
+    int		i;
+    ui1	a, b, c, d;
+
+    for (i = 0; i < 4; i++) {
+        a = state[0][i];
+        b = state[1][i];
+        c = state[2][i];
+        d = state[3][i];
+        state[0][i] = Multiply(a, 0x0e) ^ Multiply(b, 0x0b) ^ Multiply(c, 0x0d) ^ Multiply(d, 0x09);
+        state[1][i] = Multiply(a, 0x09) ^ Multiply(b, 0x0e) ^ Multiply(c, 0x0b) ^ Multiply(d, 0x0d);
+        state[2][i] = Multiply(a, 0x0d) ^ Multiply(b, 0x09) ^ Multiply(c, 0x0e) ^ Multiply(d, 0x0b);
+        state[3][i] = Multiply(a, 0x0b) ^ Multiply(b, 0x0d) ^ Multiply(c, 0x09) ^ Multiply(d, 0x0e);
+    }
+}
+
+// Cipher encrypts one 16 byte block; in and out may alias.
+void Cipher(int Nr, const ui1 *in, ui1 *out, const ui1 *RoundKey)
+{
+    int	i, j, round;
+    ui1 state[4][4];
+
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            state[j][i] = in[i * 4 + j];
+
+    AddRoundKey(0, state, RoundKey);
+    for (round = 1; round < Nr; round++) {
+        SubBytes(state);
+        ShiftRows(state);
+        MixColumns(state);
+        AddRoundKey(round, state, RoundKey);
+    }
+    SubBytes(state);
+    ShiftRows(state);
+    AddRoundKey(Nr, state, RoundKey);
+
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            out[i * 4 + j] = state[j][i];
+}
+
+// InvCipher decrypts one 16 byte block; in and out may alias.
+void InvCipher(int Nr, const ui1 *in, ui1 *out, const ui1 *RoundKey)
+{
+    int	i, j, round;
+    ui1 state[4][4];
+
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            state[j][i] = in[i * 4 + j];
+
+    AddRoundKey(Nr, state, RoundKey);
+    for (round = Nr - 1; round > 0; round--) {
+        InvShiftRows(state);
+        InvSubBytes(state);
+        AddRoundKey(round, state, RoundKey);
+        InvMixColumns(state);
+    }
+    InvShiftRows(state);
+    InvSubBytes(state);
+    AddRoundKey(0, state, RoundKey);
+
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            out[i * 4 + j] = state[j][i];
+}
+
+void AES_decrypt(const ui1 *in, ui1 *out, const si1 *password)
+{
+    ui1	RoundKey[ENCRYPTION_KEY_LENGTH];
+
+    expand_key(password, RoundKey);
+    InvCipher(10, in, out, RoundKey);
+}
+
+// END --- AES_Encryption.c
+
+
+// BEGIN --- crc_32.c ---
+#define Koopman32		0xEB31D82E
+
+struct CrcTable {
+    ui4 v[256];
+    CrcTable() {
+        for (ui4 i = 0; i < 256; i++) {
+            ui4 crc = i;
+            for (int j = 0; j < 8; j++)
+                crc = (crc & 0x00000001) ? ((crc >> 1) ^ Koopman32) : (crc >> 1);
+            v[i] = crc;
+        }
+    }
+};
+
+// Built once, before main() runs, so there is no lazy-initialisation flag to race on.
+const CrcTable crc_table;
+
+inline ui4 update_crc_32(ui4 crc, ui1 c)
+{
+    return (crc >> 8) ^ crc_table.v[(crc ^ (ui4) c) & 0xff];
+}
+// END --- crc_32.c
+
+
+void strncpy2(si1 *s1, const si1 *s2, si4 n)
+{
+    si4      len;
+
+    for (len = 1; len < n; ++len) {
+        if ((*s1++ = *s2++))
+            continue;
+        return;
+    }
+    *s1 = 0;    // s1 already points at the last byte of the destination
+}
+
+template <typename T> T get_le(const ui1 *p)
+{
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+template <typename T> void put_le(ui1 *p, T v)
+{
+    memcpy(p, &v, sizeof(T));
+}
+
+ui1 cpu_endianness()
+{
+    ui2	x = 1;
+
+    return(*((ui1 *) &x));
+}
+
+//check password for validity - returns 1 for subject password, 2 for session password, 0 for no match
+si4 validate_password(const ui1 *header_block, const si1 *password)
+{
+    ui1	decrypted[ENCRYPTION_BLOCK_BYTES];
+    si1 temp_str[SESSION_PASSWORD_LENGTH];
+    si4	l;
+
+    if (strlen(password) >= ENCRYPTION_BLOCK_BYTES)
+        return(0);
+
+    // try password as subject pwd
+    AES_decrypt(header_block + SUBJECT_VALIDATION_FIELD_OFFSET, decrypted, password);
+    l = (si4) decrypted[0];
+    if (l < ENCRYPTION_BLOCK_BYTES) {
+        memcpy(temp_str, decrypted + 1, l);
+        temp_str[l] = 0;
+        if (strcmp(temp_str, password) == 0)
+            return(1);
+    }
+
+    // try using passed password to decrypt session encrypted key
+    AES_decrypt(header_block + SESSION_VALIDATION_FIELD_OFFSET, decrypted, password);
+    l = (si4) decrypted[0];
+    if (l < ENCRYPTION_BLOCK_BYTES) {
+        memcpy(temp_str, decrypted + 1, l);
+        temp_str[l] = 0;
+        if (strcmp(temp_str, password) == 0)
+            return(2);
+    }
+
+    return(0);
+}
+
+inline void dec_normalize(ui4 *range, ui4 *low_bound, ui1 *in_byte, const ui1 **ib_p)
+{
+    ui4 low, rng;
+    ui1 in;
+    const ui1 *ib;
+
+    low = *low_bound;
+    in = *in_byte;
+    rng = *range;
+    ib = *ib_p;
+
+    while (rng <= BOTTOM_VALUE)
+    {   low = (low << 8) | ((in << EXTRA_BITS) & 0xff);
+        in = *ib++;
+        low |= in >> (8 - EXTRA_BITS);
+        rng <<= 8;
+    }
+    *low_bound = low;
+    *in_byte = in;
+    *range = rng;
+    *ib_p = ib;
+}
+
+void enc_normalize(RANGE_STATS *rstats)
+{
+    while (rstats->range <= BOTTOM_VALUE) {
+        if (rstats->low_bound < (ui4) CARRY_CHECK) {		// no carry possible => output
+            *(rstats->ob_p++) = rstats->out_byte;
+            for(; rstats->underflow_bytes; rstats->underflow_bytes--)
+                *(rstats->ob_p++) = 0xff;
+            rstats->out_byte = (ui1) (rstats->low_bound >> SHIFT_BITS);
+        } else if (rstats->low_bound & TOP_VALUE) {		// carry now, no future carry
+            *(rstats->ob_p++) = rstats->out_byte + 1;
+            for(; rstats->underflow_bytes; rstats->underflow_bytes--)
+                *(rstats->ob_p++) = 0;
+            rstats->out_byte = (ui1) (rstats->low_bound >> SHIFT_BITS);
+        } else						// pass on a potential carry
+            rstats->underflow_bytes++;
+        rstats->range <<= 8;
+        rstats->low_bound = (rstats->low_bound << 8) & TOP_VALUE_M_1;
+    }
+}
+
+inline void encode_symbol(ui1 symbol, ui4 symbol_cnts, ui4 cnts_lt_symbol, ui4 tot_cnts, RANGE_STATS *rstats)
+{
+    ui4	r, tmp;
+
+    enc_normalize(rstats);
+    rstats->low_bound += (tmp = (r = rstats->range / tot_cnts) * cnts_lt_symbol);
+    if (symbol < 0xff)			// not last symbol
+        rstats->range = r * symbol_cnts;
+    else						// last symbol
+        rstats->range -= tmp;	// special case improves compression at expense of speed
+}
+
+void done_encoding(RANGE_STATS *rstats)
+{
+    ui4	tmp;
+
+    enc_normalize(rstats);
+
+    tmp = rstats->low_bound;
+    tmp = (tmp >> SHIFT_BITS) + 1;
+    if (tmp > 0xff) {
+        *(rstats->ob_p++) = rstats->out_byte + 1;
+        for(; rstats->underflow_bytes; rstats->underflow_bytes--)
+            *(rstats->ob_p++) = 0;
+    } else {
+        *(rstats->ob_p++) = rstats->out_byte;
+        for(; rstats->underflow_bytes; rstats->underflow_bytes--)
+            *(rstats->ob_p++) = 0xff;
+    }
+    *(rstats->ob_p++) = tmp & 0xff; *(rstats->ob_p++) = 0; *(rstats->ob_p++) = 0; *(rstats->ob_p++) = 0;
+}
+
+}  // anonymous namespace
+
+
+const char *error_string(si4 code)
+{
+    switch (code) {
+    case MEF_OK:           return "no error";
+    case MEF_ERR_OPEN:     return "could not open file";
+    case MEF_ERR_READ:     return "read error";
+    case MEF_ERR_FORMAT:   return "not a MEF 2 file";
+    case MEF_ERR_ENDIAN:   return "only little-endian files and hosts are supported";
+    case MEF_ERR_PASSWORD: return "password does not unlock the session fields";
+    case MEF_ERR_MEMORY:   return "out of memory";
+    case MEF_ERR_RANGE:    return "requested range is outside the file";
+    case MEF_ERR_CORRUPT:  return "inconsistent index or block header";
+    case MEF_ERR_OVERFLOW: return "samples exceed the range of the output type";
+    case MEF_ERR_WRITE:    return "could not write output file";
+    case MEF_ERR_SERVER:   return "mefd request failed";
+    case MEF_ERR_ALIGN:    return "segments do not line up in time with the other channels";
+    }
+    return "unknown error";
+}
+
+
+void expand_key(const si1 *password, ui1 *round_key)
+{
+    ui1	Key[16] = {0};
+
+    // password becomes the key (16 bytes, zero-padded if shorter, truncated if longer)
+    memcpy(Key, password, strnlen(password, 16));
+    AES_KeyExpansion(4, 10, round_key, Key);
+}
+
+
+si4 read_header_block(const ui1 *header_block, MEF_HEADER_INFO *header_struct, const si1 *password)
+{
+    MEF_HEADER_INFO	*hs;
+    si4		i, privileges, encrypted_segments, session_is_readable, subject_is_readable;
+    ui1		*dhbp, dhb[MEF_HEADER_LENGTH];
+    si1		expected[ENCRYPTION_ALGORITHM_LENGTH];
+    const si1	*encrypted_string = "encrypted";
+
+    if (header_struct == NULL || header_block == NULL)
+        return(MEF_ERR_FORMAT);
+    if (password == NULL)
+        password = "";
+
+    hs = header_struct;
+    subject_is_readable = 0; session_is_readable = 0;
+
+    if (header_block[HEADER_MAJOR_VERSION_OFFSET] != HEADER_MAJOR_VERSION)
+        return(MEF_ERR_FORMAT);
+
+    /* check to see if encryption algorithm matches that assumed by this function */
+    sprintf(expected, "%d-bit AES", ENCRYPTION_BLOCK_BITS);
+    if (strncmp((const si1 *) header_block + ENCRYPTION_ALGORITHM_OFFSET, expected, ENCRYPTION_ALGORITHM_LENGTH))
+        return(MEF_ERR_FORMAT);
+
+    memcpy(dhb, header_block, MEF_HEADER_LENGTH);
+    memset(header_struct, 0, sizeof(MEF_HEADER_INFO));
+
+    //read unencrypted fields
+    strncpy2(hs->institution, (si1 *) (dhb + INSTITUTION_OFFSET), INSTITUTION_LENGTH);
+    strncpy2(hs->unencrypted_text_field, (si1 *) (dhb + UNENCRYPTED_TEXT_FIELD_OFFSET), UNENCRYPTED_TEXT_FIELD_LENGTH);
+    strncpy2(hs->encryption_algorithm, (si1 *) (dhb + ENCRYPTION_ALGORITHM_OFFSET), ENCRYPTION_ALGORITHM_LENGTH);
+    hs->byte_order_code = *(dhb + BYTE_ORDER_CODE_OFFSET);
+    hs->header_version_major = *(dhb + HEADER_MAJOR_VERSION_OFFSET);
+    hs->header_version_minor = *(dhb + HEADER_MINOR_VERSION_OFFSET);
+    for (i = 0; i < SESSION_UNIQUE_ID_LENGTH; i++)
+        hs->session_unique_ID[i] = *(dhb + SESSION_UNIQUE_ID_OFFSET + i);
+
+    // Only little-endian files are decoded (as in decomp_mef); refuse anything else up front.
+    if (hs->byte_order_code != LITTLE_ENDIAN_CODE || cpu_endianness() != LITTLE_ENDIAN_CODE)
+        return(MEF_ERR_ENDIAN);
+
+    hs->header_length = get_le<ui2>(dhb + HEADER_LENGTH_OFFSET);
+    hs->subject_encryption_used = *(dhb + SUBJECT_ENCRYPTION_USED_OFFSET);
+    hs->session_encryption_used = *(dhb + SESSION_ENCRYPTION_USED_OFFSET);
+    hs->data_encryption_used = *(dhb + DATA_ENCRYPTION_USED_OFFSET);
+
+    if (hs->subject_encryption_used == 0) subject_is_readable = 1;
+    if (hs->session_encryption_used == 0) session_is_readable = 1;
+
+    privileges = 0;
+    if (*password && (hs->subject_encryption_used || hs->session_encryption_used))
+        privileges = validate_password(header_block, password);
+
+    if (hs->subject_encryption_used && (privileges == 1)) //subject encryption case
+    {
+        encrypted_segments = SUBJECT_ENCRYPTION_LENGTH / ENCRYPTION_BLOCK_BYTES;
+        dhbp = dhb + SUBJECT_ENCRYPTION_OFFSET;
+        for (i = encrypted_segments; i--;)
+        {
+            AES_decrypt(dhbp, dhbp, password);
+            dhbp += ENCRYPTION_BLOCK_BYTES;
+        }
+        subject_is_readable = 1;
+    }
+
+    if (subject_is_readable) {
+        strncpy2(hs->subject_first_name, (si1 *) (dhb + SUBJECT_FIRST_NAME_OFFSET), SUBJECT_FIRST_NAME_LENGTH);
+        strncpy2(hs->subject_second_name, (si1 *) (dhb + SUBJECT_SECOND_NAME_OFFSET), SUBJECT_SECOND_NAME_LENGTH);
+        strncpy2(hs->subject_third_name, (si1 *) (dhb + SUBJECT_THIRD_NAME_OFFSET), SUBJECT_THIRD_NAME_LENGTH);
+        strncpy2(hs->subject_id, (si1 *) (dhb + SUBJECT_ID_OFFSET), SUBJECT_ID_LENGTH);
+        if (hs->session_encryption_used && hs->subject_encryption_used) //if both subject and session encryptions used, session password should be in hdr
+            strncpy2(hs->session_password, (si1 *) (dhb + SESSION_PASSWORD_OFFSET), SESSION_PASSWORD_LENGTH);
+        else if (hs->session_encryption_used)
+            strncpy2(hs->session_password, password, SESSION_PASSWORD_LENGTH);
+    }
+    else {
+        strncpy2(hs->subject_first_name, encrypted_string, SUBJECT_FIRST_NAME_LENGTH);
+        strncpy2(hs->subject_second_name, encrypted_string, SUBJECT_SECOND_NAME_LENGTH);
+        strncpy2(hs->subject_third_name, encrypted_string, SUBJECT_THIRD_NAME_LENGTH);
+        strncpy2(hs->subject_id, encrypted_string, SUBJECT_ID_LENGTH);
+        strncpy2(hs->session_password, password, SESSION_PASSWORD_LENGTH); //session password must be passed in if no subject encryption used
+    }
+
+    if (hs->session_encryption_used && privileges > 0)
+    {
+        encrypted_segments = SESSION_ENCRYPTION_LENGTH / ENCRYPTION_BLOCK_BYTES;
+        dhbp = dhb + SESSION_ENCRYPTION_OFFSET;
+        for (i = encrypted_segments; i--;)
+        {
+            AES_decrypt(dhbp, dhbp, hs->session_password);
+            dhbp += ENCRYPTION_BLOCK_BYTES;
+        }
+        session_is_readable = 1;
+    }
+
+    if (!session_is_readable)
+        return(MEF_ERR_PASSWORD);
+
+    strncpy2(hs->channel_name, (si1 *) (dhb + CHANNEL_NAME_OFFSET), CHANNEL_NAME_LENGTH);
+    strncpy2(hs->acquisition_system, (si1 *) (dhb + ACQUISITION_SYSTEM_OFFSET), ACQUISITION_SYSTEM_LENGTH);
+    strncpy2(hs->channel_comments, (si1 *) (dhb + CHANNEL_COMMENTS_OFFSET), CHANNEL_COMMENTS_LENGTH);
+    strncpy2(hs->study_comments, (si1 *) (dhb + STUDY_COMMENTS_OFFSET), STUDY_COMMENTS_LENGTH);
+    strncpy2(hs->compression_algorithm, (si1 *) (dhb + COMPRESSION_ALGORITHM_OFFSET), COMPRESSION_ALGORITHM_LENGTH);
+
+    hs->number_of_samples = get_le<ui8>(dhb + NUMBER_OF_SAMPLES_OFFSET);
+    hs->recording_start_time = get_le<ui8>(dhb + RECORDING_START_TIME_OFFSET);
+    hs->recording_end_time = get_le<ui8>(dhb + RECORDING_END_TIME_OFFSET);
+    hs->sampling_frequency = get_le<sf8>(dhb + SAMPLING_FREQUENCY_OFFSET);
+    hs->low_frequency_filter_setting = get_le<sf8>(dhb + LOW_FREQUENCY_FILTER_SETTING_OFFSET);
+    hs->high_frequency_filter_setting = get_le<sf8>(dhb + HIGH_FREQUENCY_FILTER_SETTING_OFFSET);
+    hs->notch_filter_frequency = get_le<sf8>(dhb + NOTCH_FILTER_FREQUENCY_OFFSET);
+    hs->voltage_conversion_factor = get_le<sf8>(dhb + VOLTAGE_CONVERSION_FACTOR_OFFSET);
+    hs->block_interval = get_le<ui8>(dhb + BLOCK_INTERVAL_OFFSET);
+    hs->physical_channel_number = get_le<si4>(dhb + PHYSICAL_CHANNEL_NUMBER_OFFSET);
+    hs->maximum_compressed_block_size = get_le<ui4>(dhb + MAXIMUM_COMPRESSED_BLOCK_SIZE_OFFSET);
+    hs->maximum_block_length = get_le<ui8>(dhb + MAXIMUM_BLOCK_LENGTH_OFFSET);
+    hs->maximum_data_value = get_le<si4>(dhb + MAXIMUM_DATA_VALUE_OFFSET);
+    hs->minimum_data_value = get_le<si4>(dhb + MINIMUM_DATA_VALUE_OFFSET);
+    hs->index_data_offset = get_le<ui8>(dhb + INDEX_DATA_OFFSET_OFFSET);
+    hs->number_of_index_entries = get_le<ui8>(dhb + NUMBER_OF_INDEX_ENTRIES_OFFSET);
+    hs->block_header_length = get_le<ui2>(dhb + BLOCK_HEADER_LENGTH_OFFSET);
+    hs->GMT_offset = get_le<sf4>(dhb + GMT_OFFSET_OFFSET);
+    hs->discontinuity_data_offset = get_le<ui8>(dhb + DISCONTINUITY_DATA_OFFSET_OFFSET);
+    hs->number_of_discontinuity_entries = get_le<ui8>(dhb + NUMBER_OF_DISCONTINUITY_ENTRIES_OFFSET);
+
+    for (i = 0; i < FILE_UNIQUE_ID_LENGTH; i++)
+        hs->file_unique_ID[i] = *(dhb + FILE_UNIQUE_ID_OFFSET + i);
+    strncpy2(hs->anonymized_subject_name, (si1 *) (dhb + ANONYMIZED_SUBJECT_NAME_OFFSET), ANONYMIZED_SUBJECT_NAME_LENGTH);
+    hs->header_crc = get_le<ui4>(dhb + HEADER_CRC_OFFSET);
+
+    return(MEF_OK);
+}
+
+
+si4 read_block_header(const ui1 *block, RED_BLOCK_HDR_INFO *block_hdr)
+{
+    si4 max_data_value, min_data_value;
+
+    if (block == NULL || block_hdr == NULL)
+        return(MEF_ERR_CORRUPT);
+
+    // max and min are stored as si3; sign extend
+    max_data_value = (si4) (block[RED_DATA_MAX_OFFSET] | (block[RED_DATA_MAX_OFFSET + 1] << 8) | (block[RED_DATA_MAX_OFFSET + 2] << 16));
+    if (max_data_value & 0x00800000) max_data_value |= (si4) 0xFF000000;
+    min_data_value = (si4) (block[RED_DATA_MIN_OFFSET] | (block[RED_DATA_MIN_OFFSET + 1] << 8) | (block[RED_DATA_MIN_OFFSET + 2] << 16));
+    if (min_data_value & 0x00800000) min_data_value |= (si4) 0xFF000000;
+
+    block_hdr->CRC_32 = get_le<ui4>(block + RED_CHECKSUM_OFFSET);
+    block_hdr->compressed_bytes = get_le<si4>(block + RED_COMPRESSED_BYTE_COUNT_OFFSET);
+    block_hdr->block_start_time = get_le<ui8>(block + RED_UUTC_TIME_OFFSET);
+    block_hdr->difference_count = get_le<si4>(block + RED_DIFFERENCE_COUNT_OFFSET);
+    block_hdr->sample_count = get_le<si4>(block + RED_SAMPLE_COUNT_OFFSET);
+    block_hdr->max_value = max_data_value;
+    block_hdr->min_value = min_data_value;
+    block_hdr->discontinuity = block[RED_DISCONTINUITY_OFFSET];
+    block_hdr->CRC_validated = 0;
+
+    return(MEF_OK);
+}
+
+
+ui4 block_crc(const ui1 *block)
+{
+    ui4 checksum, block_len, i;
+
+    block_len = get_le<ui4>(block + RED_COMPRESSED_BYTE_COUNT_OFFSET) + BLOCK_HEADER_BYTES;
+    //skip first 4 bytes- don't include the CRC itself in calculation
+    checksum = 0xffffffff;
+    for (i = RED_CHECKSUM_LENGTH; i < block_len; i++)
+        checksum = update_crc_32(checksum, block[i]);
+
+    return checksum;
+}
+
+
+ui8 decompress_block(const ui1 *in_buffer, si4 *out_buffer, si1 *diff_buffer, const ui1 *key, RED_BLOCK_HDR_INFO *block_hdr)
+{
+    ui4	cc, cnts[256], cum_cnts[257], block_len, comp_block_len;
+    ui4	symbol, scaled_tot_cnts, tmp, range_per_cnt, diff_cnts;
+    ui1	*db_p, model[256];
+    const ui1 *ib_p;
+    si1	*si1_p1, *si1_p2;
+    si4	i, current_val, *ob_p;
+    ui4	low_bound;
+    ui4	range;
+    ui1	in_byte;
+    RED_BLOCK_HDR_INFO hdr;
+
+    /*** parse block header ***/
+    read_block_header(in_buffer, &hdr);
+    comp_block_len = (ui4) hdr.compressed_bytes;
+    diff_cnts = (ui4) hdr.difference_count;
+    block_len = (ui4) hdr.sample_count;
+    if (hdr.sample_count < 0 || hdr.difference_count < 0 || diff_cnts > 4 * block_len)
+        return(0);
+
+    StageTimer decode_timer(STAGE_RANGE_DECODE);
+    memcpy(model, in_buffer + RED_STAT_MODEL_OFFSET, 256);
+    if (key != NULL)
+        InvCipher(10, model, model, key);   // only the first 16 bytes of the model are encrypted
+    for (i = 0; i < 256; ++i) { cnts[i] = (ui4) model[i]; }
+
+    if (block_hdr != NULL)
+        *block_hdr = hdr;
+
+    /*** generate statistics ***/
+    cum_cnts[0] = 0;
+    for (i = 0; i < 256; ++i)
+        cum_cnts[i + 1] = cnts[i] + cum_cnts[i];
+    scaled_tot_cnts = cum_cnts[256];
+    if (scaled_tot_cnts == 0)
+        return(0);
+
+    /*** range decode ***/
+    diff_buffer[0] = -128; db_p = (ui1*) (diff_buffer + 1);	++diff_cnts;	// initial -128 not coded in encode (low frequency symbol)
+    ib_p = in_buffer + BLOCK_HEADER_BYTES + 1;	// skip initial dummy byte from encode
+    in_byte = *ib_p++;
+    low_bound = in_byte >> (8 - EXTRA_BITS);
+    range = (ui4) 1 << EXTRA_BITS;
+    for (i = diff_cnts; i--;) {
+        dec_normalize(&range, &low_bound, &in_byte, &ib_p);
+        tmp = low_bound / (range_per_cnt = range / scaled_tot_cnts);
+        cc = (tmp >= scaled_tot_cnts ? (scaled_tot_cnts - 1) : tmp);
+        if (cc > cum_cnts[128]) {
+            for (symbol = 255; cum_cnts[symbol] > cc; symbol--);
+        } else {
+            for (symbol = 1; cum_cnts[symbol] <= cc; symbol++);
+            --symbol;
+        }
+        low_bound -= (tmp = range_per_cnt * cum_cnts[symbol]);
+        if (symbol < 255)
+            range = range_per_cnt * cnts[symbol];
+        else
+            range -= tmp;
+        *db_p++ = symbol;
+    }
+
+    decode_timer.stop();
+
+    /*** generate output data from differences ***/
+    StageTimer reconstruct_timer(STAGE_DIFF_RECONSTRUCT);
+    si1_p1 = diff_buffer;
+    ob_p = out_buffer;
+    for (current_val = 0, i = block_len; i--;) {
+        if (*si1_p1 == -128) {					// assumes little endian input
+            si1_p2 = (si1 *) &current_val;
+            *si1_p2++ = *++si1_p1; *si1_p2++ = *++si1_p1; *si1_p2++ = *++si1_p1;
+            *si1_p2 = (*si1_p1++ < 0) ? -1 : 0;
+        } else
+            current_val += (si4) *si1_p1++;
+        *ob_p++ = current_val;
+    }
+    reconstruct_timer.stop();
+    stats_count(COUNTER_BLOCKS_DECODED, 1);
+    stats_count(COUNTER_SAMPLES_DECODED, block_len);
+
+    return(comp_block_len + BLOCK_HEADER_BYTES);
+}
+
+
+si4 read_header(const char *path, const char *password, MEF_HEADER_INFO *header)
+{
+    ui1 *hdr_block;
+    ssize_t n;
+    si4 err;
+    int fd;
+
+    StageTimer open_timer(STAGE_OPEN);
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return(MEF_ERR_OPEN);
+    hdr_block = (ui1 *) malloc(MEF_HEADER_LENGTH);
+    if (hdr_block == NULL) { ::close(fd); return(MEF_ERR_MEMORY); }
+    n = pread(fd, hdr_block, MEF_HEADER_LENGTH, 0);
+    ::close(fd);
+    if (n != MEF_HEADER_LENGTH) { free(hdr_block); return(MEF_ERR_READ); }
+    stats_count(COUNTER_BYTES_READ, MEF_HEADER_LENGTH);
+    open_timer.stop();
+
+    StageTimer header_timer(STAGE_HEADER_DECRYPT);
+    err = read_header_block(hdr_block, header, password);
+    free(hdr_block);
+    return(err);
+}
+
+
+ui8 compress_bound(ui4 sample_count)
+{
+    // at most 4 difference bytes per sample, and the scaled model costs under 9 bits per difference byte
+    return(BLOCK_HEADER_BYTES + (ui8) sample_count * 5 + 16);
+}
+
+
+ui8 compress_block(const si4 *in_buffer, ui4 num_entries, ui8 uUTC_time, ui1 discontinuity, const ui1 *key,
+                   ui1 *out_buffer, ui1 *diff_buffer, RED_BLOCK_HDR_INFO *block_hdr)
+{
+    ui4	cum_cnts[256], cnts[256], max_cnt, scaled_tot_cnts, extra_bytes;
+    ui4	diff_cnts, comp_block_len, comp_len, checksum;
+    ui1	*ui1_p1, *ehbp;
+    si1	*si1_p1;
+    si4	diff, max_data_value, min_data_value;
+    ui4	i;
+    sf8	stats_scale;
+    RANGE_STATS rng_st;
+
+    if (num_entries == 0)
+        return(0);
+
+    /*** generate differences ***/
+    max_data_value = min_data_value = in_buffer[0];
+    for (i = 1; i < num_entries; i++) {
+        if (in_buffer[i] > max_data_value) max_data_value = in_buffer[i];
+        else if (in_buffer[i] < min_data_value) min_data_value = in_buffer[i];
+    }
+    if (max_data_value > RED_MAX_VALUE || min_data_value < -RED_MAX_VALUE)
+        return(0);
+
+    si1_p1 = (si1 *) diff_buffer;
+    memcpy(si1_p1, in_buffer, 3); si1_p1 += 3;	// first entry is full value (3 bytes)
+    for (i = 1; i < num_entries; i++) {
+        diff = in_buffer[i] - in_buffer[i - 1];
+        if (diff > 127 || diff < -127) {			// little endian
+            *si1_p1++ = -128;
+            memcpy(si1_p1, in_buffer + i, 3); si1_p1 += 3;
+        } else
+            *si1_p1++ = (si1) diff;
+    }
+    diff_cnts = (ui4) (si1_p1 - (si1 *) diff_buffer);
+
+    /*** generate statistics ***/
+    memset((void *) cnts, 0, sizeof(cnts));
+    for (i = 0; i < diff_cnts; i++)
+        ++cnts[diff_buffer[i]];
+
+    max_cnt = 0;
+    for (i = 0; i < 256; ++i)
+        if (cnts[i] > max_cnt)
+            max_cnt = cnts[i];
+    if (max_cnt > 255) {
+        stats_scale = (sf8) 254.999 / (sf8) max_cnt;
+        for (i = 0; i < 256; ++i)
+            cnts[i] = (ui4) ceil((sf8) cnts[i] * stats_scale);
+    }
+    cum_cnts[0] = 0;
+    for (i = 0; i < 255; ++i)
+        cum_cnts[i + 1] = cnts[i] + cum_cnts[i];
+    scaled_tot_cnts = cnts[255] + cum_cnts[255];
+
+    /*** range encode ***/
+    rng_st.low_bound = rng_st.out_byte = rng_st.underflow_bytes = 0;
+    rng_st.range = TOP_VALUE;
+    rng_st.ob_p = out_buffer + BLOCK_HEADER_BYTES;
+    for (i = 0; i < diff_cnts; i++)
+        encode_symbol(diff_buffer[i], cnts[diff_buffer[i]], cum_cnts[diff_buffer[i]], scaled_tot_cnts, &rng_st);
+    done_encoding(&rng_st);
+
+    //ensure 8-byte alignment for next block
+    comp_len = (ui4) (rng_st.ob_p - out_buffer);
+    extra_bytes = 8 - comp_len % 8;
+    if (extra_bytes < 8) {
+        for (i = 0; i < extra_bytes; i++)
+            *(rng_st.ob_p++) = FILLER_BYTE;
+    }
+
+    /*** write the block header ***/
+    comp_block_len = (ui4) ((rng_st.ob_p - out_buffer) - BLOCK_HEADER_BYTES);
+    put_le<ui4>(out_buffer + RED_CHECKSUM_OFFSET, 0);
+    put_le<ui4>(out_buffer + RED_COMPRESSED_BYTE_COUNT_OFFSET, comp_block_len);
+    put_le<ui8>(out_buffer + RED_UUTC_TIME_OFFSET, uUTC_time);
+    put_le<ui4>(out_buffer + RED_DIFFERENCE_COUNT_OFFSET, diff_cnts);
+    put_le<ui4>(out_buffer + RED_SAMPLE_COUNT_OFFSET, num_entries);
+    memcpy(out_buffer + RED_DATA_MAX_OFFSET, &max_data_value, 3);	// max and min are stored as si3
+    memcpy(out_buffer + RED_DATA_MIN_OFFSET, &min_data_value, 3);
+    out_buffer[RED_DISCONTINUITY_OFFSET] = discontinuity;
+
+    ehbp = out_buffer + RED_STAT_MODEL_OFFSET;
+    for (i = 0, ui1_p1 = ehbp; i < 256; ++i)
+        *ui1_p1++ = (ui1) cnts[i];
+    if (key != NULL)
+        Cipher(10, ehbp, ehbp, key);	// only the first 16 bytes of the model are encrypted
+
+    //calculate CRC checksum and save in block header- skip first 4 bytes
+    checksum = 0xffffffff;
+    for (i = RED_CHECKSUM_LENGTH; i < comp_block_len + BLOCK_HEADER_BYTES; i++)
+        checksum = update_crc_32(checksum, out_buffer[i]);
+    put_le<ui4>(out_buffer + RED_CHECKSUM_OFFSET, checksum);
+
+    if (block_hdr != NULL) {
+        block_hdr->CRC_32 = checksum;
+        block_hdr->CRC_validated = 0;
+        block_hdr->compressed_bytes = (si4) comp_block_len;
+        block_hdr->block_start_time = uUTC_time;
+        block_hdr->difference_count = (si4) diff_cnts;
+        block_hdr->sample_count = (si4) num_entries;
+        block_hdr->max_value = max_data_value;
+        block_hdr->min_value = min_data_value;
+        block_hdr->discontinuity = discontinuity;
+    }
+
+    return(comp_block_len + BLOCK_HEADER_BYTES);
+}
+
+
+//
+//  MefChannel
+//
+
+MefChannel::MefChannel() : fd_(-1), data_encrypted_(false), cache_key_(0)
+{
+    memset(&header_, 0, sizeof(header_));
+    memset(key_, 0, sizeof(key_));
+}
+
+MefChannel::~MefChannel()
+{
+    close();
+}
+
+void MefChannel::close()
+{
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+    index_.clear();
+    discontinuities_.clear();
+}
+
+si4 MefChannel::open(const char *path, const char *password)
+{
+    ui1 *hdr_block;
+    si4 err;
+    ssize_t n;
+    size_t bytes;
+
+    close();
+    path_ = path;
+    StageTimer open_timer(STAGE_OPEN);
+    fd_ = ::open(path, O_RDONLY);
+    if (fd_ < 0)
+        return(MEF_ERR_OPEN);
+
+    // malloc to ensure boundary alignment
+    hdr_block = (ui1 *) malloc(MEF_HEADER_LENGTH);
+    if (hdr_block == NULL) { close(); return(MEF_ERR_MEMORY); }
+    n = pread(fd_, hdr_block, MEF_HEADER_LENGTH, 0);
+    if (n != MEF_HEADER_LENGTH) { free(hdr_block); close(); return(MEF_ERR_READ); }
+    stats_count(COUNTER_BYTES_READ, MEF_HEADER_LENGTH);
+    open_timer.stop();
+
+    StageTimer header_timer(STAGE_HEADER_DECRYPT);
+    err = read_header_block(hdr_block, &header_, password);
+    free(hdr_block);
+    header_timer.stop();
+    if (err) { close(); return(err); }
+
+    data_encrypted_ = header_.data_encryption_used != 0;
+    cache_key_ = shared_cache_file_key(&header_);
+    if (data_encrypted_) {
+        StageTimer key_timer(STAGE_KEY_EXPANSION);
+        expand_key(header_.session_password, key_);
+    }
+
+    /* read in index data */
+    StageTimer index_timer(STAGE_INDEX_LOAD);
+    try {
+        index_.resize(header_.number_of_index_entries);
+    } catch (...) {
+        close();
+        return(MEF_ERR_MEMORY);
+    }
+    bytes = index_.size() * sizeof(INDEX_DATA);
+    if (bytes > 0) {
+        n = pread(fd_, &index_[0], bytes, (off_t) header_.index_data_offset);
+        if (n < 0 || (size_t) n != bytes) { close(); return(MEF_ERR_READ); }
+        stats_count(COUNTER_BYTES_READ, bytes);
+    }
+    for (size_t b = 1; b < index_.size(); b++) {
+        if (index_[b].file_offset <= index_[b-1].file_offset || index_[b].sample_number < index_[b-1].sample_number) {
+            close();
+            return(MEF_ERR_CORRUPT);
+        }
+    }
+
+    err = load_discontinuities();
+    if (err) { close(); return(err); }
+
+    return(MEF_OK);
+}
+
+//
+//  Discontinuity flags, one per block. Written files carry a discontinuity index (one-based block numbers,
+//  as Ncs2Mef2 writes them); when it is absent the flags are derived from the block index exactly as
+//  write_mef_ind() does: a block whose start time disagrees with the previous block's sample count by more
+//  than half a block interval starts a new segment.
+//
+si4 MefChannel::load_discontinuities()
+{
+    ui8 n_blocks, n_entries, b;
+    sf8 ds, dt, tolerance;
+
+    n_blocks = index_.size();
+    discontinuities_.assign(n_blocks, 0);
+    if (n_blocks == 0)
+        return(MEF_OK);
+    discontinuities_[0] = 1;
+
+    n_entries = header_.number_of_discontinuity_entries;
+    if (n_entries > 0 && n_entries <= n_blocks && header_.discontinuity_data_offset > 0) {
+        std::vector<ui8> entries(n_entries);
+        ssize_t n = pread(fd_, &entries[0], n_entries * sizeof(ui8), (off_t) header_.discontinuity_data_offset);
+        if (n >= 0 && (ui8) n == n_entries * sizeof(ui8)) {
+            stats_count(COUNTER_BYTES_READ, n_entries * sizeof(ui8));
+            bool zero_based = std::find(entries.begin(), entries.end(), (ui8) 0) != entries.end();
+            for (ui8 i = 0; i < n_entries; i++) {
+                b = zero_based ? entries[i] : entries[i] - 1;
+                if (b < n_blocks)
+                    discontinuities_[b] = 1;
+            }
+            return(MEF_OK);
+        }
+    }
+
+    tolerance = (sf8) header_.block_interval / 2.0;
+    for (b = 1; b < n_blocks; b++) {
+        ds = (sf8) (index_[b].sample_number - index_[b-1].sample_number);
+        dt = (sf8) (index_[b].time - index_[b-1].time);
+        if (fabs(dt - 1000000.0 * ds / header_.sampling_frequency) > tolerance)
+            discontinuities_[b] = 1;
+    }
+    return(MEF_OK);
+}
+
+ui8 MefChannel::block_samples(ui8 b) const
+{
+    if (b + 1 < index_.size())
+        return index_[b+1].sample_number - index_[b].sample_number;
+    return header_.number_of_samples - index_[b].sample_number;
+}
+
+ui8 MefChannel::block_bytes(ui8 b) const
+{
+    if (b + 1 < index_.size())
+        return index_[b+1].file_offset - index_[b].file_offset;
+    return header_.index_data_offset - index_[b].file_offset;
+}
+
+ui8 MefChannel::block_end_time(ui8 b) const
+{
+    return index_[b].time + (ui8) (0.5 + 1000000.0 * (sf8) block_samples(b) / header_.sampling_frequency);
+}
+
+ui8 MefChannel::block_of_sample(ui8 s) const
+{
+    size_t lo = 0, hi = index_.size();
+
+    // last block whose first sample is <= s
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (index_[mid].sample_number <= s) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+ui8 MefChannel::block_of_time(ui8 t) const
+{
+    size_t lo = 0, hi = index_.size();
+
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (index_[mid].time <= t) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+ui8 MefChannel::sample_of_time(ui8 t) const
+{
+    ui8 b = block_of_time(t);
+
+    if (t <= index_[b].time)
+        return index_[b].sample_number;
+    return index_[b].sample_number + (ui8) ceil((sf8) (t - index_[b].time) * header_.sampling_frequency / 1000000.0 - 1e-9);
+}
+
+ui8 MefChannel::time_of_sample(ui8 s) const
+{
+    ui8 b = block_of_sample(s);
+
+    return index_[b].time + (ui8) (0.5 + 1000000.0 * (sf8) (s - index_[b].sample_number) / header_.sampling_frequency);
+}
+
+std::vector<MEF_SEGMENT> MefChannel::segments() const
+{
+    std::vector<MEF_SEGMENT> segs;
+    ui8 b, n_blocks;
+    MEF_SEGMENT seg;
+
+    n_blocks = index_.size();
+    for (b = 0; b < n_blocks; b++) {
+        if (b == 0 || discontinuities_[b]) {
+            if (b > 0) segs.push_back(seg);
+            seg.first_block = b;
+            seg.first_sample = index_[b].sample_number;
+            seg.start_time = index_[b].time;
+        }
+        seg.last_block = b;
+        seg.last_sample = index_[b].sample_number + block_samples(b) - 1;
+        seg.end_time = block_end_time(b);
+    }
+    if (n_blocks > 0)
+        segs.push_back(seg);
+
+    return segs;
+}
+
+std::vector<MEF_SEGMENT> MefChannel::segments(ui8 time0, ui8 time1) const
+{
+    std::vector<MEF_SEGMENT> all = segments(), keep;
+
+    for (size_t i = 0; i < all.size(); i++)
+        if (all[i].end_time > time0 && all[i].start_time <= time1)
+            keep.push_back(all[i]);
+    return keep;
+}
+
+bool MefChannel::clip_segment(const MEF_SEGMENT &segment, ui8 time0, ui8 time1, ui8 *s0, ui8 *s1) const
+{
+    ui8 first, after;
+
+    if (time1 < time0 || segment.end_time <= time0 || segment.start_time > time1)
+        return false;
+    first = time0 <= segment.start_time ? segment.first_sample : std::max(segment.first_sample, sample_of_time(time0));
+    after = time1 >= segment.end_time ? segment.last_sample + 1 : std::min(segment.last_sample + 1, sample_of_time(time1 + 1));
+    if (first >= after)
+        return false;
+    *s0 = first;
+    *s1 = after - 1;
+    return true;
+}
+
+si4 MefChannel::read_blocks(ui8 b0, ui8 b1, std::vector<ui1> &buffer) const
+{
+    ui8 offset, bytes;
+    ssize_t n;
+
+    if (b0 > b1 || b1 >= index_.size())
+        return(MEF_ERR_RANGE);
+    offset = index_[b0].file_offset;
+    bytes = index_[b1].file_offset + block_bytes(b1) - offset;
+    try {
+        buffer.resize(bytes);
+    } catch (...) {
+        return(MEF_ERR_MEMORY);
+    }
+    StageTimer read_timer(STAGE_BLOCK_READ);
+    n = pread(fd_, &buffer[0], bytes, (off_t) offset);
+    if (n < 0 || (ui8) n != bytes)
+        return(MEF_ERR_READ);
+    stats_count(COUNTER_BYTES_READ, bytes);
+    return(MEF_OK);
+}
+
+si4 MefChannel::read_block_headers(ui8 b0, ui8 b1, std::vector<RED_BLOCK_HDR_INFO> &headers) const
+{
+    ui8 b, first, last, page, map_offset, map_bytes;
+    struct stat st;
+    ui1 *map;
+
+    if (b0 > b1 || b1 >= index_.size())
+        return(MEF_ERR_RANGE);
+    // a header beyond the end of the file (a bad index entry, a truncated file) would SIGBUS in the mapping
+    if (fstat(fd_, &st) != 0)
+        return(MEF_ERR_READ);
+    for (b = b0; b <= b1; b++)
+        if (block_bytes(b) < BLOCK_HEADER_BYTES || index_[b].file_offset + BLOCK_HEADER_BYTES > (ui8) st.st_size)
+            return(MEF_ERR_CORRUPT);
+
+    StageTimer read_timer(STAGE_BLOCK_READ);
+    page = (ui8) sysconf(_SC_PAGESIZE);
+    first = index_[b0].file_offset;
+    last = index_[b1].file_offset + BLOCK_HEADER_BYTES;
+    map_offset = first - first % page;
+    map_bytes = last - map_offset;
+    map = (ui1 *) mmap(NULL, map_bytes, PROT_READ, MAP_PRIVATE, fd_, (off_t) map_offset);
+    if (map == MAP_FAILED)
+        return(MEF_ERR_READ);
+    // only the header pages are touched; no readahead into the compressed data between them
+    madvise(map, map_bytes, MADV_RANDOM);
+
+    headers.resize(b1 - b0 + 1);
+    for (b = b0; b <= b1; b++)
+        read_block_header(map + (index_[b].file_offset - map_offset), &headers[b - b0]);
+
+    munmap(map, map_bytes);
+    stats_count(COUNTER_BYTES_READ, (b1 - b0 + 1) * BLOCK_HEADER_BYTES);
+    return(MEF_OK);
+}
+
+si4 MefChannel::decode_blocks(ui8 b0, ui8 b1, si4 *out) const
+{
+    std::vector<SHARED_CACHE_CLAIM> claims;
+    ui8 b, end, d, first;
+    bool hit;
+    si4 err;
+
+    if (!shared_cache_attached())
+        return decode_blocks_uncached(b0, b1, out);
+    if (b0 > b1 || b1 >= index_.size())
+        return(MEF_ERR_RANGE);
+
+    // copy in what the shared cache holds; claim each run of misses (so that other processes wait for it
+    // instead of decoding it too), decode the run with one read and publish it
+    first = index_[b0].sample_number;
+    for (b = b0; b <= b1; b = end) {
+        if (shared_cache_lookup(cache_key_, b, (ui4) block_samples(b), out + (index_[b].sample_number - first))) {
+            end = b + 1;
+            continue;
+        }
+        claims.assign(1, shared_cache_claim(cache_key_, b, (ui4) block_samples(b)));
+        hit = false;
+        for (end = b + 1; end <= b1 && end - b < SHARED_CACHE_RUN_BLOCKS; end++) {
+            if ((hit = shared_cache_lookup(cache_key_, end, (ui4) block_samples(end), out + (index_[end].sample_number - first))))
+                break;
+            claims.push_back(shared_cache_claim(cache_key_, end, (ui4) block_samples(end)));
+        }
+        err = decode_blocks_uncached(b, end - 1, out + (index_[b].sample_number - first));
+        for (d = b; d < end; d++)
+            shared_cache_publish(claims[d - b], err == MEF_OK ? out + (index_[d].sample_number - first) : NULL);
+        if (err != MEF_OK)
+            return(err);
+        if (hit)
+            end++;
+    }
+    return(MEF_OK);
+}
+
+si4 MefChannel::decode_blocks_uncached(ui8 b0, ui8 b1, si4 *out) const
+{
+    std::vector<ui1> comp;
+    si4 err;
+
+    err = read_blocks(b0, b1, comp);
+    if (err)
+        return(err);
+    return decode_buffer(b0, b1, &comp[0], out);
+}
+
+si4 MefChannel::decode_buffer(ui8 b0, ui8 b1, const ui1 *comp, si4 *out) const
+{
+    std::vector<si1> diff_buffer;
+    RED_BLOCK_HDR_INFO block_hdr;
+    ui8 b, base, used;
+
+    if (b0 > b1 || b1 >= index_.size())
+        return(MEF_ERR_RANGE);
+    diff_buffer.resize(4 * header_.maximum_block_length + 8);
+
+    base = index_[b0].file_offset;
+    for (b = b0; b <= b1; b++) {
+        const ui1 *p = &comp[index_[b].file_offset - base];
+        if (block_bytes(b) < BLOCK_HEADER_BYTES)
+            return(MEF_ERR_CORRUPT);
+        read_block_header(p, &block_hdr);
+        if ((ui8) block_hdr.sample_count != block_samples(b) || (ui8) block_hdr.sample_count > header_.maximum_block_length
+            || (ui8) block_hdr.compressed_bytes + BLOCK_HEADER_BYTES > block_bytes(b))
+            return(MEF_ERR_CORRUPT);
+        used = decompress_block(p, out, &diff_buffer[0], data_key(), NULL);
+        if (used == 0)
+            return(MEF_ERR_CORRUPT);
+        out += block_hdr.sample_count;
+    }
+    return(MEF_OK);
+}
+
+si4 MefChannel::read_samples(ui8 s0, ui8 s1, si4 *out) const
+{
+    std::vector<si4> tmp;
+    ui8 b0, b1, first;
+    si4 err;
+
+    if (s0 > s1 || s1 >= header_.number_of_samples || index_.empty())
+        return(MEF_ERR_RANGE);
+    b0 = block_of_sample(s0);
+    b1 = block_of_sample(s1);
+    first = index_[b0].sample_number;
+
+    // whole blocks can be decoded in place; partial ones go through a bounce buffer
+    if (first == s0 && index_[b1].sample_number + block_samples(b1) - 1 == s1)
+        return decode_blocks(b0, b1, out);
+
+    tmp.resize(index_[b1].sample_number + block_samples(b1) - first);
+    err = decode_blocks(b0, b1, &tmp[0]);
+    if (err)
+        return(err);
+    StageTimer copy_timer(STAGE_OUTPUT_COPY);
+    memcpy(out, &tmp[s0 - first], (s1 - s0 + 1) * sizeof(si4));
+    return(MEF_OK);
+}
+
+si4 MefChannel::read_times(ui8 time0, ui8 time1, std::vector<si4> &out, std::vector<ui8> *starts) const
+{
+    std::vector<MEF_SEGMENT> segs = segments(time0, time1);
+    ui8 s0, s1, total;
+    size_t i;
+    si4 err;
+
+    out.clear();
+    if (starts != NULL)
+        starts->clear();
+    total = 0;
+    for (i = 0; i < segs.size(); i++)
+        if (clip_segment(segs[i], time0, time1, &s0, &s1))
+            total += s1 - s0 + 1;
+    try {
+        out.resize(total);
+    } catch (...) {
+        return(MEF_ERR_MEMORY);
+    }
+
+    total = 0;
+    for (i = 0; i < segs.size(); i++) {
+        if (!clip_segment(segs[i], time0, time1, &s0, &s1))
+            continue;
+        err = read_samples(s0, s1, &out[total]);
+        if (err)
+            return(err);
+        if (starts != NULL)
+            starts->push_back(s0);
+        total += s1 - s0 + 1;
+    }
+    return(MEF_OK);
+}
+
+sf8 MefChannel::microvolts_per_unit() const
+{
+    return header_.voltage_conversion_factor != 0.0 ? header_.voltage_conversion_factor : 1.0;
+}
+
+namespace {
+
+  template <class T> si4 read_microvolts_into(const MefChannel &channel, ui8 s0, ui8 s1, T *out)
+  {
+    SampleReader reader(channel, s0, s1);
+    sf8 scale = channel.microvolts_per_unit();
+    ui8 n = s1 - s0 + 1, done = 0;
+    size_t k;
+
+    while (done < n && (k = reader.read(out + done, n - done, scale)) > 0)
+        done += k;
+    if (reader.error())
+        return(reader.error());
+    return(done == n ? MEF_OK : MEF_ERR_CORRUPT);
+  }
+
+}
+
+si4 MefChannel::read_microvolts(ui8 s0, ui8 s1, sf4 *out) const
+{
+    return read_microvolts_into(*this, s0, s1, out);
+}
+
+si4 MefChannel::read_microvolts(ui8 s0, ui8 s1, sf8 *out) const
+{
+    return read_microvolts_into(*this, s0, s1, out);
+}
+
+si4 MefChannel::block_range(ui8 b0, ui8 b1, si4 *minimum, si4 *maximum) const
+{
+    std::vector<RED_BLOCK_HDR_INFO> headers;
+    si4 err;
+
+    if (b0 > b1 || b1 >= index_.size())
+        return(MEF_ERR_RANGE);
+    if (header_.minimum_data_value >= SHRT_MIN && header_.maximum_data_value <= SHRT_MAX) {
+        *minimum = header_.minimum_data_value;
+        *maximum = header_.maximum_data_value;
+        return(MEF_OK);
+    }
+    if ((err = read_block_headers(b0, b1, headers)) != MEF_OK)
+        return(err);
+    *minimum = INT_MAX;
+    *maximum = INT_MIN;
+    for (size_t i = 0; i < headers.size(); i++) {
+        *minimum = std::min(*minimum, headers[i].min_value);
+        *maximum = std::max(*maximum, headers[i].max_value);
+    }
+    return(MEF_OK);
+}
+
+si4 MefChannel::read_int16(ui8 s0, ui8 s1, si2 *out, bool saturate, ui8 *clipped) const
+{
+    si4 minimum, maximum, err;
+    ui8 n, done = 0, count = 0;
+    size_t k;
+
+    if (s0 > s1 || s1 >= header_.number_of_samples || index_.empty())
+        return(MEF_ERR_RANGE);
+    if (!saturate) {
+        if ((err = block_range(block_of_sample(s0), block_of_sample(s1), &minimum, &maximum)) != MEF_OK)
+            return(err);
+        if (minimum < SHRT_MIN || maximum > SHRT_MAX)
+            return(MEF_ERR_OVERFLOW);
+    }
+
+    SampleReader reader(*this, s0, s1);
+    n = s1 - s0 + 1;
+    while (done < n && (k = reader.read(out + done, n - done, &count)) > 0)
+        done += k;
+    if (clipped)
+        *clipped = count;
+    if (reader.error())
+        return(reader.error());
+    return(done == n ? MEF_OK : MEF_ERR_CORRUPT);
+}
+
+
+//
+//  SampleReader
+//
+
+#define READER_BATCH_SAMPLES    65536
+
+SampleReader::SampleReader(const MefChannel &channel, ui8 s0, ui8 s1)
+    : channel_(channel), next_(s0), last_(s1), next_block_(0), decoded_first_(0), err_(MEF_OK)
+{
+    if (s0 > s1 || s1 >= channel.header().number_of_samples || channel.number_of_blocks() == 0)
+        err_ = MEF_ERR_RANGE;
+    else
+        next_block_ = channel.block_of_sample(s0);
+}
+
+si4 SampleReader::fill()
+{
+    ui8 b0, b1, n;
+
+    b0 = next_block_;
+    n = channel_.block_samples(b0);
+    for (b1 = b0; b1 + 1 < channel_.number_of_blocks() && channel_.index()[b1 + 1].sample_number <= last_
+         && n + channel_.block_samples(b1 + 1) <= READER_BATCH_SAMPLES; b1++)
+        n += channel_.block_samples(b1 + 1);
+
+    decoded_.resize(n);
+    decoded_first_ = channel_.index()[b0].sample_number;
+    next_block_ = b1 + 1;
+    return channel_.decode_blocks(b0, b1, &decoded_[0]);
+}
+
+size_t SampleReader::read(si4 *out, size_t n)
+{
+    size_t copied = 0, k;
+
+    while (copied < n && next_ <= last_ && err_ == MEF_OK) {
+        if (decoded_.empty() || next_ >= decoded_first_ + decoded_.size()) {
+            if ((err_ = fill()) != MEF_OK)
+                break;
+        }
+        k = std::min((ui8) (n - copied), std::min(last_ + 1, decoded_first_ + decoded_.size()) - next_);
+        memcpy(out + copied, &decoded_[next_ - decoded_first_], k * sizeof(si4));
+        copied += k;
+        next_ += k;
+    }
+    return copied;
+}
+
+namespace {
+
+  // Eight independent lanes per step, free of aliasing, so the compiler maps the body onto vector
+  // conversions and multiplies even at -O2.
+  template <class T> void scale_samples(const si4 * __restrict in, T * __restrict out, size_t n, T scale)
+  {
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+        for (size_t j = 0; j < 8; j++)
+            out[i + j] = (T) in[i + j] * scale;
+    for (; i < n; i++)
+        out[i] = (T) in[i] * scale;
+  }
+
+}
+
+template <class T> size_t SampleReader::read_scaled(T *out, size_t n, sf8 scale)
+{
+    size_t copied = 0, k;
+
+    while (copied < n && next_ <= last_ && err_ == MEF_OK) {
+        if (decoded_.empty() || next_ >= decoded_first_ + decoded_.size()) {
+            if ((err_ = fill()) != MEF_OK)
+                break;
+        }
+        k = std::min((ui8) (n - copied), std::min(last_ + 1, decoded_first_ + decoded_.size()) - next_);
+        scale_samples(&decoded_[next_ - decoded_first_], out + copied, k, (T) scale);
+        copied += k;
+        next_ += k;
+    }
+    return copied;
+}
+
+size_t SampleReader::read(sf4 *out, size_t n, sf8 scale)
+{
+    return read_scaled(out, n, scale);
+}
+
+size_t SampleReader::read(sf8 *out, size_t n, sf8 scale)
+{
+    return read_scaled(out, n, scale);
+}
+
+// Same eight-lane shape as scale_samples; the clamp compiles to packed min/max.
+ui8 narrow_samples(const si4 * __restrict in, si2 * __restrict out, size_t n)
+{
+    size_t i = 0;
+    ui8 clipped = 0;
+    si4 v;
+
+    for (; i + 8 <= n; i += 8)
+        for (size_t j = 0; j < 8; j++) {
+            v = in[i + j];
+            clipped += (v < SHRT_MIN) | (v > SHRT_MAX);
+            out[i + j] = (si2) std::min(std::max(v, (si4) SHRT_MIN), (si4) SHRT_MAX);
+        }
+    for (; i < n; i++) {
+        v = in[i];
+        clipped += (v < SHRT_MIN) | (v > SHRT_MAX);
+        out[i] = (si2) std::min(std::max(v, (si4) SHRT_MIN), (si4) SHRT_MAX);
+    }
+    return clipped;
+}
+
+size_t SampleReader::read(si2 *out, size_t n, ui8 *clipped)
+{
+    size_t copied = 0, k;
+
+    while (copied < n && next_ <= last_ && err_ == MEF_OK) {
+        if (decoded_.empty() || next_ >= decoded_first_ + decoded_.size()) {
+            if ((err_ = fill()) != MEF_OK)
+                break;
+        }
+        k = std::min((ui8) (n - copied), std::min(last_ + 1, decoded_first_ + decoded_.size()) - next_);
+        *clipped += narrow_samples(&decoded_[next_ - decoded_first_], out + copied, k);
+        copied += k;
+        next_ += k;
+    }
+    return copied;
+}
+
+
+//
+//  BlockCache
+//
+
+BlockCache::BlockCache(const MefChannel &channel, size_t capacity)
+    : channel_(channel), capacity_(std::max(capacity, (size_t) 1)), clock_(0), err_(MEF_OK)
+{
+}
+
+const si4 *BlockCache::block(ui8 b)
+{
+    size_t i, victim = 0;
+
+    clock_++;
+    for (i = 0; i < entries_.size(); i++) {
+        if (entries_[i].block == b) {
+            entries_[i].last_use = clock_;
+            stats_count(COUNTER_CACHE_HITS, 1);
+            return &entries_[i].samples[0];
+        }
+        if (entries_[i].last_use < entries_[victim].last_use)
+            victim = i;
+    }
+
+    stats_count(COUNTER_CACHE_MISSES, 1);
+    if (entries_.size() < capacity_) {
+        entries_.resize(entries_.size() + 1);
+        victim = entries_.size() - 1;
+    }
+    CACHED_BLOCK &entry = entries_[victim];
+    entry.block = b;
+    entry.last_use = clock_;
+    entry.samples.resize(std::max(channel_.block_samples(b), (ui8) 1));
+    if ((err_ = channel_.decode_blocks(b, b, &entry.samples[0])) != MEF_OK) {
+        entry.last_use = 0;
+        entry.block = (ui8) -1;
+        return NULL;
+    }
+    return &entry.samples[0];
+}
+
+si4 BlockCache::read(ui8 s0, size_t n, si4 *out)
+{
+    ui8 b, first, k;
+    const si4 *samples;
+
+    if (n == 0)
+        return(MEF_OK);
+    if (s0 + n > channel_.header().number_of_samples)
+        return(MEF_ERR_RANGE);
+    while (n > 0) {
+        b = channel_.block_of_sample(s0);
+        if ((samples = block(b)) == NULL)
+            return(err_);
+        first = channel_.index()[b].sample_number;
+        k = std::min((ui8) n, first + channel_.block_samples(b) - s0);
+        memcpy(out, samples + (s0 - first), k * sizeof(si4));
+        out += k;
+        s0 += k;
+        n -= k;
+    }
+    return(MEF_OK);
+}
+
+}
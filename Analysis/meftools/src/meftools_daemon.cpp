@@ -0,0 +1,777 @@
+/*
+		meftools_daemon.cpp
+
+ mefd server and client. See meftools_daemon.h for the protocol.
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <algorithm>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "../inst/include/meftools_daemon.h"
+#include "../inst/include/meftools_stats.h"
+#include "../inst/include/meftools_trace.h"
+
+#define DAEMON_BACKLOG          64
+#define DAEMON_MAX_LINE         (16 << 20)  // longest request or reply line (epoch lists can be long)
+#define DAEMON_PART_SAMPLES     (16 << 20)  // most samples in one reply file (64 MB); larger replies are split
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL            0           // macOS has no MSG_NOSIGNAL; mefd ignores SIGPIPE instead
+#endif
+
+namespace meftools {
+
+namespace {
+
+  si4 send_all(int fd, const char *buffer, size_t bytes)
+  {
+    ssize_t n;
+
+    while (bytes > 0) {
+      n = send(fd, buffer, bytes, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return(MEF_ERR_SERVER);
+      buffer += n;
+      bytes -= (size_t) n;
+    }
+    return(MEF_OK);
+  }
+
+  // Send a reply line, with fd attached to its first byte when fd >= 0.
+  si4 send_reply(int sock, const std::string &line, int fd)
+  {
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char control[CMSG_SPACE(sizeof(int))];
+    ssize_t n;
+
+    if (fd < 0)
+      return send_all(sock, line.data(), line.size());
+
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    iov.iov_base = (void *) line.data();
+    iov.iov_len = line.size();
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    do {
+      n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0)
+      return(MEF_ERR_SERVER);
+    return send_all(sock, line.data() + n, line.size() - (size_t) n);
+  }
+
+  // Read one line (without its newline) into line; a descriptor arriving with it goes to *fd.
+  si4 receive_line(int sock, std::string &buffered, std::string &line, int *fd)
+  {
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char control[CMSG_SPACE(sizeof(int))];
+    char chunk[65536];
+    size_t end;
+    ssize_t n;
+
+    while ((end = buffered.find('\n')) == std::string::npos) {
+      if (buffered.size() > DAEMON_MAX_LINE)
+        return(MEF_ERR_SERVER);
+      memset(&msg, 0, sizeof(msg));
+      iov.iov_base = chunk;
+      iov.iov_len = sizeof(chunk);
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      n = recvmsg(sock, &msg, 0);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return(MEF_ERR_SERVER);
+      for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+          continue;
+        int received;
+        memcpy(&received, CMSG_DATA(cmsg), sizeof(int));
+        if (fd != NULL && *fd < 0) {
+          fcntl(received, F_SETFD, FD_CLOEXEC);
+          *fd = received;
+        }
+        else
+          close(received);    // unexpected descriptors are not kept open
+      }
+      buffered.append(chunk, (size_t) n);
+    }
+    line.assign(buffered, 0, end);
+    buffered.erase(0, end + 1);
+    return(MEF_OK);
+  }
+
+  std::vector<std::string> split(const std::string &s, char separator)
+  {
+    std::vector<std::string> fields;
+    size_t start = 0, end;
+
+    while ((end = s.find(separator, start)) != std::string::npos) {
+      fields.push_back(s.substr(start, end - start));
+      start = end + 1;
+    }
+    fields.push_back(s.substr(start));
+    return fields;
+  }
+
+  bool parse_ui8(const std::string &s, ui8 *value)
+  {
+    char *end;
+
+    if (s.empty() || s[0] == '-')
+      return false;
+    errno = 0;
+    *value = strtoul(s.c_str(), &end, 10);
+    return errno == 0 && *end == 0;
+  }
+
+  //
+  //  Decoded blocks of every open channel, least recently used first out. A block that is being decoded
+  //  is already in the table as a pending future, so concurrent requests for it wait for that one decode
+  //  instead of starting their own.
+  //
+  typedef struct {
+    std::vector<si4> samples;
+    si4 err;
+  } DECODED_BLOCK;
+
+  typedef std::shared_ptr<const DECODED_BLOCK> DecodedBlockPtr;
+
+  class DecodedBlockCache {
+  public:
+    explicit DecodedBlockCache(size_t capacity_bytes) : capacity_(capacity_bytes), bytes_(0) {}
+
+    DecodedBlockPtr block(const MefChannel &channel, ui8 b)
+    {
+      Key key(&channel, b);
+      std::shared_future<DecodedBlockPtr> pending;
+      std::promise<DecodedBlockPtr> promise;
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<Key, Entry>::iterator it = entries_.find(key);
+        if (it != entries_.end()) {
+          lru_.splice(lru_.begin(), lru_, it->second.lru);
+          stats_count(COUNTER_CACHE_HITS, 1);
+          pending = it->second.value;
+        } else {
+          stats_count(COUNTER_CACHE_MISSES, 1);
+          Entry &entry = entries_[key];
+          entry.value = promise.get_future().share();
+          entry.bytes = channel.block_samples(b) * sizeof(si4);
+          lru_.push_front(key);
+          entry.lru = lru_.begin();
+          bytes_ += entry.bytes;
+          evict();
+        }
+      }
+      if (pending.valid())
+        return pending.get();
+
+      std::shared_ptr<DECODED_BLOCK> decoded(new DECODED_BLOCK);
+      try {
+        decoded->samples.resize(std::max(channel.block_samples(b), (ui8) 1));
+        decoded->err = channel.decode_blocks(b, b, &decoded->samples[0]);
+      } catch (...) {
+        decoded->err = MEF_ERR_MEMORY;
+      }
+      promise.set_value(decoded);
+      if (decoded->err) {
+        // do not keep failures around; the next request tries again
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<Key, Entry>::iterator it = entries_.find(key);
+        if (it != entries_.end() && it->second.value.wait_for(std::chrono::seconds(0)) == std::future_status::ready
+            && it->second.value.get() == decoded)
+          erase(it);
+      }
+      return decoded;
+    }
+
+    void counts(size_t *blocks, size_t *bytes)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      *blocks = entries_.size();
+      *bytes = bytes_;
+    }
+
+  private:
+    typedef std::pair<const MefChannel *, ui8> Key;
+    typedef struct {
+      std::shared_future<DecodedBlockPtr> value;
+      std::list<Key>::iterator lru;
+      size_t bytes;
+    } Entry;
+
+    void erase(std::map<Key, Entry>::iterator it)
+    {
+      bytes_ -= it->second.bytes;
+      lru_.erase(it->second.lru);
+      entries_.erase(it);
+    }
+
+    // Callers hold mutex_. Waiters keep their own reference to an evicted block, so nothing is freed
+    // under them.
+    void evict()
+    {
+      while (bytes_ > capacity_ && lru_.size() > 1)
+        erase(entries_.find(lru_.back()));
+    }
+
+    std::mutex mutex_;
+    size_t capacity_;
+    size_t bytes_;
+    std::map<Key, Entry> entries_;
+    std::list<Key> lru_;
+  };
+
+  //
+  //  Channels stay open for the daemon's lifetime, keyed by path and password.
+  //
+  class ChannelTable {
+  public:
+    si4 get(const std::string &path, const std::string &password, std::shared_ptr<MefChannel> *channel)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::string key = path + '\t' + password;
+      std::map<std::string, std::shared_ptr<MefChannel> >::iterator it = channels_.find(key);
+      si4 err;
+
+      if (it != channels_.end()) {
+        *channel = it->second;
+        return(MEF_OK);
+      }
+      std::shared_ptr<MefChannel> opened(new MefChannel);
+      if ((err = opened->open(path.c_str(), password.c_str())) != MEF_OK)
+        return(err);
+      channels_[key] = opened;
+      *channel = opened;
+      return(MEF_OK);
+    }
+
+    size_t size()
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return channels_.size();
+    }
+
+  private:
+    std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<MefChannel> > channels_;
+  };
+
+  typedef struct {
+    DecodedBlockCache *cache;
+    ChannelTable *channels;
+  } DAEMON_STATE;
+
+  // Give a reply file all of its blocks up front. A sparse tmpfs file that cannot grow when it is written
+  // through a mapping kills the writer with SIGBUS, so running out of space has to show up here instead.
+  int reserve(int fd, size_t bytes)
+  {
+#if defined(__linux__)
+    return posix_fallocate(fd, 0, (off_t) bytes);
+#else
+    static const char zeros[65536] = { 0 };
+    size_t done, k;
+    ssize_t n;
+
+    for (done = 0; done < bytes; done += (size_t) n) {
+      k = std::min(bytes - done, sizeof(zeros));
+      n = pwrite(fd, zeros, k, (off_t) done);
+      if (n < 0 && errno == EINTR) {
+        n = 0;
+        continue;
+      }
+      if (n <= 0)
+        return n < 0 ? errno : ENOSPC;
+    }
+    return 0;
+#endif
+  }
+
+  // An anonymous shared-memory file of the given size, returned as an fd. It is created in /dev/shm (tmpfs)
+  // where there is one and unlinked at once, which needs neither librt nor Linux-only memfd_create.
+  // On failure returns -1 with the reason in *error.
+  int shared_memory(size_t bytes, int *error)
+  {
+    struct stat st;
+    char name[64];
+    int fd;
+
+    snprintf(name, sizeof(name), "%s/mefd.XXXXXX", stat("/dev/shm", &st) == 0 ? "/dev/shm" : "/tmp");
+    fd = mkstemp(name);
+    if (fd < 0) {
+      *error = errno;
+      return -1;
+    }
+    unlink(name);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if ((*error = reserve(fd, bytes)) != 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  // Copy samples [s0, s1] of channel into out through the cache.
+  si4 copy_piece(DecodedBlockCache &cache, const MefChannel &channel, ui8 s0, ui8 s1, si4 *out)
+  {
+    ui8 b, first, k;
+
+    while (s0 <= s1) {
+      b = channel.block_of_sample(s0);
+      DecodedBlockPtr decoded = cache.block(channel, b);
+      if (decoded->err)
+        return(decoded->err);
+      first = channel.index()[b].sample_number;
+      k = std::min(s1 + 1, first + channel.block_samples(b)) - s0;
+      memcpy(out, &decoded->samples[s0 - first], k * sizeof(si4));
+      out += k;
+      s0 += k;
+    }
+    return(MEF_OK);
+  }
+
+  typedef struct {
+    std::shared_ptr<MefChannel> channel;
+    std::string path;
+    std::vector<std::pair<ui8, ui8> > pieces;   // sample ranges, in reply order
+    ui8 total;
+  } DAEMON_PLAN;
+
+  // Work out which samples answer one request line. Returns the whole reply line for stats requests and
+  // errors, or an empty string when the samples in plan are to be sent.
+  std::string plan_request(DAEMON_STATE &state, const std::string &request, DAEMON_PLAN &plan)
+  {
+    std::vector<std::string> f = split(request, '\t');
+    std::vector<std::pair<ui8, ui8> > &pieces = plan.pieces;
+    std::ostringstream reply;
+    ui8 a, b;
+    si4 err;
+    size_t i;
+
+    if (f[0] == "stats") {
+      size_t blocks, bytes;
+      MEF_STATS stats;
+      state.cache->counts(&blocks, &bytes);
+      stats_snapshot(&stats);
+      reply << "OK\t0\tchannels=" << state.channels->size() << ",blocks=" << blocks << ",bytes=" << bytes
+            << ",hits=" << stats.counters[COUNTER_CACHE_HITS] << ",misses=" << stats.counters[COUNTER_CACHE_MISSES] << "\n";
+      return reply.str();
+    }
+    if (!((f[0] == "samples" || f[0] == "times") && f.size() == 5) && !(f[0] == "epochs" && f.size() == 6))
+      return "ERR\tmalformed request\n";
+    if (!parse_ui8(f[3], &a) || !parse_ui8(f[4], &b))
+      return "ERR\tmalformed request\n";
+
+    if ((err = state.channels->get(f[1], f[2], &plan.channel)) != MEF_OK)
+      return "ERR\t" + f[1] + ": " + error_string(err) + "\n";
+    plan.path = f[1];
+    const MefChannel &ch = *plan.channel;
+    ui8 n_samples = ch.header().number_of_samples;
+    if (n_samples == 0 || ch.number_of_blocks() == 0)
+      return "ERR\t" + f[1] + ": " + error_string(MEF_ERR_RANGE) + "\n";
+
+    if (f[0] == "samples") {
+      if (a > b || b >= n_samples)
+        return "ERR\t" + f[1] + ": " + error_string(MEF_ERR_RANGE) + "\n";
+      pieces.push_back(std::make_pair(a, b));
+    } else if (f[0] == "times") {
+      std::vector<MEF_SEGMENT> segs = ch.segments(a, b);
+      ui8 s0, s1;
+      for (i = 0; i < segs.size(); i++)
+        if (ch.clip_segment(segs[i], a, b, &s0, &s1))
+          pieces.push_back(std::make_pair(s0, s1));
+    } else {
+      // epochs: a = pre, b = post samples around each time
+      std::vector<std::string> times = split(f[5], ',');
+      ui8 t, s;
+      for (i = 0; i < times.size(); i++) {
+        if (!parse_ui8(times[i], &t))
+          return "ERR\tmalformed request\n";
+        s = ch.sample_of_time(t);
+        if (s < a || s + b >= n_samples)
+          return "ERR\t" + f[1] + ": epoch at " + times[i] + " runs outside the file\n";
+        pieces.push_back(std::make_pair(s - a, s + b));
+      }
+    }
+
+    plan.total = 0;
+    for (i = 0; i < pieces.size(); i++)
+      plan.total += pieces[i].second - pieces[i].first + 1;
+    return "";
+  }
+
+  // Copy the next k samples of plan, from piece *i at sample *s, into a new reply file. Returns its
+  // descriptor, or -1 with the ERR line in *line.
+  int fill_part(DAEMON_STATE &state, const DAEMON_PLAN &plan, size_t *i, ui8 *s, ui8 k, std::string *line)
+  {
+    size_t bytes = k * sizeof(si4);
+    ui8 done, n;
+    si4 *out, err = MEF_OK;
+    int fd, error;
+
+    if ((fd = shared_memory(bytes, &error)) < 0) {
+      if (error == ENOSPC || error == EFBIG)
+        *line = "ERR\tnot enough shared memory for a reply of " + std::to_string((ui8) bytes) + " bytes\n";
+      else
+        *line = std::string("ERR\tcould not create shared memory: ") + strerror(error) + "\n";
+      return -1;
+    }
+    out = (si4 *) mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (out == (si4 *) MAP_FAILED) {
+      close(fd);
+      *line = "ERR\tcould not map shared memory\n";
+      return -1;
+    }
+    for (done = 0; done < k && err == MEF_OK; done += n) {
+      const std::pair<ui8, ui8> &piece = plan.pieces[*i];
+      n = std::min(piece.second - *s + 1, k - done);
+      err = copy_piece(*state.cache, *plan.channel, *s, *s + n - 1, out + done);
+      *s += n;
+      if (*s > piece.second && ++*i < plan.pieces.size())
+        *s = plan.pieces[*i].first;
+    }
+    munmap(out, bytes);
+    if (err) {
+      close(fd);
+      *line = "ERR\t" + plan.path + ": " + error_string(err) + "\n";
+      return -1;
+    }
+    return fd;
+  }
+
+  // Send the samples of plan in reply files of at most DAEMON_PART_SAMPLES each: a "MORE <k>" line per
+  // full part, then the OK line with the rest. An ERR line ends the reply early.
+  si4 send_samples(DAEMON_STATE &state, int sock, const DAEMON_PLAN &plan)
+  {
+    TraceSpan span("serve_request", "mefd", (si8) plan.total);
+    std::ostringstream reply;
+    std::string line;
+    ui8 sent = 0, k, s = plan.pieces.empty() ? 0 : plan.pieces[0].first;
+    size_t i = 0;
+    si4 err;
+    int fd;
+
+    for (;;) {
+      k = std::min<ui8>(plan.total - sent, DAEMON_PART_SAMPLES);
+      fd = -1;
+      if (k > 0 && (fd = fill_part(state, plan, &i, &s, k, &line)) < 0)
+        return send_reply(sock, line, -1);
+      sent += k;
+      if (sent == plan.total)
+        break;
+      err = send_reply(sock, "MORE\t" + std::to_string(k) + "\n", fd);
+      close(fd);
+      if (err)
+        return(err);
+    }
+
+    reply << "OK\t" << plan.total << "\t";
+    for (i = 0; i < plan.pieces.size(); i++)
+      reply << (i ? "," : "") << plan.pieces[i].first;
+    reply << "\n";
+    err = send_reply(sock, reply.str(), fd);
+    if (fd >= 0)
+      close(fd);
+    return(err);
+  }
+
+  void serve_connection(DAEMON_STATE *state, int sock)
+  {
+    std::string buffered, request, line;
+    si4 err;
+
+    while (receive_line(sock, buffered, request, NULL) == MEF_OK) {
+      DAEMON_PLAN plan;
+      line = plan_request(*state, request, plan);
+      err = line.empty() ? send_samples(*state, sock, plan) : send_reply(sock, line, -1);
+      if (err)
+        break;
+    }
+    close(sock);
+  }
+
+  si4 connect_to(const char *socket_path, int *sock)
+  {
+    struct sockaddr_un addr;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+      return(MEF_ERR_SERVER);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    *sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (*sock < 0)
+      return(MEF_ERR_SERVER);
+    if (connect(*sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+      close(*sock);
+      *sock = -1;
+      return(MEF_ERR_SERVER);
+    }
+    return(MEF_OK);
+  }
+
+  bool valid_field(const char *s)
+  {
+    return strchr(s, '\t') == NULL && strchr(s, '\n') == NULL;
+  }
+
+}
+
+
+//
+//  Client
+//
+
+DaemonReply::DaemonReply() : data_(NULL), n_(0)
+{
+}
+
+DaemonReply::~DaemonReply()
+{
+    release();
+}
+
+void DaemonReply::release()
+{
+    if (data_ != NULL && parts_.empty())
+        munmap((void *) data_, n_ * sizeof(si4));
+    std::vector<si4>().swap(parts_);
+    data_ = NULL;
+    n_ = 0;
+    starts_.clear();
+    message_.clear();
+}
+
+namespace {
+
+  // Append the k samples of a reply file to parts.
+  si4 append_part(int fd, ui8 k, std::vector<si4> &parts)
+  {
+    void *map = mmap(NULL, k * sizeof(si4), PROT_READ, MAP_SHARED, fd, 0);
+
+    if (map == MAP_FAILED)
+        return(MEF_ERR_SERVER);
+    try {
+        parts.insert(parts.end(), (const si4 *) map, (const si4 *) map + k);
+    } catch (...) {
+        munmap(map, k * sizeof(si4));
+        return(MEF_ERR_MEMORY);
+    }
+    munmap(map, k * sizeof(si4));
+    return(MEF_OK);
+  }
+
+}
+
+si4 daemon_request(const char *socket_path, const std::string &request, DaemonReply &reply)
+{
+    std::string buffered, line;
+    std::vector<std::string> f;
+    int sock, fd = -1;
+    si4 err;
+    ui8 n, start;
+    void *map;
+    size_t i;
+
+    reply.release();
+    if ((err = connect_to(socket_path, &sock)) != MEF_OK) {
+        reply.message_ = std::string("cannot connect to ") + socket_path;
+        return(err);
+    }
+    err = send_all(sock, (request + "\n").data(), request.size() + 1);
+    // a large reply comes in parts: "MORE <k>" lines, each with a file of k samples, before the OK line
+    while (err == MEF_OK) {
+        fd = -1;
+        if ((err = receive_line(sock, buffered, line, &fd)) != MEF_OK)
+            break;
+        f = split(line, '\t');
+        if (f[0] != "MORE")
+            break;
+        if (f.size() != 2 || !parse_ui8(f[1], &n) || n == 0 || fd < 0)
+            err = MEF_ERR_SERVER;
+        else
+            err = append_part(fd, n, reply.parts_);
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+    close(sock);
+    if (err) {
+        if (fd >= 0)
+            close(fd);
+        std::vector<si4>().swap(reply.parts_);
+        reply.message_ = err == MEF_ERR_MEMORY ? error_string(err) : "no reply from mefd";
+        return(err);
+    }
+
+    if (f[0] != "OK" || f.size() != 3 || !parse_ui8(f[1], &n) || n < reply.parts_.size()) {
+        if (fd >= 0)
+            close(fd);
+        std::vector<si4>().swap(reply.parts_);
+        reply.message_ = f[0] == "ERR" && f.size() > 1 ? line.substr(4) : "malformed reply from mefd";
+        return(MEF_ERR_SERVER);
+    }
+    reply.message_ = f[2];
+    if (n > reply.parts_.size()) {
+        if (fd < 0)
+            err = MEF_ERR_SERVER;
+        else if (reply.parts_.empty()) {
+            map = mmap(NULL, n * sizeof(si4), PROT_READ, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED)
+                err = MEF_ERR_SERVER;
+            else {
+                reply.data_ = (const si4 *) map;
+                reply.n_ = n;
+            }
+        } else
+            err = append_part(fd, n - reply.parts_.size(), reply.parts_);
+    }
+    if (fd >= 0)
+        close(fd);
+    if (err) {
+        std::vector<si4>().swap(reply.parts_);
+        reply.message_ = err == MEF_ERR_MEMORY ? error_string(err) : "could not map mefd reply";
+        return(err);
+    }
+    if (!reply.parts_.empty()) {
+        reply.data_ = &reply.parts_[0];
+        reply.n_ = reply.parts_.size();
+    }
+
+    if (!f[2].empty() && request.compare(0, 5, "stats") != 0) {
+        std::vector<std::string> starts = split(f[2], ',');
+        for (i = 0; i < starts.size(); i++)
+            if (parse_ui8(starts[i], &start))
+                reply.starts_.push_back(start);
+    }
+    return(MEF_OK);
+}
+
+si4 daemon_read_samples(const char *socket_path, const char *path, const char *password, ui8 s0, ui8 s1,
+                        DaemonReply &reply)
+{
+    std::ostringstream request;
+
+    if (!valid_field(path) || !valid_field(password))
+        return(MEF_ERR_OPEN);
+    request << "samples\t" << path << "\t" << password << "\t" << s0 << "\t" << s1;
+    return daemon_request(socket_path, request.str(), reply);
+}
+
+si4 daemon_read_times(const char *socket_path, const char *path, const char *password, ui8 time0, ui8 time1,
+                      DaemonReply &reply)
+{
+    std::ostringstream request;
+
+    if (!valid_field(path) || !valid_field(password))
+        return(MEF_ERR_OPEN);
+    request << "times\t" << path << "\t" << password << "\t" << time0 << "\t" << time1;
+    return daemon_request(socket_path, request.str(), reply);
+}
+
+si4 daemon_read_epochs(const char *socket_path, const char *path, const char *password,
+                       const std::vector<ui8> &times, ui8 pre, ui8 post, DaemonReply &reply)
+{
+    std::ostringstream request;
+    size_t i;
+
+    if (!valid_field(path) || !valid_field(password))
+        return(MEF_ERR_OPEN);
+    if (times.empty())
+        return(MEF_ERR_RANGE);
+    request << "epochs\t" << path << "\t" << password << "\t" << pre << "\t" << post << "\t";
+    for (i = 0; i < times.size(); i++)
+        request << (i ? "," : "") << times[i];
+    return daemon_request(socket_path, request.str(), reply);
+}
+
+
+//
+//  Server
+//
+
+si4 daemon_serve(const char *socket_path, size_t cache_bytes)
+{
+    struct sockaddr_un addr;
+    int listener, sock;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+        return(MEF_ERR_SERVER);
+
+    // refuse to take over the socket of a daemon that is still answering; a stale one is removed
+    if (connect_to(socket_path, &sock) == MEF_OK) {
+        close(sock);
+        return(MEF_ERR_SERVER);
+    }
+    unlink(socket_path);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        return(MEF_ERR_SERVER);
+    if (bind(listener, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(listener, DAEMON_BACKLOG) != 0) {
+        close(listener);
+        return(MEF_ERR_SERVER);
+    }
+
+    // connection threads are detached, so the shared state lives as long as the process
+    DAEMON_STATE *state = new DAEMON_STATE;
+    state->cache = new DecodedBlockCache(cache_bytes);
+    state->channels = new ChannelTable;
+    for (;;) {
+        sock = accept(listener, NULL, NULL);
+        if (sock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno == EMFILE || errno == ENFILE) {
+                usleep(10000);    // out of descriptors: wait for connections to close
+                continue;
+            }
+            break;
+        }
+        std::thread(serve_connection, state, sock).detach();
+    }
+    close(listener);
+    return(MEF_ERR_SERVER);
+}
+
+}
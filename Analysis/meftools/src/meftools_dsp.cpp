@@ -0,0 +1,571 @@
+/*
+		meftools_dsp.cpp
+
+ Second-order-section IIR filtering, Butterworth design and streaming zero-phase filtering of MEF
+ segments. See meftools_dsp.h.
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "../inst/include/meftools_dsp.h"
+
+namespace meftools {
+
+//
+//  SosFilter
+//
+
+SosFilter::SosFilter(const std::vector<sf8> &sos) : coef_(sos)
+{
+    for (size_t s = 0; s + 5 < coef_.size(); s += 6) {
+        sf8 a0 = coef_[s + 3];
+        for (int k = 0; k < 6; k++)
+            coef_[s + k] /= a0;
+    }
+    coef_.resize(6 * (coef_.size() / 6));
+    state_.assign(2 * sections(), 0.0);
+}
+
+void SosFilter::reset()
+{
+    std::fill(state_.begin(), state_.end(), 0.0);
+}
+
+void SosFilter::process(sf8 *x, size_t n)
+{
+    for (size_t s = 0; s < sections(); s++) {
+        const sf8 *c = &coef_[6 * s];
+        sf8 b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[4], a2 = c[5];
+        sf8 z1 = state_[2 * s], z2 = state_[2 * s + 1];
+        for (size_t i = 0; i < n; i++) {
+            sf8 in = x[i];
+            sf8 out = b0 * in + z1;
+            z1 = b1 * in - a1 * out + z2;
+            z2 = b2 * in - a2 * out;
+            x[i] = out;
+        }
+        state_[2 * s] = z1; state_[2 * s + 1] = z2;
+    }
+}
+
+void SosFilter::process_reverse(sf8 *x, size_t n)
+{
+    for (size_t s = 0; s < sections(); s++) {
+        const sf8 *c = &coef_[6 * s];
+        sf8 b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[4], a2 = c[5];
+        sf8 z1 = state_[2 * s], z2 = state_[2 * s + 1];
+        for (size_t i = n; i--;) {
+            sf8 in = x[i];
+            sf8 out = b0 * in + z1;
+            z1 = b1 * in - a1 * out + z2;
+            z2 = b2 * in - a2 * out;
+            x[i] = out;
+        }
+        state_[2 * s] = z1; state_[2 * s + 1] = z2;
+    }
+}
+
+size_t SosFilter::settle_samples(sf8 tolerance) const
+{
+    sf8 r, radius = 0.0;
+
+    // largest pole radius over all sections: roots of z^2 + a1 z + a2
+    for (size_t s = 0; s < sections(); s++) {
+        sf8 a1 = coef_[6 * s + 4], a2 = coef_[6 * s + 5];
+        sf8 disc = a1 * a1 - 4.0 * a2;
+        if (disc < 0.0)
+            r = sqrt(a2);
+        else
+            r = std::max(fabs((-a1 + sqrt(disc)) / 2.0), fabs((-a1 - sqrt(disc)) / 2.0));
+        radius = std::max(radius, r);
+    }
+    if (radius <= 0.0)
+        return 1;
+    if (radius >= 1.0)
+        return 1 << 20;     // not stable; pad as much as is sensible
+    return (size_t) ceil(log(tolerance) / log(radius));
+}
+
+
+//
+//  Butterworth design
+//
+
+std::vector<sf8> butterworth_sos(si4 order, sf8 low, sf8 high, sf8 fs)
+{
+    typedef std::complex<sf8> cplx;
+    std::vector<sf8> sos;
+    std::vector<cplx> s_poles, z_poles;
+    sf8 nyquist = fs / 2.0, two_fs = 2.0 * fs, w_ref;
+    bool lowpass = false, highpass = false;
+    si4 k;
+
+    if (order < 1 || fs <= 0.0)
+        return sos;
+    if (low <= 0.0)
+        lowpass = true;
+    else if (high <= 0.0 || high >= nyquist)
+        highpass = true;
+    if ((lowpass && (high <= 0.0 || high >= nyquist)) || (!lowpass && low >= nyquist) || (!lowpass && !highpass && low >= high))
+        return sos;
+
+    // pre-warped analog corners (rad/s)
+    sf8 wl = lowpass ? 0.0 : two_fs * tan(M_PI * low / fs);
+    sf8 wh = highpass ? 0.0 : two_fs * tan(M_PI * high / fs);
+
+    for (k = 0; k < order; k++) {
+        cplx p = std::polar(1.0, M_PI * (2.0 * k + order + 1) / (2.0 * order));
+        if (lowpass)
+            s_poles.push_back(wh * p);
+        else if (highpass)
+            s_poles.push_back(wl / p);
+        else {
+            sf8 w0 = sqrt(wl * wh), bw = wh - wl;
+            cplx h = p * bw / 2.0;
+            cplx d = std::sqrt(h * h - w0 * w0);
+            s_poles.push_back(h + d);
+            s_poles.push_back(h - d);
+        }
+    }
+    for (size_t i = 0; i < s_poles.size(); i++)
+        z_poles.push_back((two_fs + s_poles[i]) / (two_fs - s_poles[i]));
+
+    // response is normalised to 1 at DC, Nyquist or the geometric band centre
+    w_ref = lowpass ? 0.0 : highpass ? M_PI : 2.0 * atan(sqrt(wl * wh) / two_fs);
+    cplx z_ref = std::polar(1.0, w_ref);
+
+    // one section per conjugate pair (upper half plane), then real poles two at a time
+    std::vector<cplx> complex_poles;
+    std::vector<sf8> real_poles;
+    for (size_t i = 0; i < z_poles.size(); i++) {
+        if (fabs(z_poles[i].imag()) <= 1e-12)
+            real_poles.push_back(z_poles[i].real());
+        else if (z_poles[i].imag() > 0.0)
+            complex_poles.push_back(z_poles[i]);
+    }
+
+    std::vector< std::vector<sf8> > sections;
+    for (size_t i = 0; i < complex_poles.size(); i++) {
+        sf8 a[3] = { 1.0, -2.0 * complex_poles[i].real(), std::norm(complex_poles[i]) };
+        sections.push_back(std::vector<sf8>(a, a + 3));
+    }
+    for (size_t i = 0; i < real_poles.size(); i += 2) {
+        if (i + 1 < real_poles.size()) {
+            sf8 a[3] = { 1.0, -(real_poles[i] + real_poles[i + 1]), real_poles[i] * real_poles[i + 1] };
+            sections.push_back(std::vector<sf8>(a, a + 3));
+        } else {
+            sf8 a[3] = { 1.0, -real_poles[i], 0.0 };
+            sections.push_back(std::vector<sf8>(a, a + 3));
+        }
+    }
+
+    for (size_t i = 0; i < sections.size(); i++) {
+        const std::vector<sf8> &a = sections[i];
+        bool first_order = a[2] == 0.0;
+        sf8 b[3];
+        // zeros: z = -1 for the low-pass edge, z = +1 for the high-pass edge, one of each for a band-pass
+        if (lowpass) { b[0] = 1.0; b[1] = first_order ? 1.0 : 2.0; b[2] = first_order ? 0.0 : 1.0; }
+        else if (highpass) { b[0] = 1.0; b[1] = first_order ? -1.0 : -2.0; b[2] = first_order ? 0.0 : 1.0; }
+        else { b[0] = 1.0; b[1] = 0.0; b[2] = -1.0; }
+
+        cplx zi = 1.0 / z_ref, zi2 = zi * zi;
+        sf8 gain = std::abs((a[0] + a[1] * zi + a[2] * zi2) / (b[0] + b[1] * zi + b[2] * zi2));
+        sos.push_back(b[0] * gain); sos.push_back(b[1] * gain); sos.push_back(b[2] * gain);
+        sos.push_back(a[0]); sos.push_back(a[1]); sos.push_back(a[2]);
+    }
+    return sos;
+}
+
+
+//
+//  FFT
+//
+
+size_t fft_length(size_t n)
+{
+    size_t m = 1;
+
+    while (m < n)
+        m <<= 1;
+    return m;
+}
+
+void fft(std::complex<sf8> *x, size_t n, bool inverse)
+{
+    size_t i, j, k, len;
+
+    // bit reversal
+    for (i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            std::swap(x[i], x[j]);
+    }
+
+    for (len = 2; len <= n; len <<= 1) {
+        sf8 angle = (inverse ? 2.0 : -2.0) * M_PI / (sf8) len;
+        std::complex<sf8> w_len(cos(angle), sin(angle));
+        for (i = 0; i < n; i += len) {
+            std::complex<sf8> w(1.0, 0.0);
+            for (k = 0; k < len / 2; k++) {
+                std::complex<sf8> u = x[i + k], v = x[i + k + len / 2] * w;
+                x[i + k] = u + v;
+                x[i + k + len / 2] = u - v;
+                w *= w_len;
+            }
+        }
+    }
+}
+
+
+//
+//  Welch PSD
+//
+
+WelchEstimator::WelchEstimator(size_t length, size_t hop, sf8 sampling_frequency)
+    : length_(std::max(length, (size_t) 2)), hop_(std::max(hop, (size_t) 1)), fs_(sampling_frequency), window_power_(0.0)
+{
+    nfft_ = fft_length(length_);
+    window_.resize(length_);
+    for (size_t i = 0; i < length_; i++) {
+        // periodic Hann, as scipy.signal.welch uses
+        window_[i] = 0.5 - 0.5 * cos(2.0 * M_PI * (sf8) i / (sf8) length_);
+        window_power_ += window_[i] * window_[i];
+    }
+    spectrum_.resize(nfft_);
+}
+
+void WelchEstimator::add_segment(const sf8 *x, WelchSum &acc)
+{
+    sf8 mean = 0.0;
+    size_t i;
+
+    for (i = 0; i < length_; i++)
+        mean += x[i];
+    mean /= (sf8) length_;
+    for (i = 0; i < length_; i++)
+        spectrum_[i] = std::complex<sf8>((x[i] - mean) * window_[i], 0.0);
+    for (; i < nfft_; i++)
+        spectrum_[i] = 0.0;
+    fft(&spectrum_[0], nfft_, false);
+    if (acc.sum.empty())
+        acc.sum.assign(bins(), 0.0);
+    for (i = 0; i < acc.sum.size(); i++)
+        acc.sum[i] += std::norm(spectrum_[i]);
+    acc.count++;
+}
+
+si4 WelchEstimator::add_range(const MefChannel &channel, ui8 s0, ui8 s1, WelchSum &acc)
+{
+    std::vector<si4> raw;
+    std::vector<sf8> buffer;
+    ui8 base = s0, w;
+    size_t n;
+
+    if (s1 < s0 || s1 - s0 + 1 < length_)
+        return(MEF_OK);
+    SampleReader reader(channel, s0, s1);
+    if (reader.error())
+        return(reader.error());
+    raw.resize(std::max(length_, (size_t) 65536));
+
+    for (w = s0; w + length_ - 1 <= s1; w += hop_) {
+        if (w > base) {
+            size_t drop = std::min((ui8) buffer.size(), w - base);
+            buffer.erase(buffer.begin(), buffer.begin() + drop);
+            base += drop;
+            while (base < w) {
+                n = reader.read(&raw[0], std::min((ui8) raw.size(), w - base));
+                if (n == 0)
+                    return(reader.error() ? reader.error() : MEF_ERR_CORRUPT);
+                base += n;
+            }
+        }
+        while (buffer.size() < length_) {
+            n = reader.read(&raw[0], raw.size());
+            if (n == 0)
+                return(reader.error() ? reader.error() : MEF_ERR_CORRUPT);
+            buffer.insert(buffer.end(), raw.begin(), raw.begin() + n);
+        }
+        add_segment(&buffer[0], acc);
+    }
+    return(MEF_OK);
+}
+
+void WelchEstimator::psd(const WelchSum &acc, sf8 *out) const
+{
+    size_t k, last = bins() - 1;
+    sf8 scale;
+
+    for (k = 0; k < bins(); k++) {
+        if (acc.count == 0 || acc.sum.size() != bins()) {
+            out[k] = NAN;
+            continue;
+        }
+        scale = 1.0 / (fs_ * window_power_ * (sf8) acc.count);
+        out[k] = acc.sum[k] * scale * ((k == 0 || k == last) ? 1.0 : 2.0);
+    }
+}
+
+
+//
+//  Polyphase resampler
+//
+
+namespace {
+
+  // Zeroth-order modified Bessel function of the first kind, for the Kaiser window.
+  sf8 bessel_i0(sf8 x)
+  {
+    sf8 sum = 1.0, term = 1.0;
+
+    for (si4 k = 1; k < 64 && term > 1e-17 * sum; k++) {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+    }
+    return sum;
+  }
+
+  si4 gcd(si4 a, si4 b)
+  {
+    while (b) {
+      si4 t = a % b;
+      a = b;
+      b = t;
+    }
+    return a;
+  }
+
+}
+
+PolyphaseResampler::PolyphaseResampler(si4 up, si4 down, FilteredSink &out)
+    : base_(0), received_(0), next_out_(0), first_(0.0), last_(0.0), out_(out)
+{
+    si4 g, max_rate;
+    si8 k, taps;
+    sf8 cutoff, beta = 5.0, sum = 0.0;
+    std::vector<sf8> h;
+
+    up = std::max(up, 1);
+    down = std::max(down, 1);
+    g = gcd(up, down);
+    up_ = up / g;
+    down_ = down / g;
+
+    // windowed-sinc low-pass at the lower of the two Nyquist rates, unit DC gain per phase
+    max_rate = std::max(up_, down_);
+    cutoff = 1.0 / (sf8) max_rate;
+    half_ = 10 * (si8) max_rate;
+    taps = 2 * half_ + 1;
+    h.resize(taps);
+    for (k = 0; k < taps; k++) {
+        sf8 t = (sf8) (k - half_), r = t / (sf8) half_;
+        sf8 sinc = (t == 0.0) ? 1.0 : sin(M_PI * cutoff * t) / (M_PI * cutoff * t);
+        h[k] = cutoff * sinc * bessel_i0(beta * sqrt(std::max(0.0, 1.0 - r * r))) / bessel_i0(beta);
+        sum += h[k];
+    }
+    for (k = 0; k < taps; k++)
+        h[k] *= (sf8) up_ / sum;
+
+    // phase r holds taps r, r + up, ... applied to inputs n_hi, n_hi - 1, ...; stored in input order
+    phase_.resize(up_);
+    for (si4 r = 0; r < up_; r++) {
+        for (k = r; k < taps; k += up_)
+            phase_[r].push_back(h[k]);
+        std::reverse(phase_[r].begin(), phase_[r].end());
+    }
+}
+
+void PolyphaseResampler::write(ui8, const sf8 *x, size_t n)
+{
+    if (n == 0)
+        return;
+    if (received_ == 0)
+        first_ = x[0];
+    last_ = x[n - 1];
+    buffer_.insert(buffer_.end(), x, x + n);
+    received_ += n;
+    emit(false);
+}
+
+void PolyphaseResampler::finish()
+{
+    emit(true);
+}
+
+void PolyphaseResampler::emit(bool last)
+{
+    si8 p, n_hi, n_lo, n_keep, drop;
+    ui8 start = next_out_;
+
+    y_.clear();
+    for (;;) {
+        p = (si8) next_out_ * down_;
+        if (last && p >= (si8) received_ * up_)
+            break;
+        n_hi = (p + half_) / up_;
+        if (!last && n_hi >= (si8) received_)
+            break;
+
+        const std::vector<sf8> &g = phase_[half_ + p - n_hi * up_];
+        n_lo = n_hi - (si8) g.size() + 1;
+        sf8 acc = 0.0;
+        if (n_lo >= (si8) base_ && n_hi < (si8) received_) {
+            const sf8 *xp = &buffer_[n_lo - base_];
+            for (size_t j = 0; j < g.size(); j++)
+                acc += g[j] * xp[j];
+        } else {
+            for (size_t j = 0; j < g.size(); j++) {
+                si8 n = n_lo + (si8) j;
+                sf8 v = (n < 0) ? first_ : (n >= (si8) received_) ? last_ : buffer_[n - base_];
+                acc += g[j] * v;
+            }
+        }
+        y_.push_back(acc);
+        next_out_++;
+    }
+    if (!y_.empty())
+        out_.write(start, &y_[0], y_.size());
+
+    // keep input from the first sample the next output reads
+    p = (si8) next_out_ * down_;
+    n_keep = (p - half_ <= 0) ? 0 : (p - half_ + up_ - 1) / up_;
+    drop = std::min(n_keep - (si8) base_, (si8) buffer_.size());
+    if (drop > 0 && (size_t) drop > buffer_.size() / 2) {
+        buffer_.erase(buffer_.begin(), buffer_.begin() + drop);
+        base_ += drop;
+    }
+}
+
+
+//
+//  Streaming zero-phase filter
+//
+
+si4 stream_segment(const MefChannel &channel, ui8 s0, ui8 s1, size_t window, FilteredSink &sink)
+{
+    SampleReader reader(channel, s0, s1);
+    std::vector<sf8> y(std::max(window, (size_t) 1));
+    ui8 next = s0;
+    size_t n;
+
+    while ((n = reader.read(&y[0], y.size(), 1.0)) > 0) {
+        sink.write(next, &y[0], n);
+        next += n;
+    }
+    if (reader.error())
+        return(reader.error());
+    return(next == s1 + 1 ? MEF_OK : MEF_ERR_CORRUPT);
+}
+
+si4 filtfilt_segment(const MefChannel &channel, const MEF_SEGMENT &segment, ui8 s0, ui8 s1,
+                     const std::vector<sf8> &sos, size_t pad, size_t window, FilteredSink &sink)
+{
+    SosFilter forward(sos), backward(sos);
+    std::vector<si4> raw;
+    std::vector<sf8> fy, tmp, tail_src;
+    ui8 a, b, total, p, fy_base, out_pos, out_end, ext_total;
+    size_t n;
+    bool complete = false;
+
+    if (s0 < segment.first_sample || s1 > segment.last_sample || s0 > s1)
+        return(MEF_ERR_RANGE);
+    if (window < 1)
+        window = 1;
+
+    // real context on both sides, limited to the segment
+    a = s0 - std::min((ui8) pad, s0 - segment.first_sample);
+    b = s1 + std::min((ui8) pad, segment.last_sample - s1);
+    total = b - a + 1;
+    p = std::min((ui8) pad, total - 1);
+    ext_total = total + 2 * p;
+
+    SampleReader reader(channel, a, b);
+    if (reader.error())
+        return(reader.error());
+
+    // positions below are in the reflected sequence: p head samples, the data, p tail samples
+    fy_base = 0;
+    out_pos = p + (s0 - a);
+    out_end = p + (s1 - a);
+
+    // first chunk must reach past the head reflection
+    raw.resize(std::max((ui8) window, p + 1));
+    n = reader.read(&raw[0], raw.size());
+    if (n < std::min((ui8) raw.size(), total))
+        return(reader.error() ? reader.error() : MEF_ERR_CORRUPT);
+
+    for (ui8 j = 0; j < p; j++)
+        fy.push_back(2.0 * raw[0] - raw[p - j]);
+    for (size_t i = 0; i < n; i++)
+        fy.push_back(raw[i]);
+    forward.process(&fy[0], fy.size());
+    for (size_t i = n > p + 1 ? n - (p + 1) : 0; i < n; i++)
+        tail_src.push_back(raw[i]);
+
+    for (;;) {
+        // run the backward pass over every window whose look-ahead is available
+        while (out_pos <= out_end) {
+            ui8 available = fy_base + fy.size();
+            ui8 stop = out_pos + window + pad;
+            if (!complete && available < stop)
+                break;
+            stop = std::min(stop, available);
+            if (complete)
+                stop = available;       // from the true end: exact
+            tmp.assign(fy.begin() + (out_pos - fy_base), fy.begin() + (stop - fy_base));
+            backward.reset();
+            backward.process_reverse(&tmp[0], tmp.size());
+            ui8 emit = std::min((ui8) (complete ? tmp.size() : window), out_end + 1 - out_pos);
+            sink.write(a + (out_pos - p), &tmp[0], emit);
+            out_pos += emit;
+        }
+        if (out_pos > out_end)
+            break;
+        if (complete)
+            break;
+
+        // drop forward output that no later window needs
+        if (out_pos - fy_base > fy.size() / 2) {
+            fy.erase(fy.begin(), fy.begin() + (out_pos - fy_base));
+            fy_base = out_pos;
+        }
+
+        n = reader.read(&raw[0], window);
+        if (n > 0) {
+            size_t first = fy.size();
+            for (size_t i = 0; i < n; i++)
+                fy.push_back(raw[i]);
+            forward.process(&fy[first], n);
+            for (size_t i = n > p + 1 ? n - (p + 1) : 0; i < n; i++)
+                tail_src.push_back(raw[i]);
+            if (tail_src.size() > p + 1)
+                tail_src.erase(tail_src.begin(), tail_src.end() - (p + 1));
+        }
+        if (reader.remaining() == 0) {
+            if (reader.error())
+                return(reader.error());
+            // odd reflection about the last sample read
+            size_t first = fy.size();
+            sf8 last = tail_src.back();
+            for (ui8 j = 0; j < p; j++)
+                fy.push_back(2.0 * last - tail_src[tail_src.size() - 2 - j]);
+            if (p > 0)
+                forward.process(&fy[first], p);
+            complete = true;
+            if (fy_base + fy.size() != ext_total)
+                return(MEF_ERR_CORRUPT);
+        } else if (n == 0)
+            return(reader.error() ? reader.error() : MEF_ERR_CORRUPT);
+    }
+    return(MEF_OK);
+}
+
+}
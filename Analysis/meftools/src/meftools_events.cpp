@@ -0,0 +1,226 @@
+/*
+		meftools_events.cpp
+
+ Neuralynx event file (.nev) reader declared in meftools_events.h.
+
+ Record layout (little-endian, 184 bytes): nstx, npkt_id, npkt_data_size (si2 each), qwTimeStamp (ui8,
+ microseconds), nevent_id, nttl, ncrc, ndummy1, ndummy2 (si2 each), dnExtra[8] (si4 each), EventString
+ (128 chars, NUL-terminated).
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_events.h"
+
+#define NEV_READ_RECORDS        (1 << 14)   // records per read (about 3 MB)
+#define NEV_TIMESTAMP_OFFSET    6
+#define NEV_EVENT_ID_OFFSET     14
+#define NEV_TTL_OFFSET          16
+#define NEV_STRING_OFFSET       56
+
+namespace meftools {
+
+namespace {
+
+  template <typename T> T get_le(const ui1 *p)
+  {
+      T v;
+      memcpy(&v, p, sizeof(T));
+      return v;
+  }
+
+  // Local date and time to uUTC, as uutc_time_from_date() in convert_ncs.c.
+  ui8 uutc_of_local(int yr, int mo, int dy, int hr, int mn, sf8 sc)
+  {
+      struct tm tm;
+      memset(&tm, 0, sizeof(tm));
+      tm.tm_sec = (int) sc;
+      tm.tm_min = mn;
+      tm.tm_hour = hr;
+      tm.tm_mday = dy;
+      tm.tm_mon = mo - 1;
+      tm.tm_year = yr - 1900;
+      tm.tm_isdst = -1;
+      time_t secs = mktime(&tm);
+      if (secs == (time_t) -1)
+          return 0;
+      return (ui8) (secs - (int) sc) * 1000000 + (ui8) (sc * 1000000.0 + 0.5);
+  }
+
+  struct ByTime {
+      const std::vector<NEV_EVENT> &events;
+      explicit ByTime(const std::vector<NEV_EVENT> &e) : events(e) {}
+      bool operator()(ui4 i, ui8 t) const { return events[i].time < t; }
+      bool operator()(ui8 t, ui4 i) const { return t < events[i].time; }
+  };
+
+  bool event_before(const NEV_EVENT &a, ui8 t) { return a.time < t; }
+  bool event_after(ui8 t, const NEV_EVENT &a) { return t < a.time; }
+
+}
+
+si4 nev_time_created(const si1 *header, size_t bytes, ui8 *uutc)
+{
+    std::string text(header, strnlen(header, bytes));
+    int yr, mo, dy, hr, mn;
+    sf8 sc;
+    size_t at;
+
+    *uutc = 0;
+    // "-TimeCreated 2015/02/12 09:30:43"
+    if ((at = text.find("-TimeCreated ")) != std::string::npos &&
+        sscanf(text.c_str() + at + 13, "%d/%d/%d %d:%d:%lf", &yr, &mo, &dy, &hr, &mn, &sc) == 6)
+        *uutc = uutc_of_local(yr, mo, dy, hr, mn, sc);
+    // older headers: "## Time Opened (m/d/y): 2/12/2015  At Time: 9:30:43.046"
+    else if ((at = text.find("Time Opened (m/d/y): ")) != std::string::npos &&
+             sscanf(text.c_str() + at + 21, "%d/%d/%d At Time: %d:%d:%lf", &mo, &dy, &yr, &hr, &mn, &sc) == 6)
+        *uutc = uutc_of_local(yr, mo, dy, hr, mn, sc);
+    return *uutc ? MEF_OK : MEF_ERR_FORMAT;
+}
+
+si4 ncs_time_created(const char *path, ui8 *uutc)
+{
+    si1 header[NCS_HEADER_BYTES];
+    ssize_t n;
+
+    *uutc = 0;
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return MEF_ERR_OPEN;
+    n = pread(fd, header, sizeof(header), 0);
+    ::close(fd);
+    if (n != (ssize_t) sizeof(header))
+        return MEF_ERR_FORMAT;
+    return nev_time_created(header, sizeof(header), uutc);
+}
+
+si4 EventTable::read_nev(const char *path, const ui8 *offset)
+{
+    std::vector<ui1> buffer;
+    struct stat st;
+    si4 err = MEF_OK;
+
+    events_.clear();
+    labels_.clear();
+    by_label_.clear();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return MEF_ERR_OPEN;
+    if (fstat(fd, &st) || st.st_size < NEV_HEADER_BYTES) {
+        ::close(fd);
+        return MEF_ERR_FORMAT;
+    }
+
+    try {
+        buffer.resize(NEV_HEADER_BYTES);
+        if (pread(fd, &buffer[0], NEV_HEADER_BYTES, 0) != NEV_HEADER_BYTES)
+            err = MEF_ERR_READ;
+        else if (offset)
+            offset_ = *offset;
+        else
+            err = nev_time_created((const si1 *) &buffer[0], NEV_HEADER_BYTES, &offset_);
+
+        ui8 n_records = (ui8) (st.st_size - NEV_HEADER_BYTES) / NEV_RECORD_BYTES;
+        std::map<std::string, ui4> ids;
+        bool sorted = true;
+
+        if (!err) {
+            events_.reserve(n_records);
+            buffer.resize((size_t) NEV_READ_RECORDS * NEV_RECORD_BYTES);
+        }
+        for (ui8 r = 0; !err && r < n_records; r += NEV_READ_RECORDS) {
+            size_t n = (size_t) std::min<ui8>(NEV_READ_RECORDS, n_records - r);
+            size_t bytes = n * NEV_RECORD_BYTES;
+            if (pread(fd, &buffer[0], bytes, (off_t) (NEV_HEADER_BYTES + r * NEV_RECORD_BYTES)) != (ssize_t) bytes) {
+                err = MEF_ERR_READ;
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                const ui1 *rec = &buffer[i * NEV_RECORD_BYTES];
+                const si1 *s = (const si1 *) rec + NEV_STRING_OFFSET;
+                std::string text(s, strnlen(s, NEV_STRING_LENGTH));
+                std::map<std::string, ui4>::iterator it = ids.find(text);
+                if (it == ids.end()) {
+                    it = ids.insert(std::make_pair(text, (ui4) labels_.size())).first;
+                    labels_.push_back(text);
+                }
+                NEV_EVENT e;
+                e.time = get_le<ui8>(rec + NEV_TIMESTAMP_OFFSET) + offset_;
+                e.label = it->second;
+                e.ttl = get_le<ui2>(rec + NEV_TTL_OFFSET);
+                e.event_id = get_le<si2>(rec + NEV_EVENT_ID_OFFSET);
+                if (!events_.empty() && e.time < events_.back().time)
+                    sorted = false;
+                events_.push_back(e);
+            }
+        }
+        ::close(fd);
+        fd = -1;
+        if (err) {
+            events_.clear();
+            labels_.clear();
+            return err;
+        }
+
+        // records are written in time order; sort only when they are not, keeping ties in file order
+        if (!sorted)
+            std::stable_sort(events_.begin(), events_.end(),
+                             [](const NEV_EVENT &a, const NEV_EVENT &b) { return a.time < b.time; });
+
+        by_label_.resize(labels_.size());
+        for (size_t i = 0; i < events_.size(); i++)
+            by_label_[events_[i].label].push_back((ui4) i);
+    }
+    catch (const std::bad_alloc &) {
+        if (fd >= 0)
+            ::close(fd);
+        events_.clear();
+        labels_.clear();
+        by_label_.clear();
+        return MEF_ERR_MEMORY;
+    }
+
+    return MEF_OK;
+}
+
+si8 EventTable::find_label(const std::string &text) const
+{
+    for (size_t i = 0; i < labels_.size(); i++)
+        if (labels_[i] == text)
+            return (si8) i;
+    return -1;
+}
+
+void EventTable::range(ui8 t0, ui8 t1, size_t *first, size_t *last) const
+{
+    std::vector<NEV_EVENT>::const_iterator a = std::lower_bound(events_.begin(), events_.end(), t0, event_before);
+    std::vector<NEV_EVENT>::const_iterator b = t1 < t0 ? a : std::upper_bound(a, events_.end(), t1, event_after);
+    *first = a - events_.begin();
+    *last = b - events_.begin();
+}
+
+void EventTable::select(ui4 label, ui8 t0, ui8 t1, std::vector<size_t> &out) const
+{
+    out.clear();
+    if (label >= by_label_.size() || t1 < t0)
+        return;
+    const std::vector<ui4> &positions = by_label_[label];
+    std::vector<ui4>::const_iterator a = std::lower_bound(positions.begin(), positions.end(), t0, ByTime(events_));
+    std::vector<ui4>::const_iterator b = std::upper_bound(a, positions.end(), t1, ByTime(events_));
+    out.assign(a, b);
+}
+
+}
@@ -0,0 +1,251 @@
+/*
+		meftools_export.cpp
+
+ Interleaved int16 export. See meftools_export.h.
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+
+#include "../inst/include/meftools_export.h"
+#include "../inst/include/meftools_parallel.h"
+#include "../inst/include/meftools_scan.h"
+#include "../inst/include/meftools_trace.h"
+
+#define EXPORT_TILE_BYTES       (16 << 20)  // interleaved bytes per tile (and per write)
+#define EXPORT_ALIGNMENT        4096
+#define EXPORT_SUBTILE_SAMPLES  256         // samples per interleaving step: keeps the planar rows in L1/L2
+#define EXPORT_READ_BYTES       (16 << 20)  // scan read size of all channels together, within
+#define EXPORT_MIN_READ_BYTES   (256 << 10) // these bounds per channel
+#define EXPORT_MAX_READ_BYTES   (4 << 20)
+
+namespace meftools {
+
+si4 write_all(int fd, const void *buffer, size_t bytes)
+{
+    const ui1 *p = (const ui1 *) buffer;
+    ssize_t n;
+
+    while (bytes > 0) {
+        n = ::write(fd, p, bytes);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return(MEF_ERR_WRITE);
+        p += n;
+        bytes -= (size_t) n;
+    }
+    return(MEF_OK);
+}
+
+si4 BackgroundWriter::write(const void *buffer, size_t bytes)
+{
+    if (wait())
+        return(err_);
+    thread_ = std::thread([this, buffer, bytes]() {
+        TraceSpan span("write_tile", "io", (si8) bytes);
+        err_ = write_all(fd_, buffer, bytes);
+    });
+    return(MEF_OK);
+}
+
+si4 BackgroundWriter::wait()
+{
+    if (thread_.joinable())
+        thread_.join();
+    return(err_);
+}
+
+namespace {
+
+  // Aligned scratch that frees itself.
+  class AlignedBuffer {
+  public:
+    AlignedBuffer() : data_(NULL) {}
+    ~AlignedBuffer() { free(data_); }
+    bool allocate(size_t bytes) { return posix_memalign((void **) &data_, EXPORT_ALIGNMENT, bytes) == 0; }
+    si2 *data() { return data_; }
+  private:
+    AlignedBuffer(const AlignedBuffer &);
+    AlignedBuffer &operator=(const AlignedBuffer &);
+    si2 *data_;
+  };
+
+  // Starts of the segments of channel that fall within samples [s0, s0 + n), as offsets from s0, with
+  // their times; the first is s0 itself.
+  void segment_starts(const MefChannel &channel, ui8 s0, ui8 n, std::vector<ui8> &offsets, std::vector<ui8> &times)
+  {
+    std::vector<MEF_SEGMENT> segments = channel.segments();
+
+    offsets.assign(1, 0);
+    times.assign(1, channel.time_of_sample(s0));
+    for (size_t s = 0; s < segments.size(); s++)
+      if (segments[s].first_sample > s0 && segments[s].first_sample < s0 + n) {
+        offsets.push_back(segments[s].first_sample - s0);
+        times.push_back(segments[s].start_time);
+      }
+  }
+
+  // Samples [s0, s1] of one channel, clamped to int16, from a scan of the blocks that hold them. The
+  // scan reads ahead on its own thread; blocks are decoded in read(), on the calling worker.
+  class ScanSource {
+  public:
+    ScanSource(const MefChannel &channel, ui8 s0, ui8 s1, const SCAN_OPTIONS &options)
+      : channel_(channel), scan_(channel, channel.block_of_sample(s0), channel.block_of_sample(s1), options),
+        next_(s0), last_(s1), end_(0) {}
+
+    // Copy the next n samples to out, adding the samples clamped to *clipped.
+    si4 read(si2 *out, ui8 n, ui8 *clipped)
+    {
+      ui8 k;
+
+      while (n > 0) {
+        if (next_ >= end_) {
+          if (!scan_.next(batch_))
+            return(scan_.error() ? scan_.error() : MEF_ERR_CORRUPT);
+          end_ = batch_.first_sample + batch_.n_samples;
+          for (ui8 b = channel_.block_of_sample(next_); b <= channel_.block_of_sample(std::min(last_, end_ - 1)); b++)
+            if (batch_.status[b - batch_.first_block])
+              return(batch_.status[b - batch_.first_block]);
+        }
+        k = std::min(n, end_ - next_);
+        *clipped += narrow_samples(batch_.samples + (next_ - batch_.first_sample), out, k);
+        out += k;
+        n -= k;
+        next_ += k;
+      }
+      return(MEF_OK);
+    }
+
+  private:
+    const MefChannel &channel_;
+    ChannelScan scan_;
+    SCAN_BATCH batch_;
+    ui8 next_, last_, end_;     // end_: one past the current batch
+  };
+
+}
+
+si4 export_interleaved_int16(std::vector<EXPORT_CHANNEL> &channels, ui8 n, const char *path, bool saturate,
+                             int threads, si4 *failed_channel)
+{
+    size_t n_channels = channels.size(), c;
+    ui8 tile, pos, k;
+    si4 err, minimum, maximum;
+    std::vector<ui8> offsets0, times0, offsets, times;
+    sf8 tolerance;
+    int fd;
+
+    *failed_channel = -1;
+    if (n_channels == 0)
+        return(MEF_ERR_RANGE);
+    tolerance = 500000.0 / channels[0].channel->header().sampling_frequency;     // half a sample, in microseconds
+    for (c = 0; c < n_channels; c++) {
+        const MefChannel &channel = *channels[c].channel;
+        channels[c].clipped = 0;
+        if (n == 0 || channels[c].first_sample + n > channel.header().number_of_samples)
+            err = MEF_ERR_RANGE;
+        else if (saturate)
+            err = MEF_OK;
+        else if ((err = channel.block_range(channel.block_of_sample(channels[c].first_sample),
+                                            channel.block_of_sample(channels[c].first_sample + n - 1),
+                                            &minimum, &maximum)) == MEF_OK && (minimum < SHRT_MIN || maximum > SHRT_MAX))
+            err = MEF_ERR_OVERFLOW;
+        if (err == MEF_OK) {
+            // gaps must fall at the same samples and times as in the first channel
+            segment_starts(channel, channels[c].first_sample, n, offsets, times);
+            if (c == 0) {
+                offsets0 = offsets;
+                times0 = times;
+            } else if (offsets != offsets0)
+                err = MEF_ERR_ALIGN;
+            else
+                for (size_t s = 0; s < times.size() && err == MEF_OK; s++)
+                    if (fabs((sf8) times[s] - (sf8) times0[s]) > tolerance)
+                        err = MEF_ERR_ALIGN;
+        }
+        if (err) {
+            *failed_channel = (si4) c;
+            return(err);
+        }
+    }
+
+    // tiles are whole pages of output for any channel count
+    tile = EXPORT_TILE_BYTES / (2 * n_channels);
+    tile = std::max((ui8) (EXPORT_ALIGNMENT / 2), tile - tile % (EXPORT_ALIGNMENT / 2));
+    tile = std::min(tile, n);
+
+    std::vector<si2> planar(n_channels * tile);
+    AlignedBuffer out[2];
+    if (!out[0].allocate(tile * n_channels * sizeof(si2)) || !out[1].allocate(tile * n_channels * sizeof(si2)))
+        return(MEF_ERR_MEMORY);
+
+    // one sequential scan per channel; decoding stays on this call's workers
+    SCAN_OPTIONS options;
+    options.read_bytes = std::min((ui8) EXPORT_MAX_READ_BYTES, std::max((ui8) EXPORT_MIN_READ_BYTES, (ui8) EXPORT_READ_BYTES / n_channels));
+    options.threads = 1;
+    options.decode_ahead = false;
+    std::vector<ScanSource *> sources(n_channels);
+    for (c = 0; c < n_channels; c++)
+        sources[c] = new ScanSource(*channels[c].channel, channels[c].first_sample, channels[c].first_sample + n - 1, options);
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    err = fd < 0 ? MEF_ERR_WRITE : MEF_OK;
+
+    std::vector<si4> results(n_channels, MEF_OK);
+    BackgroundWriter writer(fd);
+    int current = 0;
+    for (pos = 0; pos < n && err == MEF_OK; pos += k) {
+        k = std::min(tile, n - pos);
+
+        // decode: one channel per worker, each continuing its own scan
+        parallel_for(n_channels, threads, [&](size_t i) {
+            TraceSpan span("decode_tile", "export", (si8) i);
+            results[i] = sources[i]->read(&planar[i * tile], k, &channels[i].clipped);
+        });
+        for (c = 0; c < n_channels && err == MEF_OK; c++)
+            if (results[c]) {
+                err = results[c];
+                *failed_channel = (si4) c;
+            }
+        if (err)
+            break;
+
+        // interleave, one sub-tile per work item
+        si2 *dst = out[current].data();
+        TraceSpan interleave("interleave_tile", "export", (si8) k);
+        parallel_for((size_t) ((k + EXPORT_SUBTILE_SAMPLES - 1) / EXPORT_SUBTILE_SAMPLES), threads, [&](size_t j) {
+            ui8 t0 = (ui8) j * EXPORT_SUBTILE_SAMPLES, t1 = std::min(k, t0 + EXPORT_SUBTILE_SAMPLES);
+            for (ui8 t = t0; t < t1; t++) {
+                si2 *row = dst + t * n_channels;
+                for (size_t i = 0; i < n_channels; i++)
+                    row[i] = planar[i * tile + t];
+            }
+        });
+        interleave.stop();
+
+        // the previous tile's write finishes before this one starts, and before its buffer is reused
+        err = writer.write(dst, k * n_channels * sizeof(si2));
+        current ^= 1;
+    }
+    if (writer.wait() != MEF_OK && err == MEF_OK)
+        err = writer.wait();
+
+    if (fd >= 0 && close(fd) != 0 && err == MEF_OK)
+        err = MEF_ERR_WRITE;
+    for (c = 0; c < n_channels; c++)
+        delete sources[c];
+    return(err);
+}
+
+}
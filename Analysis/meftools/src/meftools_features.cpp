@@ -0,0 +1,162 @@
+/*
+		meftools_features.cpp
+
+ Windowed feature kernels. See meftools_features.h.
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "../inst/include/meftools_features.h"
+#include "../inst/include/meftools_parallel.h"
+#include "../inst/include/meftools_scan.h"
+
+#define FEATURE_TASK_WINDOWS    64      // windows per parallel task
+
+namespace meftools {
+
+si4 feature_kind(const std::string &name)
+{
+    static const char *names[] = { "line_length", "rms", "mean", "min", "max", "zero_crossings", "band_power" };
+
+    for (si4 i = 0; i < (si4) (sizeof(names) / sizeof(names[0])); i++)
+        if (name == names[i])
+            return i;
+    return -1;
+}
+
+FeatureExtractor::FeatureExtractor(const std::vector<FEATURE> &features, sf8 sampling_frequency, size_t window)
+    : features_(features), fs_(sampling_frequency), window_(window), need_spectrum_(false)
+{
+    for (size_t f = 0; f < features_.size(); f++)
+        if (features_[f].kind == FEATURE_BAND_POWER)
+            need_spectrum_ = true;
+    if (need_spectrum_)
+        spectrum_.resize(fft_length(window_));
+}
+
+void FeatureExtractor::compute(const sf8 *x, sf8 *out)
+{
+    size_t i, n = window_;
+    sf8 sum = 0.0, mean, ss = 0.0, ll = 0.0, mn = x[0], mx = x[0], d;
+    ui8 crossings = 0;
+
+    // one pass for the moments and extremes, one about the mean
+    for (i = 0; i < n; i++) {
+        sum += x[i];
+        mn = std::min(mn, x[i]);
+        mx = std::max(mx, x[i]);
+    }
+    mean = sum / (sf8) n;
+    for (i = 1; i < n; i++)
+        ll += fabs(x[i] - x[i - 1]);
+    for (i = 0; i < n; i++) {
+        d = x[i] - mean;
+        ss += d * d;
+    }
+    for (i = 1; i < n; i++)
+        crossings += ((x[i - 1] - mean) < 0.0) != ((x[i] - mean) < 0.0);
+
+    if (need_spectrum_) {
+        size_t m = spectrum_.size();
+        for (i = 0; i < n; i++)
+            spectrum_[i] = std::complex<sf8>(x[i] - mean, 0.0);
+        for (; i < m; i++)
+            spectrum_[i] = 0.0;
+        fft(&spectrum_[0], m, false);
+    }
+
+    for (size_t f = 0; f < features_.size(); f++) {
+        switch (features_[f].kind) {
+        case FEATURE_LINE_LENGTH:    out[f] = ll; break;
+        case FEATURE_RMS:            out[f] = sqrt(ss / (sf8) n); break;
+        case FEATURE_MEAN:           out[f] = mean; break;
+        case FEATURE_MIN:            out[f] = mn; break;
+        case FEATURE_MAX:            out[f] = mx; break;
+        case FEATURE_ZERO_CROSSINGS: out[f] = (sf8) crossings; break;
+        case FEATURE_BAND_POWER: {
+            // one-sided periodogram: sum over bins in [low, high], scaled so all bins sum to the variance
+            size_t m = spectrum_.size(), k0, k1, k;
+            sf8 p = 0.0, df = fs_ / (sf8) m;
+            k0 = (size_t) ceil(features_[f].low / df);
+            k1 = std::min((size_t) floor(features_[f].high / df), m / 2);
+            for (k = k0; k <= k1; k++)
+                p += std::norm(spectrum_[k]) * ((k == 0 || k == m / 2) ? 1.0 : 2.0);
+            out[f] = p / ((sf8) m * (sf8) n);
+            break;
+        }
+        default:                     out[f] = NAN;
+        }
+    }
+}
+
+si4 features_scan(const MefChannel &channel, const std::vector<ui8> &first, const std::vector<ui8> &last,
+                  size_t window, size_t hop, const std::vector<FEATURE> &features, int threads,
+                  std::vector<ui8> &starts, std::vector<sf8> &values)
+{
+    std::vector<sf8> buffer;        // samples [base, base + buffer.size()) of the current range
+    SCAN_OPTIONS options;
+    size_t r = 0, n_features = features.size();
+    ui8 base = 0, next;             // next: first sample of the range's next window
+
+    if (window < 1 || hop < 1 || first.size() != last.size())
+        return(MEF_ERR_RANGE);
+    if (first.empty())
+        return(MEF_OK);
+    next = first[0];
+
+    // one extractor per worker
+    std::vector<FeatureExtractor> extractors(worker_count((size_t) -1, threads),
+                                             FeatureExtractor(features, channel.header().sampling_frequency, window));
+    options.threads = threads;
+    return scan_channel(channel, channel.block_of_sample(first.front()), channel.block_of_sample(last.back()), options,
+                        [&](const SCAN_BATCH &batch) -> si4 {
+        ui8 b0 = batch.first_sample, b1 = batch.first_sample + batch.n_samples - 1;
+
+        while (r < first.size() && first[r] <= b1) {
+            ui8 lo = std::max(std::max(b0, first[r]), buffer.empty() ? next : base + buffer.size());
+            ui8 hi = std::min(b1, last[r]);
+            if (lo <= hi) {
+                for (ui8 b = channel.block_of_sample(lo); b <= channel.block_of_sample(hi); b++)
+                    if (batch.status[b - batch.first_block])
+                        return batch.status[b - batch.first_block];
+                if (buffer.empty())
+                    base = lo;
+                const si4 *x = batch.samples + (lo - b0);
+                buffer.insert(buffer.end(), x, x + (hi - lo + 1));
+
+                // every window that now ends inside the buffer
+                ui8 end = base + buffer.size();
+                size_t m = end < next + window ? 0 : (size_t) ((end - window - next) / hop + 1);
+                size_t k0 = starts.size();
+                starts.resize(k0 + m);
+                values.resize((k0 + m) * n_features);
+                parallel_for_worker((m + FEATURE_TASK_WINDOWS - 1) / FEATURE_TASK_WINDOWS, threads, [&](unsigned w, size_t t) {
+                    size_t j1 = std::min(m, (t + 1) * FEATURE_TASK_WINDOWS);
+                    for (size_t j = t * FEATURE_TASK_WINDOWS; j < j1; j++) {
+                        ui8 start = next + j * hop;
+                        starts[k0 + j] = start;
+                        extractors[w].compute(&buffer[(size_t) (start - base)], &values[(k0 + j) * n_features]);
+                    }
+                });
+                next += m * hop;
+
+                // keep only what later windows need
+                size_t drop = (size_t) std::min<ui8>(buffer.size(), next - base);
+                buffer.erase(buffer.begin(), buffer.begin() + drop);
+                base += drop;
+            }
+            if (last[r] > b1)
+                break;
+            buffer.clear();
+            if (++r < first.size())
+                next = first[r];
+        }
+        return (si4) MEF_OK;
+    });
+}
+
+}
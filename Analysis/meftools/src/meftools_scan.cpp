@@ -0,0 +1,513 @@
+/*
+		meftools_scan.cpp
+
+ Sequential channel scan and the validation built on it. See meftools_scan.h.
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "../inst/include/meftools_scan.h"
+#include "../inst/include/meftools_parallel.h"
+#include "../inst/include/meftools_stats.h"
+#include "../inst/include/meftools_trace.h"
+
+#define SCAN_BUFFERS        2           // one being filled while the other is used
+#define SCAN_TASK_BLOCKS    16          // blocks per decode task (each task has its own difference buffer)
+#define SCAN_MAP_BYTES      (1ULL << 30)    // mapped at a time to look up page residency
+
+namespace meftools {
+
+namespace {
+
+  typedef struct {
+    ui8 first_block, last_block;
+    ui8 read_start, read_end;   // byte range read: read_start is page aligned
+  } SCAN_PIECE;
+
+  typedef struct {
+    ui1 *data;
+    bool full;
+    si4 status;
+  } SCAN_BUFFER;
+
+  struct SCAN_SLOT {
+    std::vector<RED_BLOCK_HDR_INFO> headers;
+    std::vector<si4> status, samples;
+    SCAN_BATCH batch;
+    bool ready;
+    si4 err;
+  };
+
+  inline ui8 align_down(ui8 x)
+  {
+    return x - x % SCAN_ALIGN;
+  }
+
+  // access hints, where the system has them
+  void advise(int fd, ui8 offset, ui8 bytes, bool done)
+  {
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, (off_t) offset, (off_t) bytes, done ? POSIX_FADV_DONTNEED : POSIX_FADV_SEQUENTIAL);
+#else
+    (void) fd; (void) offset; (void) bytes; (void) done;
+#endif
+  }
+
+  // One flag per page of [offset, offset + bytes), bit 0 set for pages in the page cache. Mapping the
+  // file does not read it. False where mincore() is missing or fails.
+  bool resident_pages(int fd, ui8 offset, ui8 bytes, ui8 page, std::vector<ui1> &flags)
+  {
+    flags.assign((size_t) ((bytes + page - 1) / page), 0);
+    for (ui8 done = 0; done < bytes; ) {
+      size_t n = (size_t) std::min<ui8>(SCAN_MAP_BYTES, bytes - done);
+      void *map = mmap(NULL, n, PROT_READ, MAP_SHARED, fd, (off_t) (offset + done));
+      if (map == MAP_FAILED)
+        return(false);
+#ifdef __APPLE__
+      int status = mincore((caddr_t) map, n, (char *) &flags[(size_t) (done / page)]);
+#else
+      int status = mincore(map, n, (unsigned char *) &flags[(size_t) (done / page)]);
+#endif
+      munmap(map, n);
+      if (status != 0)
+        return(false);
+      done += n;
+    }
+    return(true);
+  }
+
+  si4 read_piece(int fd, const SCAN_PIECE &piece, ui1 *buffer)
+  {
+    ui8 done = 0, bytes = piece.read_end - piece.read_start;
+    ssize_t n;
+
+    StageTimer read_timer(STAGE_BLOCK_READ);
+    while (done < bytes) {
+      n = pread(fd, buffer + done, bytes - done, (off_t) (piece.read_start + done));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return(MEF_ERR_READ);
+      done += (ui8) n;
+    }
+    stats_count(COUNTER_BYTES_READ, bytes);
+    return(MEF_OK);
+  }
+
+  // check (and decode) block b, whose bytes start at p
+  si4 scan_block(const MefChannel &channel, ui8 b, const ui1 *p, const SCAN_OPTIONS &options,
+                 RED_BLOCK_HDR_INFO *block_hdr, si4 *out, si1 *diff_buffer)
+  {
+    ui8 n = channel.block_samples(b);
+
+    memset(block_hdr, 0, sizeof(*block_hdr));
+    if (channel.block_bytes(b) < BLOCK_HEADER_BYTES)
+      return(MEF_ERR_CORRUPT);
+    read_block_header(p, block_hdr);
+    if ((ui8) block_hdr->sample_count != n || n > channel.header().maximum_block_length
+        || (ui8) block_hdr->compressed_bytes + BLOCK_HEADER_BYTES > channel.block_bytes(b))
+      return(MEF_ERR_CORRUPT);
+    if (options.check_crc && block_crc(p) != block_hdr->CRC_32)
+      return(MEF_ERR_CORRUPT);
+    if (out != NULL && decompress_block(p, out, diff_buffer, channel.data_key(), NULL) == 0)
+      return(MEF_ERR_CORRUPT);
+    return(MEF_OK);
+  }
+
+}
+
+struct ChannelScan::Pipeline {
+    const MefChannel &channel;
+    SCAN_OPTIONS options;
+    std::vector<SCAN_PIECE> pieces;
+    int fd;
+    ui8 page, resident_start;
+    std::vector<ui1> resident;      // per page from resident_start: cached before the scan
+    bool can_drop;
+    SCAN_BUFFER buffers[SCAN_BUFFERS];
+    SCAN_SLOT slots[SCAN_BUFFERS];
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread reader, decoder;
+    bool stop;
+    size_t next_piece;              // the next piece next() hands out
+
+    Pipeline(const MefChannel &c, const SCAN_OPTIONS &o) : channel(c), options(o), fd(-1), page(SCAN_ALIGN),
+        resident_start(0), can_drop(false), stop(false), next_piece(0)
+    {
+        for (size_t k = 0; k < SCAN_BUFFERS; k++) {
+            buffers[k].data = NULL;
+            buffers[k].full = false;
+            buffers[k].status = MEF_OK;
+            slots[k].ready = false;
+            slots[k].err = MEF_OK;
+        }
+    }
+
+    void read_all();
+    void decode_all();
+    si4 decode(size_t k, SCAN_SLOT &slot);
+    void drop(size_t k);
+};
+
+void ChannelScan::Pipeline::read_all()
+{
+    for (size_t k = 0; k < pieces.size(); k++) {
+        SCAN_BUFFER &buffer = buffers[k % SCAN_BUFFERS];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return stop || !buffer.full; });
+            if (stop)
+                return;
+        }
+        si4 status = read_piece(fd, pieces[k], buffer.data);
+        std::lock_guard<std::mutex> lock(mutex);
+        buffer.status = status;
+        buffer.full = true;
+        cv.notify_all();
+    }
+}
+
+void ChannelScan::Pipeline::decode_all()
+{
+    for (size_t k = 0; k < pieces.size(); k++) {
+        SCAN_SLOT &slot = slots[k % SCAN_BUFFERS];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return stop || !slot.ready; });
+            if (stop)
+                return;
+        }
+        si4 err = decode(k, slot);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stop)
+            return;
+        slot.err = err;
+        slot.ready = true;
+        cv.notify_all();
+        if (err)
+            return;
+    }
+}
+
+// Decode piece k into slot once the reader has it, then hand its read buffer back.
+si4 ChannelScan::Pipeline::decode(size_t k, SCAN_SLOT &slot)
+{
+    const SCAN_PIECE &piece = pieces[k];
+    SCAN_BUFFER &buffer = buffers[k % SCAN_BUFFERS];
+    si4 err;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return stop || buffer.full; });
+        if (!buffer.full)
+            return(MEF_ERR_READ);
+    }
+    if ((err = buffer.status) != MEF_OK)
+        return(err);
+
+    ui8 n_blocks = piece.last_block - piece.first_block + 1;
+    ui8 first_sample = channel.index()[piece.first_block].sample_number;
+    ui8 n = channel.index()[piece.last_block].sample_number + channel.block_samples(piece.last_block) - first_sample;
+    try {
+        slot.headers.resize(n_blocks);
+        slot.status.resize(n_blocks);
+        slot.samples.resize(options.decode ? n : 0);
+    } catch (...) {
+        return(MEF_ERR_MEMORY);
+    }
+    {
+        TraceSpan decode_span("scan_decode", "scan", (si8) k);
+        parallel_for((size_t) ((n_blocks + SCAN_TASK_BLOCKS - 1) / SCAN_TASK_BLOCKS), options.threads, [&](size_t t) {
+            std::vector<si1> diff_buffer(options.decode ? 4 * channel.header().maximum_block_length + 8 : 0);
+            ui8 first = piece.first_block + t * SCAN_TASK_BLOCKS;
+            ui8 last = std::min(first + SCAN_TASK_BLOCKS - 1, piece.last_block);
+            for (ui8 i = first; i <= last; i++) {
+                si4 *out = options.decode ? slot.samples.data() + (channel.index()[i].sample_number - first_sample) : NULL;
+                slot.status[i - piece.first_block] = scan_block(channel, i, buffer.data + (channel.index()[i].file_offset - piece.read_start),
+                                                                options, &slot.headers[i - piece.first_block], out,
+                                                                diff_buffer.empty() ? NULL : &diff_buffer[0]);
+                if (out != NULL && slot.status[i - piece.first_block] != MEF_OK)
+                    memset(out, 0, channel.block_samples(i) * sizeof(si4));
+            }
+        });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffer.full = false;
+        cv.notify_all();
+    }
+    if (can_drop)
+        drop(k);
+
+    slot.batch.first_block = piece.first_block;
+    slot.batch.last_block = piece.last_block;
+    slot.batch.first_sample = first_sample;
+    slot.batch.n_samples = n;
+    slot.batch.samples = options.decode ? slot.samples.data() : NULL;
+    slot.batch.headers = &slot.headers[0];
+    slot.batch.status = &slot.status[0];
+    return(MEF_OK);
+}
+
+// Drop the pages of piece k that were not cached before the scan. A page shared with the next piece
+// waits for that piece.
+void ChannelScan::Pipeline::drop(size_t k)
+{
+    const SCAN_PIECE &piece = pieces[k];
+    ui8 first = (piece.read_start - resident_start) / page;
+    ui8 end = (piece.read_end - resident_start) / page;
+
+    if (k + 1 == pieces.size())
+        end = std::min<ui8>(resident.size(), (piece.read_end - resident_start + page - 1) / page);
+    for (ui8 i = first; i < end; ) {
+        if (resident[i] & 1) {
+            i++;
+            continue;
+        }
+        ui8 j = i;
+        while (j < end && !(resident[j] & 1))
+            j++;
+        advise(fd, resident_start + i * page, (j - i) * page, true);
+        i = j;
+    }
+}
+
+ChannelScan::ChannelScan(const MefChannel &channel, ui8 b0, ui8 b1, const SCAN_OPTIONS &options)
+    : pipeline_(NULL), err_(MEF_OK)
+{
+    ui8 read_bytes, capacity, b, e;
+    size_t k;
+
+    if (!channel.is_open() || b0 > b1 || b1 >= channel.number_of_blocks()) {
+        err_ = MEF_ERR_RANGE;
+        return;
+    }
+    try {
+        pipeline_ = new Pipeline(channel, options);
+    } catch (...) {
+        err_ = MEF_ERR_MEMORY;
+        return;
+    }
+    Pipeline &p = *pipeline_;
+
+    // whole blocks per read, each read starting on a page boundary
+    read_bytes = options.read_bytes > 0 ? options.read_bytes : SCAN_READ_BYTES;
+    capacity = 0;
+    for (b = b0; b <= b1; b = e + 1) {
+        SCAN_PIECE piece;
+        ui8 start = align_down(channel.index()[b].file_offset);
+        for (e = b; e < b1 && channel.index()[e + 1].file_offset + channel.block_bytes(e + 1) - start <= read_bytes; e++)
+            ;
+        piece.first_block = b;
+        piece.last_block = e;
+        piece.read_start = start;
+        piece.read_end = channel.index()[e].file_offset + channel.block_bytes(e);
+        capacity = std::max(capacity, piece.read_end - piece.read_start);
+        p.pieces.push_back(piece);
+    }
+
+    // a private descriptor, so that the access hints do not change how the channel's own reads behave
+    p.fd = ::open(channel.path().c_str(), O_RDONLY);
+    if (p.fd < 0) {
+        err_ = MEF_ERR_OPEN;
+        return;
+    }
+    for (k = 0; k < SCAN_BUFFERS; k++)
+        if (posix_memalign((void **) &p.buffers[k].data, SCAN_ALIGN, capacity) != 0) {
+            p.buffers[k].data = NULL;
+            err_ = MEF_ERR_MEMORY;
+            return;
+        }
+
+    // note what is cached already, so that only the pages this scan reads in are dropped; where that
+    // cannot be known nothing is dropped
+    if (options.drop_cache) {
+        long page = sysconf(_SC_PAGESIZE);
+        p.page = page > 0 ? (ui8) page : SCAN_ALIGN;
+        p.resident_start = p.pieces.front().read_start - p.pieces.front().read_start % p.page;
+        p.can_drop = resident_pages(p.fd, p.resident_start, p.pieces.back().read_end - p.resident_start, p.page, p.resident);
+    }
+    advise(p.fd, p.pieces.front().read_start, p.pieces.back().read_end - p.pieces.front().read_start, false);
+
+    p.reader = std::thread([&p]() { p.read_all(); });
+    if (options.decode_ahead)
+        p.decoder = std::thread([&p]() { p.decode_all(); });
+}
+
+ChannelScan::~ChannelScan()
+{
+    if (pipeline_ == NULL)
+        return;
+    Pipeline &p = *pipeline_;
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        p.stop = true;
+        p.cv.notify_all();
+    }
+    if (p.reader.joinable())
+        p.reader.join();
+    if (p.decoder.joinable())
+        p.decoder.join();
+    for (size_t k = 0; k < SCAN_BUFFERS; k++)
+        free(p.buffers[k].data);
+    if (p.fd >= 0)
+        ::close(p.fd);
+    delete pipeline_;
+}
+
+bool ChannelScan::next(SCAN_BATCH &batch)
+{
+    if (err_ || pipeline_ == NULL)
+        return(false);
+    Pipeline &p = *pipeline_;
+    si4 err;
+
+    if (p.options.decode_ahead) {
+        // the previous batch is done with: its slot can take the piece after next
+        if (p.next_piece > 0) {
+            std::lock_guard<std::mutex> lock(p.mutex);
+            p.slots[(p.next_piece - 1) % SCAN_BUFFERS].ready = false;
+            p.cv.notify_all();
+        }
+        if (p.next_piece == p.pieces.size())
+            return(false);
+        SCAN_SLOT &slot = p.slots[p.next_piece % SCAN_BUFFERS];
+        {
+            std::unique_lock<std::mutex> lock(p.mutex);
+            p.cv.wait(lock, [&]() { return slot.ready; });
+        }
+        if ((err = slot.err) == MEF_OK)
+            batch = slot.batch;
+    } else {
+        if (p.next_piece == p.pieces.size())
+            return(false);
+        if ((err = p.decode(p.next_piece, p.slots[0])) == MEF_OK)
+            batch = p.slots[0].batch;
+    }
+    if (err) {
+        err_ = err;
+        return(false);
+    }
+    p.next_piece++;
+    return(true);
+}
+
+si4 scan_channel(const MefChannel &channel, ui8 b0, ui8 b1, const SCAN_OPTIONS &options, const ScanVisitor &visit)
+{
+    TraceSpan span("scan_channel", "scan", (si8) (b1 - b0 + 1));
+    ChannelScan scan(channel, b0, b1, options);
+    SCAN_BATCH batch;
+    si4 err;
+
+    // the visitor runs on this thread while the pipeline reads and decodes the pieces after it
+    while (scan.next(batch))
+        if ((err = visit(batch)) != MEF_OK)
+            return(err);
+    return(scan.error());
+}
+
+si4 validate_channel(const MefChannel &channel, int threads, std::vector<VALIDATION_ISSUE> &issues)
+{
+    const MEF_HEADER_INFO &h = channel.header();
+    const std::vector<INDEX_DATA> &index = channel.index();
+    char message[256];
+    ui8 b, end_time;
+    bool bad_index = false;
+    SCAN_OPTIONS options;
+
+    issues.clear();
+    if (!channel.is_open())
+        return(MEF_ERR_OPEN);
+    if (index.empty()) {
+        VALIDATION_ISSUE issue = { -1, "file has no blocks" };
+        issues.push_back(issue);
+        return(MEF_OK);
+    }
+
+    // header against index, and the index itself
+    if (h.recording_start_time != index[0].time) {
+        snprintf(message, sizeof(message), "header recording_start_time %llu does not match index time %llu",
+                 (unsigned long long) h.recording_start_time, (unsigned long long) index[0].time);
+        VALIDATION_ISSUE issue = { -1, message };
+        issues.push_back(issue);
+    }
+    end_time = h.recording_start_time + (ui8) (0.5 + 1000000.0 * (sf8) h.number_of_samples / h.sampling_frequency);
+    if (h.recording_end_time < end_time) {
+        snprintf(message, sizeof(message), "header recording_end_time %llu does not match sampling frequency and number of samples",
+                 (unsigned long long) h.recording_end_time);
+        VALIDATION_ISSUE issue = { -1, message };
+        issues.push_back(issue);
+    }
+    for (b = 1; b < index.size(); b++) {
+        message[0] = 0;
+        // steps up to 8 bytes over the largest block are alignment padding
+        if (index[b].file_offset - index[b-1].file_offset > (ui8) h.maximum_compressed_block_size + 8)
+            snprintf(message, sizeof(message), "bad index offset step %llu from block %llu",
+                     (unsigned long long) (index[b].file_offset - index[b-1].file_offset), (unsigned long long) (b - 1));
+        else if (index[b].time < index[b-1].time)
+            snprintf(message, sizeof(message), "block time %llu is earlier than block %llu's %llu",
+                     (unsigned long long) index[b].time, (unsigned long long) (b - 1), (unsigned long long) index[b-1].time);
+        else if (index[b].sample_number - index[b-1].sample_number > h.maximum_block_length)
+            snprintf(message, sizeof(message), "bad index sample step %llu from block %llu",
+                     (unsigned long long) (index[b].sample_number - index[b-1].sample_number), (unsigned long long) (b - 1));
+        if (message[0]) {
+            VALIDATION_ISSUE issue = { (si8) b, message };
+            issues.push_back(issue);
+            bad_index = true;
+        }
+    }
+    if (bad_index)
+        return(MEF_OK);
+
+    // every block: size against the index, CRC, decode, alignment and time
+    options.threads = threads;
+    options.check_crc = true;
+    return scan_channel(channel, 0, index.size() - 1, options, [&](const SCAN_BATCH &batch) {
+        for (ui8 i = batch.first_block; i <= batch.last_block; i++) {
+            const RED_BLOCK_HDR_INFO &hdr = batch.headers[i - batch.first_block];
+            ui8 stored = channel.block_bytes(i), used = (ui8) hdr.compressed_bytes + BLOCK_HEADER_BYTES;
+            char text[256];
+
+            text[0] = 0;
+            if (stored < BLOCK_HEADER_BYTES || (stored > used ? stored - used : used - stored) > 8)
+                snprintf(text, sizeof(text), "block size %llu disagrees with index (%llu bytes)",
+                         (unsigned long long) used, (unsigned long long) stored);
+            else if (batch.status[i - batch.first_block] != MEF_OK)
+                snprintf(text, sizeof(text), "corrupt block: bad header, CRC error or undecodable data");
+            if (text[0]) {
+                VALIDATION_ISSUE issue = { (si8) i, text };
+                issues.push_back(issue);
+            }
+            if (index[i].file_offset % 8) {
+                VALIDATION_ISSUE issue = { (si8) i, "block is not 8-byte boundary aligned" };
+                issues.push_back(issue);
+            }
+            if (stored >= BLOCK_HEADER_BYTES && hdr.block_start_time < h.recording_start_time) {
+                VALIDATION_ISSUE issue = { (si8) i, "block start time is earlier than recording start time" };
+                issues.push_back(issue);
+            }
+            if (stored >= BLOCK_HEADER_BYTES && hdr.block_start_time > h.recording_end_time) {
+                VALIDATION_ISSUE issue = { (si8) i, "block start time is later than recording end time" };
+                issues.push_back(issue);
+            }
+        }
+        return (si4) MEF_OK;
+    });
+}
+
+}
@@ -0,0 +1,401 @@
+/*
+		meftools_shared_cache.cpp
+
+ Cross-process decoded-block cache declared in meftools_shared_cache.h.
+
+ Segment layout: a header, then one SLOT_META per slot (set after set), one clock hand per set, and the
+ slots' samples. Every field another process may change concurrently is accessed with __atomic builtins
+ rather than std::atomic, since the segment is plain shared memory mapped at different addresses.
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <string>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_shared_cache.h"
+#include "../inst/include/meftools_stats.h"
+
+#define SHARED_CACHE_MAGIC      0x4d4546424c4b4333UL    // "MEFBLKC3"
+#define SHARED_CACHE_ATTACH_MS  1000                    // how long to wait for another process to finish creating it
+#define SHARED_CACHE_WAIT_US    200000                  // how long a lookup waits for a block another process is decoding
+
+namespace meftools {
+
+namespace {
+
+  typedef struct {
+    ui8 magic;          // stored last by the creator
+    ui8 n_sets;
+    ui8 slot_samples;
+    ui8 bytes;
+    ui8 reserved[4];
+  } CACHE_HEADER;
+
+  typedef struct {
+    ui8 seq;            // even: stable; odd: a writer owns the slot (see make_seq)
+    ui8 file_key;       // 0: empty
+    ui8 block;
+    ui4 n;
+    ui4 referenced;     // clock bit
+    ui8 claimed;        // when the claim was set up (CLOCK_MONOTONIC, microseconds); 0 before that and once released
+    ui8 reserved[3];    // one cache line per slot
+  } SLOT_META;
+
+  typedef struct {
+    std::string path;
+    void *base;
+    size_t bytes;
+    CACHE_HEADER *header;
+    SLOT_META *meta;
+    ui8 *hands;
+    si4 *samples;
+    ui8 n_sets;
+    ui8 slot_samples;
+  } CACHE;
+
+  std::atomic<CACHE *> attached(NULL);
+
+  size_t layout_bytes(ui8 n_sets, ui8 slot_samples)
+  {
+    return sizeof(CACHE_HEADER) + n_sets * SHARED_CACHE_WAYS * sizeof(SLOT_META) + n_sets * sizeof(ui8)
+           + n_sets * SHARED_CACHE_WAYS * slot_samples * sizeof(si4);
+  }
+
+  void locate(CACHE *cache)
+  {
+    ui1 *p = (ui1 *) cache->base;
+
+    cache->header = (CACHE_HEADER *) p;
+    cache->n_sets = cache->header->n_sets;
+    cache->slot_samples = cache->header->slot_samples;
+    p += sizeof(CACHE_HEADER);
+    cache->meta = (SLOT_META *) p;
+    p += cache->n_sets * SHARED_CACHE_WAYS * sizeof(SLOT_META);
+    cache->hands = (ui8 *) p;
+    p += cache->n_sets * sizeof(ui8);
+    cache->samples = (si4 *) p;
+  }
+
+  std::string segment_path(const char *name)
+  {
+    struct stat st;
+
+    return std::string(stat("/dev/shm", &st) == 0 ? "/dev/shm/" : "/tmp/") + name;
+  }
+
+  inline ui8 mix(ui8 x)
+  {
+    x ^= x >> 33; x *= 0xff51afd7ed558ccdUL;
+    x ^= x >> 33; x *= 0xc4ceb9fe1a85ec53UL;
+    x ^= x >> 33;
+    return x;
+  }
+
+  inline ui8 set_of(const CACHE *cache, ui8 file_key, ui8 block)
+  {
+    return mix(file_key ^ mix(block + 1)) % cache->n_sets;
+  }
+
+  inline si4 *slot_samples_of(const CACHE *cache, ui8 slot)
+  {
+    return cache->samples + slot * cache->slot_samples;
+  }
+
+  ui8 now_us()
+  {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ui8) ts.tv_sec * 1000000 + (ui8) ts.tv_nsec / 1000;
+  }
+
+  // A slot's seq word: the low 32 bits count its states (0 mod 4: stable; 1: claimed; 3: being written),
+  // the high 32 bits hold the pid of the process that owns it while it is claimed or written, so that
+  // one compare-and-swap both takes a slot and records who has it.
+  inline ui4 seq_count(ui8 seq) { return (ui4) seq; }
+  inline si4 seq_owner(ui8 seq) { return (si4) (seq >> 32); }
+  inline ui8 make_seq(si4 owner, ui4 count) { return ((ui8) (ui4) owner << 32) | count; }
+
+  // Slot m was seen claimed or being written at *seq. When its owner has died, or is alive but set the
+  // claim up longer than SHARED_CACHE_CLAIM_US ago and has not started writing it, take it over and
+  // release the slot empty: *seq is then its new, even, value. Taking over first moves the slot to the
+  // written state under this process, so that no reader sees it stable before its key is cleared, and
+  // makes the owner's publish fail, should it still come.
+  //
+  // A live owner's claim is not taken while claimed is 0, since it may still be storing the key, block
+  // and length: a store landing after the slot was cleared would leave it stable under the right key
+  // with samples nobody wrote. The release store of claimed makes those stores visible first. Nor is it
+  // taken while the samples are being copied in. A dead owner stores nothing more, so its slot is
+  // always taken.
+  bool reclaim(SLOT_META *m, ui8 *seq)
+  {
+    ui8 expected = *seq, claimed;
+    ui4 count = seq_count(expected);
+    si4 owner = seq_owner(expected);
+    bool dead = owner > 0 && kill((pid_t) owner, 0) != 0 && errno == ESRCH;
+
+    if (!dead) {
+        claimed = __atomic_load_n(&m->claimed, __ATOMIC_ACQUIRE);
+        if ((count & 3) != 1 || claimed == 0 || now_us() - claimed < SHARED_CACHE_CLAIM_US)
+            return false;
+    }
+    if (!__atomic_compare_exchange_n(&m->seq, &expected, make_seq((si4) getpid(), count | 3), false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return false;   // published or taken over meanwhile
+    __atomic_store_n(&m->file_key, (ui8) 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&m->referenced, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&m->claimed, (ui8) 0, __ATOMIC_RELAXED);
+    *seq = make_seq(0, (count | 3) + 1);
+    __atomic_store_n(&m->seq, *seq, __ATOMIC_RELEASE);
+    return true;
+  }
+
+}
+
+ui8 shared_cache_file_key(const MEF_HEADER_INFO *header)
+{
+    // FNV-1a over the fields that identify a recording, whatever path it is opened by
+    const ui1 *fields[5] = { header->file_unique_ID, header->session_unique_ID, (const ui1 *) &header->recording_start_time,
+                             (const ui1 *) &header->number_of_samples, (const ui1 *) header->channel_name };
+    size_t lengths[5] = { FILE_UNIQUE_ID_LENGTH, SESSION_UNIQUE_ID_LENGTH, sizeof(ui8), sizeof(ui8),
+                          strnlen(header->channel_name, CHANNEL_NAME_LENGTH) };
+    ui8 h = 0xcbf29ce484222325UL;
+
+    for (int f = 0; f < 5; f++)
+        for (size_t i = 0; i < lengths[f]; i++)
+            h = (h ^ fields[f][i]) * 0x100000001b3UL;
+    return h | 1;   // never 0, which marks an empty slot
+}
+
+si4 shared_cache_attach(const char *name, ui8 bytes, ui4 slot_samples)
+{
+    std::string path;
+    CACHE_HEADER header;
+    CACHE *cache;
+    struct stat st;
+    int fd, waited;
+    void *base;
+    ui8 n_sets;
+    size_t total;
+
+    if (name == NULL || *name == 0 || strchr(name, '/') != NULL || slot_samples == 0)
+        return(MEF_ERR_OPEN);
+    shared_cache_detach(false);
+    path = segment_path(name);
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        // creator: size it, set the geometry, then publish the magic number
+        n_sets = bytes / (SHARED_CACHE_WAYS * (sizeof(SLOT_META) + (ui8) slot_samples * sizeof(si4)));
+        if (n_sets == 0)
+            n_sets = 1;
+        total = layout_bytes(n_sets, slot_samples);
+        if (ftruncate(fd, (off_t) total) != 0) {
+            close(fd);
+            unlink(path.c_str());
+            return(MEF_ERR_MEMORY);
+        }
+        base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            unlink(path.c_str());
+            return(MEF_ERR_MEMORY);
+        }
+        CACHE_HEADER *h = (CACHE_HEADER *) base;
+        h->n_sets = n_sets;
+        h->slot_samples = slot_samples;
+        h->bytes = total;
+        __atomic_store_n(&h->magic, SHARED_CACHE_MAGIC, __ATOMIC_RELEASE);
+    } else {
+        if (errno != EEXIST)
+            return(MEF_ERR_OPEN);
+        fd = open(path.c_str(), O_RDWR);
+        if (fd < 0)
+            return(MEF_ERR_OPEN);
+        // another process may still be creating it
+        for (waited = 0; ; waited++) {
+            if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(header)
+                && pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header) && header.magic == SHARED_CACHE_MAGIC)
+                break;
+            if (waited >= SHARED_CACHE_ATTACH_MS) {
+                close(fd);
+                return(MEF_ERR_FORMAT);
+            }
+            usleep(1000);
+        }
+        total = layout_bytes(header.n_sets, header.slot_samples);
+        if (header.n_sets == 0 || header.slot_samples == 0 || header.bytes != total || (size_t) st.st_size < total) {
+            close(fd);
+            return(MEF_ERR_FORMAT);
+        }
+        base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED)
+            return(MEF_ERR_MEMORY);
+    }
+
+    cache = new CACHE;
+    cache->path = path;
+    cache->base = base;
+    cache->bytes = total;
+    locate(cache);
+    attached.store(cache, std::memory_order_release);
+    return(MEF_OK);
+}
+
+void shared_cache_detach(bool remove)
+{
+    CACHE *cache = attached.exchange(NULL);
+
+    if (cache == NULL)
+        return;
+    munmap(cache->base, cache->bytes);
+    if (remove)
+        unlink(cache->path.c_str());
+    delete cache;
+}
+
+bool shared_cache_attached()
+{
+    return attached.load(std::memory_order_acquire) != NULL;
+}
+
+bool shared_cache_info(SHARED_CACHE_INFO *info)
+{
+    CACHE *cache = attached.load(std::memory_order_acquire);
+    ui8 slot, n_slots;
+
+    if (cache == NULL)
+        return false;
+    n_slots = cache->n_sets * SHARED_CACHE_WAYS;
+    info->slots = n_slots;
+    info->slot_samples = (ui4) cache->slot_samples;
+    info->bytes = cache->bytes;
+    info->used = 0;
+    for (slot = 0; slot < n_slots; slot++)
+        if (__atomic_load_n(&cache->meta[slot].file_key, __ATOMIC_RELAXED) != 0)
+            info->used++;
+    return true;
+}
+
+bool shared_cache_lookup(ui8 file_key, ui8 block, ui4 n, si4 *out)
+{
+    CACHE *cache = attached.load(std::memory_order_acquire);
+    ui8 set, slot, seq;
+    ui4 w, waited;
+
+    if (cache == NULL || n == 0 || n > cache->slot_samples)
+        return false;
+    set = set_of(cache, file_key, block);
+    for (w = 0; w < SHARED_CACHE_WAYS; w++) {
+        slot = set * SHARED_CACHE_WAYS + w;
+        SLOT_META *m = &cache->meta[slot];
+        if (__atomic_load_n(&m->file_key, __ATOMIC_RELAXED) != file_key || __atomic_load_n(&m->block, __ATOMIC_RELAXED) != block)
+            continue;
+        // claimed by a process that is decoding it now: wait for that rather than decode it again, unless
+        // the claim was abandoned
+        seq = __atomic_load_n(&m->seq, __ATOMIC_ACQUIRE);
+        if ((seq & 1) && reclaim(m, &seq))
+            break;
+        for (waited = 0; (seq & 1) && waited < SHARED_CACHE_WAIT_US; waited += 50) {
+            usleep(50);
+            seq = __atomic_load_n(&m->seq, __ATOMIC_ACQUIRE);
+        }
+        if ((seq & 1) || __atomic_load_n(&m->file_key, __ATOMIC_RELAXED) != file_key
+            || __atomic_load_n(&m->block, __ATOMIC_RELAXED) != block || __atomic_load_n(&m->n, __ATOMIC_RELAXED) != n)
+            break;
+        memcpy(out, slot_samples_of(cache, slot), (size_t) n * sizeof(si4));
+        // the copy is good only if no writer claimed the slot while it was being made
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&m->seq, __ATOMIC_RELAXED) != seq)
+            break;
+        __atomic_store_n(&m->referenced, 1, __ATOMIC_RELAXED);
+        stats_count(COUNTER_SHARED_HITS, 1);
+        return true;
+    }
+    stats_count(COUNTER_SHARED_MISSES, 1);
+    return false;
+}
+
+SHARED_CACHE_CLAIM shared_cache_claim(ui8 file_key, ui8 block, ui4 n)
+{
+    CACHE *cache = attached.load(std::memory_order_acquire);
+    SHARED_CACHE_CLAIM none = { -1, 0 };
+    ui8 set, slot, seq, hand;
+    ui4 w, step;
+
+    if (cache == NULL || n == 0 || n > cache->slot_samples)
+        return(none);
+    set = set_of(cache, file_key, block);
+
+    // another process may have claimed or published it in the meantime; a claim it abandoned is freed
+    for (w = 0; w < SHARED_CACHE_WAYS; w++) {
+        SLOT_META *m = &cache->meta[set * SHARED_CACHE_WAYS + w];
+        if (__atomic_load_n(&m->file_key, __ATOMIC_RELAXED) == file_key && __atomic_load_n(&m->block, __ATOMIC_RELAXED) == block) {
+            seq = __atomic_load_n(&m->seq, __ATOMIC_ACQUIRE);
+            if (!(seq & 1) || !reclaim(m, &seq))
+                return(none);
+        }
+    }
+
+    // clock: sweep from the set's hand, giving referenced slots a second chance; two turns at most
+    hand = __atomic_load_n(&cache->hands[set], __ATOMIC_RELAXED);
+    for (step = 0; step < 2 * SHARED_CACHE_WAYS; step++) {
+        w = (ui4) ((hand + step) % SHARED_CACHE_WAYS);
+        slot = set * SHARED_CACHE_WAYS + w;
+        SLOT_META *m = &cache->meta[slot];
+        seq = __atomic_load_n(&m->seq, __ATOMIC_ACQUIRE);
+        if ((seq & 1) && !reclaim(m, &seq))
+            continue;
+        if (__atomic_load_n(&m->referenced, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&m->referenced, 0, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (!__atomic_compare_exchange_n(&m->seq, &seq, make_seq((si4) getpid(), seq_count(seq) + 1), false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            continue;
+        __atomic_store_n(&cache->hands[set], hand + step + 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&m->file_key, file_key, __ATOMIC_RELAXED);
+        __atomic_store_n(&m->block, block, __ATOMIC_RELAXED);
+        __atomic_store_n(&m->n, n, __ATOMIC_RELAXED);
+        __atomic_store_n(&m->referenced, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&m->claimed, now_us(), __ATOMIC_RELEASE);
+        SHARED_CACHE_CLAIM claim = { (si8) slot, make_seq((si4) getpid(), seq_count(seq) + 1) };
+        return(claim);
+    }
+    return(none);
+}
+
+void shared_cache_publish(const SHARED_CACHE_CLAIM &claim, const si4 *samples)
+{
+    CACHE *cache = attached.load(std::memory_order_acquire);
+    SLOT_META *m;
+    ui8 seq;
+
+    if (cache == NULL || claim.slot < 0)
+        return;
+    m = &cache->meta[claim.slot];
+    // move the claim to the written state, which is not timed out; if it was taken over already the slot
+    // is no longer ours
+    seq = claim.seq;
+    if (!__atomic_compare_exchange_n(&m->seq, &seq, seq + 2, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return;
+    if (samples != NULL)
+        memcpy(slot_samples_of(cache, (ui8) claim.slot), samples, (size_t) m->n * sizeof(si4));
+    else
+        __atomic_store_n(&m->file_key, (ui8) 0, __ATOMIC_RELAXED);    // decode failed: give the slot back empty
+    __atomic_store_n(&m->claimed, (ui8) 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&m->seq, make_seq(0, seq_count(seq) + 3), __ATOMIC_RELEASE);
+}
+
+}
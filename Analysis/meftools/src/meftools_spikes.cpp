@@ -0,0 +1,106 @@
+/*
+		meftools_spikes.cpp
+
+ Streaming threshold-crossing spike detector. See meftools_spikes.h.
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "../inst/include/meftools_spikes.h"
+
+namespace meftools {
+
+SpikeDetector::SpikeDetector(const SPIKE_PARAMS &params)
+    : params_(params), base_(0), stream_first_(0), window_start_(0), next_allowed_(0), last_noise_(-1.0), started_(false)
+{
+    if (params_.window < 1)
+        params_.window = 1;
+}
+
+sf8 SpikeDetector::noise(ui8 w0, ui8 w1)
+{
+    size_t n = w1 - w0, mid = n / 2;
+    sf8 median;
+
+    scratch_.assign(buffer_.begin() + (w0 - base_), buffer_.begin() + (w1 - base_));
+    std::nth_element(scratch_.begin(), scratch_.begin() + mid, scratch_.end());
+    median = scratch_[mid];
+    for (size_t i = 0; i < n; i++)
+        scratch_[i] = fabs(scratch_[i] - median);
+    std::nth_element(scratch_.begin(), scratch_.begin() + mid, scratch_.end());
+    return scratch_[mid] / 0.6745;
+}
+
+void SpikeDetector::write(ui8 first_sample, const sf8 *y, size_t n)
+{
+    if (!started_) {
+        base_ = stream_first_ = window_start_ = next_allowed_ = first_sample;
+        started_ = true;
+    }
+    buffer_.insert(buffer_.end(), y, y + n);
+
+    // a window can be processed once the dead time and snippet after its last sample are buffered
+    while (base_ + buffer_.size() >= window_start_ + params_.window + params_.dead_time + params_.post)
+        process_window(false);
+}
+
+void SpikeDetector::finish()
+{
+    while (started_ && window_start_ < base_ + buffer_.size())
+        process_window(true);
+}
+
+void SpikeDetector::process_window(bool last)
+{
+    ui8 end, w0, w1, i, j, p, stop, keep;
+    sf8 thr, sign, v, best;
+
+    end = base_ + buffer_.size();
+    w0 = window_start_;
+    w1 = std::min(w0 + params_.window, end);
+
+    // a short final window borrows the previous estimate
+    if (last && w1 - w0 < params_.window / 2 && last_noise_ >= 0.0)
+        thr = last_noise_;
+    else
+        thr = last_noise_ = noise(w0, w1);
+    thr *= params_.threshold;
+
+    for (i = std::max(w0, next_allowed_); i < w1; i++) {
+        v = buffer_[i - base_];
+        if (params_.polarity < 0) { if (v >= -thr) continue; }
+        else if (params_.polarity > 0) { if (v <= thr) continue; }
+        else if (fabs(v) <= thr) continue;
+
+        // align on the extremum within the dead time
+        sign = params_.polarity < 0 ? -1.0 : 1.0;
+        stop = std::min(i + std::max(params_.dead_time, (ui8) 1), end);
+        p = i;
+        best = params_.polarity == 0 ? fabs(v) : sign * v;
+        for (j = i + 1; j < stop; j++) {
+            v = params_.polarity == 0 ? fabs(buffer_[j - base_]) : sign * buffer_[j - base_];
+            if (v > best) { best = v; p = j; }
+        }
+        next_allowed_ = p + std::max(params_.dead_time, (ui8) 1);
+
+        // drop spikes whose snippet would run off either end of the stream
+        if (p >= stream_first_ + params_.pre && p + params_.post < end) {
+            SPIKE spike = { p, buffer_[p - base_], thr };
+            spikes_.push_back(spike);
+            waveforms_.insert(waveforms_.end(), buffer_.begin() + (p - params_.pre - base_), buffer_.begin() + (p + params_.post + 1 - base_));
+        }
+        i = next_allowed_ - 1;
+    }
+
+    window_start_ = w1;
+    // keep enough history for the snippet of a spike at the start of the next window
+    keep = w1 - std::min(params_.pre, w1 - base_);
+    buffer_.erase(buffer_.begin(), buffer_.begin() + (keep - base_));
+    base_ = keep;
+}
+
+}
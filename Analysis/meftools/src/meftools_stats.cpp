@@ -0,0 +1,87 @@
+/*
+		meftools_stats.cpp
+
+ Process-wide read-path counters declared in meftools_stats.h.
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <atomic>
+#include <chrono>
+
+#include "../inst/include/meftools_stats.h"
+
+namespace meftools {
+
+namespace {
+
+  // one cache line per slot, so threads decoding different channels do not contend on the same line
+  struct alignas(64) STAT_SLOT {
+    std::atomic<ui8> value;
+  };
+
+  STAT_SLOT stage_calls[STAGE_COUNT];
+  STAT_SLOT stage_nanoseconds[STAGE_COUNT];
+  STAT_SLOT counters[COUNTER_COUNT];
+
+  const char *stage_names[STAGE_COUNT] = {
+    "open", "header_decrypt", "key_expansion", "index_load", "block_read", "range_decode", "diff_reconstruct", "output_copy"
+  };
+
+  const char *counter_names[COUNTER_COUNT] = {
+    "bytes_read", "blocks_decoded", "samples_decoded", "cache_hits", "cache_misses", "shared_hits", "shared_misses"
+  };
+
+}
+
+const char *stage_name(int stage)
+{
+    return (stage >= 0 && stage < STAGE_COUNT) ? stage_names[stage] : "unknown";
+}
+
+const char *counter_name(int counter)
+{
+    return (counter >= 0 && counter < COUNTER_COUNT) ? counter_names[counter] : "unknown";
+}
+
+ui8 stats_clock()
+{
+    return (ui8) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void stats_stage(int stage, ui8 nanoseconds)
+{
+    stage_calls[stage].value.fetch_add(1, std::memory_order_relaxed);
+    stage_nanoseconds[stage].value.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void stats_count(int counter, ui8 n)
+{
+    counters[counter].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+void stats_snapshot(MEF_STATS *stats)
+{
+    int i;
+
+    for (i = 0; i < STAGE_COUNT; i++) {
+        stats->calls[i] = stage_calls[i].value.load(std::memory_order_relaxed);
+        stats->nanoseconds[i] = stage_nanoseconds[i].value.load(std::memory_order_relaxed);
+    }
+    for (i = 0; i < COUNTER_COUNT; i++)
+        stats->counters[i] = counters[i].value.load(std::memory_order_relaxed);
+}
+
+void stats_reset()
+{
+    int i;
+
+    for (i = 0; i < STAGE_COUNT; i++) {
+        stage_calls[i].value.store(0, std::memory_order_relaxed);
+        stage_nanoseconds[i].value.store(0, std::memory_order_relaxed);
+    }
+    for (i = 0; i < COUNTER_COUNT; i++)
+        counters[i].value.store(0, std::memory_order_relaxed);
+}
+
+}
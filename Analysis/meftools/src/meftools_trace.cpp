@@ -0,0 +1,131 @@
+/*
+		meftools_trace.cpp
+
+ Event recording and Chrome trace-event output for meftools_trace.h.
+
+ This software is made freely available under the GNU public license: http://www.gnu.org/licenses/gpl-3.0.txt
+*/
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <vector>
+
+#include "../inst/include/meftools_core.h"
+#include "../inst/include/meftools_stats.h"
+#include "../inst/include/meftools_trace.h"
+
+namespace meftools {
+
+std::atomic<bool> trace_enabled(false);
+
+namespace {
+
+  typedef struct {
+    const char *name;
+    const char *category;
+    ui8 start, duration;
+    ui4 thread;
+    si8 arg;
+  } TRACE_EVENT;
+
+  // a block decode is milliseconds, so one uncontended lock per event is well below the noise
+  std::mutex trace_lock;
+  std::vector<TRACE_EVENT> trace_events;
+  ui8 trace_origin = 0;
+
+  std::atomic<ui4> next_thread(1);
+
+  // small, stable per-thread ids read better in the viewer than pthread handles
+  ui4 thread_id()
+  {
+    static thread_local ui4 id = next_thread.fetch_add(1);
+    return id;
+  }
+
+}
+
+void trace_start()
+{
+    std::lock_guard<std::mutex> guard(trace_lock);
+    trace_events.clear();
+    trace_origin = stats_clock();
+    trace_enabled.store(true);
+}
+
+void trace_stop()
+{
+    trace_enabled.store(false);
+}
+
+ui8 trace_event_count()
+{
+    std::lock_guard<std::mutex> guard(trace_lock);
+    return trace_events.size();
+}
+
+void trace_span(const char *name, const char *category, ui8 start, ui8 end, si8 arg)
+{
+    TRACE_EVENT event;
+
+    event.name = name;
+    event.category = category;
+    event.start = start;
+    event.duration = end - start;
+    event.thread = thread_id();
+    event.arg = arg;
+
+    std::lock_guard<std::mutex> guard(trace_lock);
+    if (tracing())
+        trace_events.push_back(event);
+}
+
+si4 trace_write(const char *path)
+{
+    FILE *fp;
+    size_t i;
+    int pid, ok;
+
+    std::lock_guard<std::mutex> guard(trace_lock);
+    fp = fopen(path, "w");
+    if (fp == NULL)
+        return(MEF_ERR_WRITE);
+
+    pid = (int) getpid();
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (i = 0; i < trace_events.size(); i++) {
+        const TRACE_EVENT &e = trace_events[i];
+        // events that started before trace_start() are clamped to its origin
+        ui8 start = e.start > trace_origin ? e.start - trace_origin : 0;
+        fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u",
+                i ? ",\n" : "", e.name, e.category, start / 1e3, e.duration / 1e3, pid, e.thread);
+        if (e.arg >= 0)
+            fprintf(fp, ",\"args\":{\"n\":%lld}", (long long) e.arg);
+        fputc('}', fp);
+    }
+    fprintf(fp, "\n]}\n");
+    ok = !ferror(fp);
+    if (fclose(fp) != 0)
+        ok = 0;
+    return(ok ? MEF_OK : MEF_ERR_WRITE);
+}
+
+TraceSpan::TraceSpan(const char *name, const char *category, si8 arg)
+    : name_(name), category_(category), arg_(arg), start_(0)
+{
+    if (tracing())
+        start_ = stats_clock();
+    else
+        name_ = NULL;
+}
+
+void TraceSpan::stop()
+{
+    if (name_ != NULL) {
+        trace_span(name_, category_, start_, stats_clock(), arg_);
+        name_ = NULL;
+    }
+}
+
+}
@@ -1,13 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
 
 #include <RcppCommon.h>
 #include <Rcpp.h>
 
-#include "../inst/include/meftools_types.h"
+#include "../inst/include/meftools_core.h"
 
 //' @importFrom Rcpp evalCpp
 //' @useDynLib meftools
@@ -15,52 +18,29 @@
 //' @export
 // [[Rcpp::export]]
 Rcpp::NumericMatrix table_of_contents( Rcpp::StringVector strings ) {
-//    printf( "ToC\n" );
-    char *filename = (si1*)strings(0);
-//    printf( "filename: %s\n", filename );
-//    printf( "%s\n", (char *)strings(1) );
+    std::string filename = Rcpp::as<std::string>( strings(0) );
     long index_data_offset = atol( strings(1) );
-//    printf( "%ld\n", index_data_offset );
-//    printf( "%s\n", (char *)strings(2) );
     long number_of_index_entries = atol( strings(2) );
-//    printf( "%ld\n", number_of_index_entries );
-    //	printf( "%d\n", index_data_offset );
-    //  printf( "%d\n", number_of_index_entries );
-//    printf( "out of ToC\n" );
-    
-    FILE *fp = fopen( filename, "r" );
-    fseek( fp, index_data_offset, SEEK_SET );
-    Rcpp::NumericVector NumVecBuf( 3 * number_of_index_entries * sizeof(unsigned long long int) );
-    unsigned char* buf = (unsigned char*) &(NumVecBuf[0]);
-//    unsigned char* buf = (unsigned char *)malloc( 3 * number_of_index_entries * sizeof(unsigned long long int) );
-    fread( buf, sizeof("unsigned long long int"), (long)(3 * number_of_index_entries), fp );
-    fclose( fp );
-    
-    // Convert "buf" into a 3-column matrix.
-    unsigned long long int l;
+    if ( index_data_offset < 0 || number_of_index_entries < 0 )
+        Rcpp::stop( filename + ": " + meftools::error_string( meftools::MEF_ERR_RANGE ) );
+
+    // One INDEX_DATA (time, file offset, sample number; little-endian ui8s) per block.
+    std::vector<INDEX_DATA> index( number_of_index_entries );
+    size_t bytes = index.size() * sizeof(INDEX_DATA);
+    int fd = open( filename.c_str(), O_RDONLY );
+    if ( fd < 0 )
+        Rcpp::stop( filename + ": " + meftools::error_string( meftools::MEF_ERR_OPEN ) );
+    ssize_t n = bytes > 0 ? pread( fd, &index[0], bytes, (off_t) index_data_offset ) : 0;
+    close( fd );
+    if ( n < 0 || (size_t) n != bytes )
+        Rcpp::stop( filename + ": " + meftools::error_string( meftools::MEF_ERR_READ ) );
+
+    // Convert the index into a 3-column matrix.
     Rcpp::NumericMatrix ToC(3, number_of_index_entries);
     for (int col=0; col<number_of_index_entries; col++ ) {
-        l = 0;
-        int offset = (col*3 + 0)*sizeof(unsigned long long int);
-        for (int i = 0; i < 8; ++i) {
-            l = l | ((unsigned long long int)buf[i+offset] << (8 * i));
-        }
-        ToC(0,col) = l;
-        
-        l = 0;
-        offset = (col*3 + 1)*sizeof(unsigned long long int);
-        for (int i = 0; i < 8; ++i) {
-            l = l | ((unsigned long long int)buf[i+offset] << (8 * i));
-        }
-        ToC(1,col) = l;
-        
-        l = 0;
-        offset = (col*3 + 2)*sizeof(unsigned long long int);
-        for (int i = 0; i < 8; ++i) {
-            l = l | ((unsigned long long int)buf[i+offset] << (8 * i));
-        }
-        ToC(2,col) = l;
+        ToC(0,col) = (double) index[col].time;
+        ToC(1,col) = (double) index[col].file_offset;
+        ToC(2,col) = (double) index[col].sample_number;
     }
     return( ToC );
 }
-